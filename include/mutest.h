@@ -19,10 +19,25 @@
 # define MUTEST_PUBLIC          extern
 #endif
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+/* The typed expectations compare strings and floating point values
+ * inline; use the compiler built-ins, so that including this header
+ * does not pull <string.h> and <float.h> into every test
+ */
+#if defined(__GNUC__) && defined(__DBL_EPSILON__)
+# define MUTEST_DBL_EPSILON     __DBL_EPSILON__
+# define MUTEST_STRCMP          __builtin_strcmp
+#else
+# include <float.h>
+# include <string.h>
+# define MUTEST_DBL_EPSILON     DBL_EPSILON
+# define MUTEST_STRCMP          strcmp
+#endif
+
 #if defined(__GNUC__) && __GNUC__ >= 4
 # define MUTEST_NULL_TERMINATED \
   __attribute__((__sentinel__))
@@ -104,6 +119,20 @@ typedef void (* mutest_spec_func_t) (mutest_spec_t *spec);
 typedef bool (* mutest_matcher_func_t) (mutest_expect_t *e,
                                         mutest_expect_res_t *check);
 
+/**
+ * mutest_matcher_collect_func_t:
+ * @value: the value passed to mutest_expect()
+ * @args: the arguments following the matcher in mutest_expect()
+ *
+ * The prototype of a function that collects the expected value of a
+ * matcher registered with mutest_register_matcher(), using va_arg()
+ * on @args.
+ *
+ * Returns: the expected value to pass to the matcher
+ */
+typedef mutest_expect_res_t *(* mutest_matcher_collect_func_t) (const mutest_expect_res_t *value,
+                                                                va_list *args);
+
 /**
  * mutest_hook_func_t:
  *
@@ -112,6 +141,152 @@ typedef bool (* mutest_matcher_func_t) (mutest_expect_t *e,
  */
 typedef void (* mutest_hook_func_t) (void);
 
+/**
+ * mutest_expect_closure_func_t:
+ * @data: the data passed to mutest_closure()
+ *
+ * The prototype of a function to pass to mutest_closure().
+ */
+typedef void (* mutest_expect_closure_func_t) (void *data);
+
+/**
+ * mutest_listener_event_t:
+ * @MUTEST_LISTENER_RUN_START: the run started
+ * @MUTEST_LISTENER_SUITE_START: a suite started
+ * @MUTEST_LISTENER_SPEC_START: a spec started
+ * @MUTEST_LISTENER_EXPECT_DIAGNOSTIC: an expectation failed; the
+ *   event comes before the result of the expectation
+ * @MUTEST_LISTENER_EXPECT_RESULT: the result of an expectation
+ * @MUTEST_LISTENER_SPEC_END: a spec ended
+ * @MUTEST_LISTENER_SUITE_END: a suite ended
+ * @MUTEST_LISTENER_RUN_END: the run ended
+ *
+ * The events notified to a #mutest_listener_func_t.
+ *
+ * The events of a spec come between its %MUTEST_LISTENER_SPEC_START
+ * and %MUTEST_LISTENER_SPEC_END events, and the ones of a suite
+ * between its %MUTEST_LISTENER_SUITE_START and %MUTEST_LISTENER_SUITE_END
+ * events. Listeners should ignore the events they do not know about.
+ */
+typedef enum {
+  MUTEST_LISTENER_RUN_START,
+  MUTEST_LISTENER_SUITE_START,
+  MUTEST_LISTENER_SPEC_START,
+  MUTEST_LISTENER_EXPECT_DIAGNOSTIC,
+  MUTEST_LISTENER_EXPECT_RESULT,
+  MUTEST_LISTENER_SPEC_END,
+  MUTEST_LISTENER_SUITE_END,
+  MUTEST_LISTENER_RUN_END
+} mutest_listener_event_t;
+
+/**
+ * mutest_listener_info_t:
+ * @description: the description of the suite, spec, or expectation;
+ *   %NULL for the events of the run
+ * @file: the file of the suite, spec, or expectation
+ * @line: the line of the suite, spec, or expectation
+ * @func_name: the function of the expectation
+ * @pass: the number of passed expectations; for the result of an
+ *   expectation, 1 if it passed
+ * @fail: the number of failed expectations; for the result of an
+ *   expectation, 1 if it failed
+ * @skip: the number of skipped expectations, suites, and specs; for
+ *   the result of an expectation, 1 if it was skipped
+ * @n_specs: the number of specs of a suite that ended
+ * @filtered: the number of specs that did not match the filters, at
+ *   the end of the run
+ * @cancelled: whether the run was cancelled, at the end of the run
+ * @skipped: whether the suite or spec was skipped
+ * @skip_reason: the reason why the suite, spec, or expectation was
+ *   skipped, if any
+ * @duration: the duration of the suite, spec, or run that ended,
+ *   in nanoseconds
+ * @diagnostic: the reason why an expectation failed
+ * @location: the location of the expectation that failed
+ * @has_bench: whether the spec that ended is a measured benchmark
+ * @bench_iterations: the number of calls in each benchmark sample
+ * @bench_samples: the number of benchmark samples
+ * @bench_median: the median time of a call, in nanoseconds
+ * @bench_mad: the median absolute deviation of the time of a call,
+ *   in nanoseconds
+ * @bench_ci_low: the lower bound of the confidence interval of
+ *   the median, in nanoseconds
+ * @bench_ci_high: the upper bound of the confidence interval of
+ *   the median, in nanoseconds
+ * @has_counters: whether the hardware counters of the spec that
+ *   ended are available
+ * @cycles: the CPU cycles of the spec, or -1
+ * @instructions: the retired instructions of the spec, or -1
+ * @branch_misses: the mispredicted branches of the spec, or -1
+ * @l1d_misses: the L1 data cache misses of the spec, or -1
+ * @llc_misses: the last level cache misses of the spec, or -1
+ * @has_allocations: whether the allocations of the spec that ended
+ *   are available
+ * @n_allocs: the calls to malloc(), calloc(), and realloc()
+ * @n_frees: the calls to free()
+ * @n_bytes: the bytes requested by the allocations
+ *
+ * The information about an event, passed to a #mutest_listener_func_t.
+ *
+ * Only the fields that apply to the event are set; the others are
+ * zero, or %NULL. The strings are only valid during the call to the
+ * listener.
+ */
+typedef struct {
+  const char *description;
+  const char *file;
+  int line;
+  const char *func_name;
+
+  int pass;
+  int fail;
+  int skip;
+
+  int n_specs;
+  int filtered;
+  bool cancelled;
+
+  bool skipped;
+  const char *skip_reason;
+
+  int64_t duration;
+
+  const char *diagnostic;
+  const char *location;
+
+  bool has_bench;
+  int64_t bench_iterations;
+  int bench_samples;
+  double bench_median;
+  double bench_mad;
+  double bench_ci_low;
+  double bench_ci_high;
+
+  bool has_counters;
+  int64_t cycles;
+  int64_t instructions;
+  int64_t branch_misses;
+  int64_t l1d_misses;
+  int64_t llc_misses;
+
+  bool has_allocations;
+  int64_t n_allocs;
+  int64_t n_frees;
+  int64_t n_bytes;
+} mutest_listener_info_t;
+
+/**
+ * mutest_listener_func_t:
+ * @event: the type of the event
+ * @info: the information about the event
+ * @data: the data passed to mutest_add_listener()
+ *
+ * The prototype of a function to pass to mutest_add_listener().
+ */
+typedef void (* mutest_listener_func_t) (mutest_listener_event_t event,
+                                         const mutest_listener_info_t *info,
+                                         void *data);
+
 /* }}} */
 
 /* {{{ Value wrappers */
@@ -294,6 +469,134 @@ MUTEST_PUBLIC
 const void *
 mutest_get_pointer (const mutest_expect_res_t *res);
 
+/**
+ * mutest_closure:
+ * @func: the function to call
+ * @data: the data to pass to @func
+ *
+ * Wraps a function to pass to mutest_expect(); the function is called
+ * by the matchers that check its behaviour, like
+ * mutest_to_allocate_at_most().
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_closure (mutest_expect_closure_func_t func,
+                void *data);
+
+/**
+ * mutest_byte_array:
+ * @data: the elements of the array
+ * @element_size: the size of each element, in bytes
+ * @length: the number of elements
+ *
+ * Wraps an array to pass to mutest_expect(), or to compare using
+ * mutest_to_be(); the array is copied.
+ *
+ * Arrays are equal if they contain the same bytes; if they are not,
+ * the failure displays the bytes around the first difference.
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_byte_array (const void *data,
+                   size_t element_size,
+                   size_t length);
+
+/**
+ * mutest_get_byte_array:
+ * @res: a #mutest_expect_res_t
+ * @element_size: (out) (optional): return location for the size of each element
+ * @length: (out) (optional): return location for the number of elements
+ *
+ * Retrieves the array in the result wrapper.
+ *
+ * Returns: the elements of the array
+ */
+MUTEST_PUBLIC
+const void *
+mutest_get_byte_array (const mutest_expect_res_t *res,
+                       size_t *element_size,
+                       size_t *length);
+
+/**
+ * mutest_int32_array:
+ * @data: the elements of the array
+ * @length: the number of elements
+ *
+ * Wraps an array of 32 bits integers to pass to mutest_expect(), or
+ * to the array matchers, like mutest_to_have_equal_elements().
+ *
+ * The array is not copied, so it must be valid until the expectation
+ * is checked.
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_int32_array (const int32_t *data,
+                    size_t length);
+
+/**
+ * mutest_int64_array:
+ * @data: the elements of the array
+ * @length: the number of elements
+ *
+ * Wraps an array of 64 bits integers; see mutest_int32_array().
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_int64_array (const int64_t *data,
+                    size_t length);
+
+/**
+ * mutest_float_array:
+ * @data: the elements of the array
+ * @length: the number of elements
+ *
+ * Wraps an array of single precision floating point values; see
+ * mutest_int32_array().
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_float_array (const float *data,
+                    size_t length);
+
+/**
+ * mutest_double_array:
+ * @data: the elements of the array
+ * @length: the number of elements
+ *
+ * Wraps an array of double precision floating point values; see
+ * mutest_int32_array().
+ *
+ * Returns: a newly allocated #mutest_expect_res_t
+ */
+MUTEST_PUBLIC
+mutest_expect_res_t *
+mutest_double_array (const double *data,
+                     size_t length);
+
+/**
+ * mutest_get_array:
+ * @res: a #mutest_expect_res_t
+ * @length: (out) (optional): return location for the number of elements
+ *
+ * Retrieves the numeric array in the result wrapper.
+ *
+ * Returns: the elements of the array
+ */
+MUTEST_PUBLIC
+const void *
+mutest_get_array (const mutest_expect_res_t *res,
+                  size_t *length);
+
 /* }}} */
 
 /* {{{ Matchers */
@@ -579,6 +882,138 @@ bool
 mutest_to_end_with_string (mutest_expect_t *e,
                            mutest_expect_res_t *check);
 
+/**
+ * mutest_to_allocate_at_most:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Calls the closure in @e, and checks that it does not allocate
+ * memory more times than the integer value in @check.
+ *
+ * If the allocations cannot be counted, the expectation is skipped.
+ *
+ * Returns: true if the closure allocated at most the expected
+ *   number of times
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_allocate_at_most (mutest_expect_t *e,
+                            mutest_expect_res_t *check);
+
+/**
+ * mutest_to_not_allocate:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Calls the closure in @e, and checks that it does not allocate
+ * memory.
+ *
+ * If the allocations cannot be counted, the expectation is skipped.
+ *
+ * Returns: true if the closure did not allocate
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_not_allocate (mutest_expect_t *e,
+                        mutest_expect_res_t *check);
+
+/**
+ * mutest_to_have_equal_elements:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Checks that the numeric array in @e has the same elements as the
+ * array in @check, which must have the same type and length.
+ *
+ * If some elements are different, the failure reports their number,
+ * and the first ones.
+ *
+ * Returns: true if all the elements are equal
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_have_equal_elements (mutest_expect_t *e,
+                               mutest_expect_res_t *check);
+
+/**
+ * mutest_to_have_close_elements:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Checks that the elements of the numeric array in @e are close to
+ * the elements of the array in @check, which must have the same type
+ * and length.
+ *
+ * This matcher collects the array, followed by an absolute tolerance,
+ * a relative tolerance, both as `double`, and a tolerance in units in
+ * the last place, as `int`; two elements are close if they are within
+ * any of the tolerances that are not zero. The tolerance in units in
+ * the last place is ignored for integer arrays.
+ *
+ * Returns: true if all the elements are close
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_have_close_elements (mutest_expect_t *e,
+                               mutest_expect_res_t *check);
+
+/**
+ * mutest_to_have_elements_in_range:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Checks that all the elements of the numeric array in @e are within
+ * the range in @check.
+ *
+ * This matcher collects the minimum and maximum values of the range,
+ * as `int` for integer arrays, and as `double` for floating point
+ * arrays.
+ *
+ * Returns: true if all the elements are in range
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_have_elements_in_range (mutest_expect_t *e,
+                                  mutest_expect_res_t *check);
+
+/**
+ * mutest_to_be_sorted:
+ * @e: a #mutest_expect_t
+ * @check: a #mutest_expect_res_t
+ *
+ * Checks that the elements of the numeric array in @e are sorted in
+ * ascending order.
+ *
+ * Returns: true if the array is sorted
+ */
+MUTEST_PUBLIC
+bool
+mutest_to_be_sorted (mutest_expect_t *e,
+                     mutest_expect_res_t *check);
+
+/**
+ * mutest_register_matcher:
+ * @matcher: a matcher function
+ * @collect: (nullable): the function collecting the expected value
+ *   of @matcher
+ * @repr: (nullable): a description of the expected value, used
+ *   instead of the value when reporting a failure
+ *
+ * Registers a custom matcher, so that its expected value can be
+ * collected from the arguments of mutest_expect(), like the matchers
+ * provided by µTest, instead of being wrapped by the caller.
+ *
+ * If @collect is %NULL, the matcher takes no argument, and it's called
+ * with a %NULL expected value.
+ *
+ * Matchers must be registered before running the suites.
+ */
+MUTEST_PUBLIC
+void
+mutest_register_matcher (mutest_matcher_func_t matcher,
+                         mutest_matcher_collect_func_t collect,
+                         const char *repr);
+
 /**
  * mutest_expect_value:
  * @expect: a #mutest_expect_t
@@ -680,11 +1115,76 @@ mutest_it_full (const char *file,
  * Specifications group various expectations; typically you will use
  * mutest_expect() to define the various expectations that need to
  * be satisfied in order to pass the tests.
+ *
+ * The @description string is copied, so it can be built in a temporary
+ * buffer.
  */
 #define mutest_it(description,func) \
   mutest_it_full (__FILE__, __LINE__, __func__, description, \
     (mutest_spec_func_t)(void (*)(void)) func)
 
+MUTEST_PUBLIC
+void
+mutest_it_with_timeout_full (const char *file,
+                             int line,
+                             const char *func_name,
+                             const char *description,
+                             mutest_spec_func_t func,
+                             double timeout);
+
+/**
+ * mutest_it_with_timeout:
+ * @description: the description of a test specification
+ * @func: the function to be called to initialize the specification
+ * @timeout: the maximum duration of the specification, in seconds
+ *
+ * Describes a new test specification, like mutest_it(), that fails
+ * if it takes longer than @timeout seconds.
+ *
+ * The @timeout overrides the default one, set using the `MUTEST_TIMEOUT`
+ * environment variable.
+ *
+ * Specs with a timeout run in a separate process, so that a spec that
+ * times out can be terminated, and the run continues; on platforms
+ * without separate processes, the timeout is reported as an error,
+ * and the test binary exits with a failure.
+ */
+#define mutest_it_with_timeout(description,func,timeout) \
+  mutest_it_with_timeout_full (__FILE__, __LINE__, __func__, description, \
+    (mutest_spec_func_t)(void (*)(void)) func, timeout)
+
+MUTEST_PUBLIC
+void
+mutest_bench_full (const char *file,
+                   int line,
+                   const char *func_name,
+                   const char *description,
+                   mutest_spec_func_t func);
+
+/**
+ * mutest_bench:
+ * @description: the description of a benchmark
+ * @func: the function to be benchmarked
+ *
+ * Describes a new benchmark specification.
+ *
+ * The @func function is called once, like a specification defined using
+ * mutest_it(), to check its expectations; then, if all expectations
+ * passed, it is called repeatedly to measure its duration. The number
+ * of calls is calibrated so that the measurement takes about one second,
+ * or the amount of seconds set using the `MUTEST_BENCH_TIME` environment
+ * variable, after a few warm-up rounds.
+ *
+ * The results of the benchmark are reported as the median time of each
+ * call, with its median absolute deviation, and a 95% confidence interval.
+ *
+ * Expectations are not reported while the duration of @func is being
+ * measured.
+ */
+#define mutest_bench(description,func) \
+  mutest_bench_full (__FILE__, __LINE__, __func__, description, \
+    (mutest_spec_func_t)(void (*)(void)) func)
+
 MUTEST_PUBLIC
 void
 mutest_describe_full (const char *file,
@@ -703,6 +1203,12 @@ mutest_describe_full (const char *file,
  * Test suites group various specifications; typically you will use
  * mutest_it() to define the specifications for a suite.
  *
+ * The @func function is called immediately, to collect the specifications
+ * and the hooks of the suite; the specifications are run by mutest_report().
+ *
+ * The @description string is copied, so it can be built in a temporary
+ * buffer.
+ *
  * Each test binary can contain multiple test suites.
  */
 #define mutest_describe(description,func) \
@@ -711,6 +1217,365 @@ mutest_describe_full (const char *file,
 
 /* }}} */
 
+/* {{{ Typed expectations */
+
+/**
+ * mutest_compare_t:
+ * @MUTEST_COMPARE_EQ: the value is equal to the expected one
+ * @MUTEST_COMPARE_NE: the value is not equal to the expected one
+ * @MUTEST_COMPARE_LT: the value is less than the expected one
+ * @MUTEST_COMPARE_LE: the value is less than, or equal to, the expected one
+ * @MUTEST_COMPARE_GT: the value is greater than the expected one
+ * @MUTEST_COMPARE_GE: the value is greater than, or equal to, the expected one
+ * @MUTEST_COMPARE_IN_RANGE: the value is inside the expected range
+ *
+ * The comparisons performed by the typed expectations, like
+ * mutest_expect_int_eq().
+ */
+typedef enum {
+  MUTEST_COMPARE_EQ,
+  MUTEST_COMPARE_NE,
+  MUTEST_COMPARE_LT,
+  MUTEST_COMPARE_LE,
+  MUTEST_COMPARE_GT,
+  MUTEST_COMPARE_GE,
+  MUTEST_COMPARE_IN_RANGE
+} mutest_compare_t;
+
+MUTEST_PUBLIC
+void
+mutest_expect_pass_full (const char *file,
+                         int line,
+                         const char *func_name,
+                         const char *description);
+
+MUTEST_PUBLIC
+void
+mutest_expect_int_fail_full (const char *file,
+                             int line,
+                             const char *func_name,
+                             const char *description,
+                             mutest_compare_t compare,
+                             int value,
+                             int expected,
+                             int expected_max);
+
+MUTEST_PUBLIC
+void
+mutest_expect_float_fail_full (const char *file,
+                               int line,
+                               const char *func_name,
+                               const char *description,
+                               mutest_compare_t compare,
+                               double value,
+                               double expected,
+                               double expected_max);
+
+MUTEST_PUBLIC
+void
+mutest_expect_bool_fail_full (const char *file,
+                              int line,
+                              const char *func_name,
+                              const char *description,
+                              bool value,
+                              bool expected);
+
+MUTEST_PUBLIC
+void
+mutest_expect_pointer_fail_full (const char *file,
+                                 int line,
+                                 const char *func_name,
+                                 const char *description,
+                                 mutest_compare_t compare,
+                                 const void *value,
+                                 const void *expected);
+
+MUTEST_PUBLIC
+void
+mutest_expect_string_fail_full (const char *file,
+                                int line,
+                                const char *func_name,
+                                const char *description,
+                                mutest_compare_t compare,
+                                const char *value,
+                                const char *expected);
+
+/* The typed expectations compare their values inline, and only call
+ * into the library to record the result; a failed expectation is
+ * reported exactly like the equivalent mutest_expect() call.
+ */
+static inline void
+mutest_expect_int_check (const char *file,
+                         int line,
+                         const char *func_name,
+                         const char *description,
+                         mutest_compare_t compare,
+                         int value,
+                         int expected,
+                         int expected_max)
+{
+  bool res = false;
+
+  switch (compare)
+    {
+    case MUTEST_COMPARE_EQ: res = value == expected; break;
+    case MUTEST_COMPARE_NE: res = value != expected; break;
+    case MUTEST_COMPARE_LT: res = value < expected; break;
+    case MUTEST_COMPARE_LE: res = value <= expected; break;
+    case MUTEST_COMPARE_GT: res = value > expected; break;
+    case MUTEST_COMPARE_GE: res = value >= expected; break;
+    case MUTEST_COMPARE_IN_RANGE: res = value >= expected && value <= expected_max; break;
+    }
+
+  if (res)
+    mutest_expect_pass_full (file, line, func_name, description);
+  else
+    mutest_expect_int_fail_full (file, line, func_name, description,
+                                 compare, value, expected, expected_max);
+}
+
+static inline void
+mutest_expect_float_check (const char *file,
+                           int line,
+                           const char *func_name,
+                           const char *description,
+                           mutest_compare_t compare,
+                           double value,
+                           double expected,
+                           double expected_max)
+{
+  bool res = false;
+
+  /* Equality uses the same tolerance as mutest_to_be() */
+  switch (compare)
+    {
+    case MUTEST_COMPARE_EQ:
+      res = (value > expected ? value - expected : expected - value) <= MUTEST_DBL_EPSILON;
+      break;
+    case MUTEST_COMPARE_NE:
+      res = !((value > expected ? value - expected : expected - value) <= MUTEST_DBL_EPSILON);
+      break;
+    case MUTEST_COMPARE_LT: res = value < expected; break;
+    case MUTEST_COMPARE_LE: res = value <= expected; break;
+    case MUTEST_COMPARE_GT: res = value > expected; break;
+    case MUTEST_COMPARE_GE: res = value >= expected; break;
+    case MUTEST_COMPARE_IN_RANGE: res = value >= expected && value <= expected_max; break;
+    }
+
+  if (res)
+    mutest_expect_pass_full (file, line, func_name, description);
+  else
+    mutest_expect_float_fail_full (file, line, func_name, description,
+                                   compare, value, expected, expected_max);
+}
+
+static inline void
+mutest_expect_bool_check (const char *file,
+                          int line,
+                          const char *func_name,
+                          const char *description,
+                          bool value,
+                          bool expected)
+{
+  if (value == expected)
+    mutest_expect_pass_full (file, line, func_name, description);
+  else
+    mutest_expect_bool_fail_full (file, line, func_name, description,
+                                  value, expected);
+}
+
+static inline void
+mutest_expect_pointer_check (const char *file,
+                             int line,
+                             const char *func_name,
+                             const char *description,
+                             mutest_compare_t compare,
+                             const void *value,
+                             const void *expected)
+{
+  bool res = compare == MUTEST_COMPARE_NE ? value != expected : value == expected;
+
+  if (res)
+    mutest_expect_pass_full (file, line, func_name, description);
+  else
+    mutest_expect_pointer_fail_full (file, line, func_name, description,
+                                     compare, value, expected);
+}
+
+static inline void
+mutest_expect_string_check (const char *file,
+                            int line,
+                            const char *func_name,
+                            const char *description,
+                            mutest_compare_t compare,
+                            const char *value,
+                            const char *expected)
+{
+  bool res = value == NULL || expected == NULL
+           ? value == expected
+           : MUTEST_STRCMP (value, expected) == 0;
+
+  if (compare == MUTEST_COMPARE_NE)
+    res = !res;
+
+  if (res)
+    mutest_expect_pass_full (file, line, func_name, description);
+  else
+    mutest_expect_string_fail_full (file, line, func_name, description,
+                                    compare, value, expected);
+}
+
+/**
+ * mutest_expect_int_eq:
+ * @description: the description of an expectation
+ * @value: the integer value to check
+ * @expected: the expected value
+ *
+ * Checks that @value is equal to @expected; this is equivalent to
+ * using mutest_to_be() with mutest_int_value(), but the values are
+ * compared without wrapping them, or calling a matcher.
+ *
+ * The other typed expectations for integers are:
+ * mutest_expect_int_ne(), mutest_expect_int_lt(), mutest_expect_int_le(),
+ * mutest_expect_int_gt(), mutest_expect_int_ge(), and
+ * mutest_expect_int_in_range().
+ */
+#define mutest_expect_int_eq(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_EQ, (value), (expected), 0)
+#define mutest_expect_int_ne(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_NE, (value), (expected), 0)
+#define mutest_expect_int_lt(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_LT, (value), (expected), 0)
+#define mutest_expect_int_le(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_LE, (value), (expected), 0)
+#define mutest_expect_int_gt(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_GT, (value), (expected), 0)
+#define mutest_expect_int_ge(description,value,expected) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_GE, (value), (expected), 0)
+
+/**
+ * mutest_expect_int_in_range:
+ * @description: the description of an expectation
+ * @value: the integer value to check
+ * @min: the minimum expected value
+ * @max: the maximum expected value
+ *
+ * Checks that @value is inside the [ @min, @max ] range.
+ */
+#define mutest_expect_int_in_range(description,value,min,max) \
+  mutest_expect_int_check (__FILE__, __LINE__, __func__, description, \
+                           MUTEST_COMPARE_IN_RANGE, (value), (min), (max))
+
+/**
+ * mutest_expect_float_eq:
+ * @description: the description of an expectation
+ * @value: the floating point value to check
+ * @expected: the expected value
+ *
+ * Checks that @value is equal to @expected, within `DBL_EPSILON`;
+ * this is equivalent to using mutest_to_be() with mutest_float_value().
+ *
+ * The other typed expectations for floating point values are:
+ * mutest_expect_float_ne(), mutest_expect_float_lt(),
+ * mutest_expect_float_le(), mutest_expect_float_gt(),
+ * mutest_expect_float_ge(), and mutest_expect_float_in_range().
+ */
+#define mutest_expect_float_eq(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_EQ, (value), (expected), 0.0)
+#define mutest_expect_float_ne(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_NE, (value), (expected), 0.0)
+#define mutest_expect_float_lt(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_LT, (value), (expected), 0.0)
+#define mutest_expect_float_le(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_LE, (value), (expected), 0.0)
+#define mutest_expect_float_gt(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_GT, (value), (expected), 0.0)
+#define mutest_expect_float_ge(description,value,expected) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_GE, (value), (expected), 0.0)
+
+/**
+ * mutest_expect_float_in_range:
+ * @description: the description of an expectation
+ * @value: the floating point value to check
+ * @min: the minimum expected value
+ * @max: the maximum expected value
+ *
+ * Checks that @value is inside the [ @min, @max ] range.
+ */
+#define mutest_expect_float_in_range(description,value,min,max) \
+  mutest_expect_float_check (__FILE__, __LINE__, __func__, description, \
+                             MUTEST_COMPARE_IN_RANGE, (value), (min), (max))
+
+/**
+ * mutest_expect_true:
+ * @description: the description of an expectation
+ * @value: the boolean value to check
+ *
+ * Checks that @value is true; this is equivalent to using
+ * mutest_to_be_true() with mutest_bool_value().
+ *
+ * See also: mutest_expect_false()
+ */
+#define mutest_expect_true(description,value) \
+  mutest_expect_bool_check (__FILE__, __LINE__, __func__, description, \
+                            (value) ? true : false, true)
+#define mutest_expect_false(description,value) \
+  mutest_expect_bool_check (__FILE__, __LINE__, __func__, description, \
+                            (value) ? true : false, false)
+
+/**
+ * mutest_expect_ptr_eq:
+ * @description: the description of an expectation
+ * @value: the pointer to check
+ * @expected: the expected pointer
+ *
+ * Checks that @value is the same pointer as @expected; this is
+ * equivalent to using mutest_to_be() with mutest_pointer().
+ *
+ * See also: mutest_expect_ptr_ne(), mutest_expect_null()
+ */
+#define mutest_expect_ptr_eq(description,value,expected) \
+  mutest_expect_pointer_check (__FILE__, __LINE__, __func__, description, \
+                               MUTEST_COMPARE_EQ, (value), (expected))
+#define mutest_expect_ptr_ne(description,value,expected) \
+  mutest_expect_pointer_check (__FILE__, __LINE__, __func__, description, \
+                               MUTEST_COMPARE_NE, (value), (expected))
+#define mutest_expect_null(description,value) \
+  mutest_expect_pointer_check (__FILE__, __LINE__, __func__, description, \
+                               MUTEST_COMPARE_EQ, (value), NULL)
+
+/**
+ * mutest_expect_str_eq:
+ * @description: the description of an expectation
+ * @value: the string to check
+ * @expected: the expected string
+ *
+ * Checks that @value is the same string as @expected; this is
+ * equivalent to using mutest_to_be() with mutest_string_value().
+ *
+ * See also: mutest_expect_str_ne()
+ */
+#define mutest_expect_str_eq(description,value,expected) \
+  mutest_expect_string_check (__FILE__, __LINE__, __func__, description, \
+                              MUTEST_COMPARE_EQ, (value), (expected))
+#define mutest_expect_str_ne(description,value,expected) \
+  mutest_expect_string_check (__FILE__, __LINE__, __func__, description, \
+                              MUTEST_COMPARE_NE, (value), (expected))
+
+/* }}} */
+
 /* {{{ Hooks */
 
 /**
@@ -847,6 +1712,50 @@ mutest_after_each (mutest_hook_func_t hook);
 
 /* }}} */
 
+/* {{{ Listeners */
+
+/**
+ * mutest_add_listener:
+ * @func: a #mutest_listener_func_t function
+ * @data: (nullable): data to pass to @func
+ *
+ * Adds a listener, notified of the events of the run alongside the
+ * output formats set with the `MUTEST_OUTPUT` environment variable.
+ *
+ * Listeners can collect the results in a custom format, or send them
+ * elsewhere; for instance, to record the duration of each spec:
+ *
+ * |[<!-- language="C" -->
+ * static void
+ * record_durations (mutest_listener_event_t event,
+ *                   const mutest_listener_info_t *info,
+ *                   void *data)
+ * {
+ *   if (event == MUTEST_LISTENER_SPEC_END)
+ *     fprintf (data, "%s\t%lld\n",
+ *              info->description,
+ *              (long long) info->duration);
+ * }
+ *
+ * MUTEST_MAIN (
+ *   mutest_add_listener (record_durations, stderr);
+ *
+ *   mutest_describe ("durations", durations_suite);
+ * )
+ * ]|
+ *
+ * Listeners must be added before running the suites; a listener added
+ * after µTest was initialized is notified of the start of the run when
+ * it's added. Listeners are called in the order they were added, and
+ * on one thread at a time, though not necessarily on the main thread.
+ */
+MUTEST_PUBLIC
+void
+mutest_add_listener (mutest_listener_func_t func,
+                     void *data);
+
+/* }}} */
+
 /* {{{ Entry points */
 
 /**
@@ -861,10 +1770,37 @@ MUTEST_PUBLIC
 void
 mutest_init (void);
 
+/**
+ * mutest_init_with_args:
+ * @argc: the number of arguments in @argv
+ * @argv: the command line arguments of the test binary
+ *
+ * Initializes µTest, like mutest_init(), and parses the command
+ * line arguments.
+ *
+ * Every argument that does not start with a dash is a filter for the
+ * specs to run, matched against the full name of each spec, composed
+ * by the description of its suite and its own description, separated
+ * by " › ". Filters are globs, unless enclosed in slashes, in which
+ * case they are POSIX extended regular expressions. The filters are
+ * added to the one in the `MUTEST_FILTER` environment variable, if
+ * any, and a spec is run if it matches at least one of them.
+ *
+ * The only option is `--fail-fast`, which stops the run after the
+ * first failure, like the `MUTEST_FAIL_FAST` environment variable;
+ * any other argument starting with a dash is an error, unless it
+ * comes after a `--` argument.
+ */
+MUTEST_PUBLIC
+void
+mutest_init_with_args (int argc,
+                       char *argv[]);
+
 /**
  * mutest_report:
  *
- * Reports the total results of all suites.
+ * Runs all the suites defined by mutest_describe(), and reports
+ * the total results.
  *
  * Returns: an exit code that can be used to quit the test binary
  *   using consistent values
@@ -879,12 +1815,13 @@ mutest_report (void);
  *
  * A convenience macro that defines the main entry point for a test binary.
  *
- * This function initialises µTest and reports the results.
+ * This function initialises µTest, using the command line arguments,
+ * and reports the results.
  */
 #define MUTEST_MAIN(_C_) \
-int main (int argc MUTEST_UNUSED, \
-          char *argv[] MUTEST_UNUSED) { \
-  mutest_init (); \
+int main (int argc, \
+          char *argv[]) { \
+  mutest_init_with_args (argc, argv); \
 \
   { _C_ } \
 \
@@ -0,0 +1,342 @@
+/* mutest-alloc.c: Allocation tracking
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The allocations of each spec are counted by replacing the malloc()
+// family of functions of the C library with our own, which forward the
+// calls to the C library after counting them.
+//
+// The allocator is replaced for the whole process, so the counting is
+// only active while running the function of a spec, and only for the
+// thread running it; the allocations made by µTest itself, for instance
+// when wrapping values and checking expectations, are excluded by
+// suspending the counting.
+//
+// Replacing the allocator clashes with programs that link to another
+// one, like jemalloc, so the wrappers are only built when enabling the
+// alloc_tracking option. Only the GNU C library exposes its allocator
+// under a different name, so that we can forward the calls to it; on
+// other platforms, or when another tool like a sanitizer replaces the
+// allocator, the allocations are not counted.
+#if defined(MUTEST_ENABLE_ALLOC_TRACKING) && defined(HAVE___LIBC_MALLOC) && defined(__GNUC__)
+#define MUTEST_HAVE_ALLOC_TRACKING 1
+#endif
+
+typedef struct {
+  bool active;
+
+  // Nested calls to mutest_alloc_suspend()
+  int suspended;
+
+  int64_t n_allocs;
+  int64_t n_frees;
+  int64_t n_bytes;
+} alloc_tracker_t;
+
+#ifdef MUTEST_HAVE_ALLOC_TRACKING
+
+#include <malloc.h>
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void *__libc_valloc (size_t size);
+extern void *__libc_pvalloc (size_t size);
+
+// The tracker is accessed by every allocation, so it must not be
+// allocated lazily, like the thread local storage of shared libraries
+// would be by default
+static MUTEST_THREAD_LOCAL alloc_tracker_t tracker
+  __attribute__((tls_model ("initial-exec")));
+
+#define MUTEST_ALLOC_EXPORT __attribute__((visibility ("default")))
+
+static inline bool
+tracker_is_counting (void)
+{
+  return mutest_unlikely (tracker.active && tracker.suspended == 0);
+}
+
+static inline void
+tracker_count_alloc (size_t size)
+{
+  if (tracker_is_counting ())
+    {
+      tracker.n_allocs += 1;
+      tracker.n_bytes += (int64_t) size;
+    }
+}
+
+MUTEST_ALLOC_EXPORT void *
+malloc (size_t size)
+{
+  tracker_count_alloc (size);
+
+  return __libc_malloc (size);
+}
+
+MUTEST_ALLOC_EXPORT void *
+calloc (size_t n_members,
+        size_t size)
+{
+  tracker_count_alloc (n_members * size);
+
+  return __libc_calloc (n_members, size);
+}
+
+MUTEST_ALLOC_EXPORT void *
+realloc (void *ptr,
+         size_t size)
+{
+  if (tracker_is_counting ())
+    {
+      if (ptr != NULL && size == 0)
+        tracker.n_frees += 1;
+      else
+        {
+          tracker.n_allocs += 1;
+          tracker.n_bytes += (int64_t) size;
+        }
+    }
+
+  return __libc_realloc (ptr, size);
+}
+
+#ifdef HAVE_REALLOCARRAY
+MUTEST_ALLOC_EXPORT void *
+reallocarray (void *ptr,
+              size_t n_members,
+              size_t size)
+{
+  if (size != 0 && n_members > SIZE_MAX / size)
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  return realloc (ptr, n_members * size);
+}
+#endif
+
+MUTEST_ALLOC_EXPORT void
+free (void *ptr)
+{
+  if (ptr != NULL && tracker_is_counting ())
+    tracker.n_frees += 1;
+
+  __libc_free (ptr);
+}
+
+// The aligned allocation functions must be replaced as well, otherwise
+// the memory they return would be released by free() into an allocator
+// that may not have allocated it
+MUTEST_ALLOC_EXPORT void *
+memalign (size_t alignment,
+          size_t size)
+{
+  tracker_count_alloc (size);
+
+  return __libc_memalign (alignment, size);
+}
+
+MUTEST_ALLOC_EXPORT void *
+aligned_alloc (size_t alignment,
+               size_t size)
+{
+  tracker_count_alloc (size);
+
+  return __libc_memalign (alignment, size);
+}
+
+MUTEST_ALLOC_EXPORT int
+posix_memalign (void **res,
+                size_t alignment,
+                size_t size)
+{
+  if (alignment % sizeof (void *) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+
+  void *ptr = __libc_memalign (alignment, size);
+  if (ptr == NULL)
+    return ENOMEM;
+
+  tracker_count_alloc (size);
+
+  *res = ptr;
+
+  return 0;
+}
+
+MUTEST_ALLOC_EXPORT void *
+valloc (size_t size)
+{
+  tracker_count_alloc (size);
+
+  return __libc_valloc (size);
+}
+
+MUTEST_ALLOC_EXPORT void *
+pvalloc (size_t size)
+{
+  tracker_count_alloc (size);
+
+  return __libc_pvalloc (size);
+}
+
+// Checks that our allocator is the one being called, as it is
+// replaced by sanitizers, and by Valgrind
+static bool
+alloc_check_available (void)
+{
+  static int available = -1;
+
+  if (mutest_likely (available >= 0))
+    return available != 0;
+
+  // Keep the compiler from eliding the allocation
+  void *(* volatile alloc_func) (size_t) = malloc;
+  alloc_tracker_t saved = tracker;
+
+  memset (&tracker, 0, sizeof (alloc_tracker_t));
+  tracker.active = true;
+
+  void *p = alloc_func (1);
+
+  bool res = tracker.n_allocs == 1;
+
+  tracker = saved;
+
+  __libc_free (p);
+
+  available = res ? 1 : 0;
+
+  return res;
+}
+
+#else /* MUTEST_HAVE_ALLOC_TRACKING */
+
+static MUTEST_THREAD_LOCAL alloc_tracker_t tracker;
+
+static bool
+alloc_check_available (void)
+{
+  return false;
+}
+
+#endif /* MUTEST_HAVE_ALLOC_TRACKING */
+
+// mutest_alloc_start:
+//
+// Starts counting the allocations of the current thread.
+void
+mutest_alloc_start (void)
+{
+  memset (&tracker, 0, sizeof (alloc_tracker_t));
+
+  tracker.active = alloc_check_available ();
+}
+
+// mutest_alloc_stop:
+// @stats: return location for the allocations
+//
+// Stops counting the allocations of the current thread.
+void
+mutest_alloc_stop (mutest_alloc_stats_t *stats)
+{
+  stats->available = tracker.active;
+  stats->n_allocs = tracker.n_allocs;
+  stats->n_frees = tracker.n_frees;
+  stats->n_bytes = tracker.n_bytes;
+
+  tracker.active = false;
+}
+
+// mutest_alloc_suspend:
+//
+// Excludes the following allocations of the current thread from the
+// count, until mutest_alloc_resume() is called; the calls can nest.
+void
+mutest_alloc_suspend (void)
+{
+  tracker.suspended += 1;
+}
+
+void
+mutest_alloc_resume (void)
+{
+  tracker.suspended -= 1;
+}
+
+// mutest_alloc_measure:
+// @func: the function to measure
+// @data: the data to pass to @func
+// @stats: return location for the allocations
+//
+// Counts the allocations made by calling @func, even if the counting
+// is suspended; if the current spec is being counted, the allocations
+// are added to it.
+void
+mutest_alloc_measure (mutest_expect_closure_func_t func,
+                      void *data,
+                      mutest_alloc_stats_t *stats)
+{
+  alloc_tracker_t saved = tracker;
+
+  mutest_alloc_start ();
+
+  func (data);
+
+  mutest_alloc_stop (stats);
+
+  tracker = saved;
+
+  if (stats->available)
+    {
+      tracker.n_allocs += stats->n_allocs;
+      tracker.n_frees += stats->n_frees;
+      tracker.n_bytes += stats->n_bytes;
+    }
+}
+
+// mutest_format_alloc_stats:
+// @stats: the allocations of a spec
+// @buf: the buffer to write to
+// @len: the size of @buf
+//
+// Formats the allocations of a spec for display.
+void
+mutest_format_alloc_stats (const mutest_alloc_stats_t *stats,
+                           char *buf,
+                           size_t len)
+{
+  if (!stats->available)
+    {
+      snprintf (buf, len, "unavailable (%s)",
+#if defined(MUTEST_HAVE_ALLOC_TRACKING)
+                "the allocator was replaced"
+#elif defined(MUTEST_ENABLE_ALLOC_TRACKING)
+                "not supported on this platform"
+#else
+                "not enabled in this build"
+#endif
+               );
+      return;
+    }
+
+  snprintf (buf, len, "%lld (%lld bytes), %lld frees",
+            (long long) stats->n_allocs,
+            (long long) stats->n_bytes,
+            (long long) stats->n_frees);
+}
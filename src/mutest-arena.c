@@ -0,0 +1,208 @@
+/* mutest-arena.c: Storage for expectation values
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The values passed to mutest_expect(), and the ones collected by the
+// matchers, only live until the end of the expectation, so they are
+// allocated from a stack of chunks, owned by the thread running the
+// spec, instead of the heap.
+//
+// Each allocation is preceded by a block header, which links to the
+// previous block; freeing the last block pops it off the stack, along
+// with any other block freed before it, so that the values of an
+// expectation are released regardless of the order in which they were
+// created. Blocks that are never freed are released at the end of the
+// spec, when the whole arena is reset.
+//
+// The chunks are kept around when the arena is popped, and the first
+// chunk is kept when the arena is reset, so that the expectations of
+// a spec do not allocate memory once the arena has grown enough.
+#define ARENA_CHUNK_SIZE        (64 * 1024)
+
+// Enough for any of the types of a value
+#define ARENA_ALIGNMENT         16
+
+#define ARENA_ALIGN(n)          (((n) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+typedef struct _arena_chunk_t arena_chunk_t;
+typedef struct _arena_block_t arena_block_t;
+
+struct _arena_chunk_t
+{
+  arena_chunk_t *next;
+
+  size_t size;
+  size_t used;
+};
+
+struct _arena_block_t
+{
+  arena_block_t *prev;
+  arena_chunk_t *chunk;
+
+  bool in_use;
+};
+
+#define ARENA_CHUNK_HEADER_SIZE ARENA_ALIGN (sizeof (arena_chunk_t))
+#define ARENA_BLOCK_HEADER_SIZE ARENA_ALIGN (sizeof (arena_block_t))
+
+typedef struct {
+  arena_chunk_t *first_chunk;
+
+  // The chunk containing the last block, or the first chunk
+  arena_chunk_t *current_chunk;
+
+  arena_block_t *last_block;
+} arena_t;
+
+static MUTEST_THREAD_LOCAL arena_t arena;
+
+static inline char *
+chunk_data (arena_chunk_t *chunk)
+{
+  return (char *) chunk + ARENA_CHUNK_HEADER_SIZE;
+}
+
+static arena_chunk_t *
+chunk_new (size_t size)
+{
+  if (size < ARENA_CHUNK_SIZE)
+    size = ARENA_CHUNK_SIZE;
+
+  arena_chunk_t *chunk = malloc (ARENA_CHUNK_HEADER_SIZE + size);
+  if (chunk == NULL)
+    mutest_oom_abort ();
+
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+// Finds an empty chunk with room for @size bytes after the current one
+static arena_chunk_t *
+arena_next_chunk (size_t size)
+{
+  arena_chunk_t *current = arena.current_chunk;
+
+  // The chunks after the current one are empty, so we can reuse the
+  // next one, unless it's too small
+  if (current->next != NULL && current->next->size >= size)
+    return current->next;
+
+  arena_chunk_t *chunk = chunk_new (size);
+
+  chunk->next = current->next;
+  current->next = chunk;
+
+  return chunk;
+}
+
+// mutest_arena_alloc:
+// @size: the size of the allocation
+//
+// Allocates @size bytes, cleared to zero, from the arena of the
+// current thread.
+//
+// Returns: the allocated memory; use mutest_arena_free() to release it
+void *
+mutest_arena_alloc (size_t size)
+{
+  size_t block_size = ARENA_BLOCK_HEADER_SIZE + ARENA_ALIGN (size);
+
+  if (mutest_unlikely (arena.first_chunk == NULL))
+    {
+      arena.first_chunk = chunk_new (block_size);
+      arena.current_chunk = arena.first_chunk;
+    }
+
+  arena_chunk_t *chunk = arena.current_chunk;
+
+  if (mutest_unlikely (chunk->size - chunk->used < block_size))
+    {
+      chunk = arena_next_chunk (block_size);
+      chunk->used = 0;
+
+      arena.current_chunk = chunk;
+    }
+
+  arena_block_t *block = (arena_block_t *) (chunk_data (chunk) + chunk->used);
+
+  chunk->used += block_size;
+
+  block->prev = arena.last_block;
+  block->chunk = chunk;
+  block->in_use = true;
+
+  arena.last_block = block;
+
+  char *res = (char *) block + ARENA_BLOCK_HEADER_SIZE;
+
+  memset (res, 0, size);
+
+  return res;
+}
+
+// mutest_arena_free:
+// @data: memory allocated by mutest_arena_alloc()
+//
+// Releases @data; the memory is reused once all the allocations
+// after it are released as well.
+void
+mutest_arena_free (void *data)
+{
+  if (data == NULL)
+    return;
+
+  arena_block_t *block = (arena_block_t *) ((char *) data - ARENA_BLOCK_HEADER_SIZE);
+
+  block->in_use = false;
+
+  while (arena.last_block != NULL && !arena.last_block->in_use)
+    {
+      arena_block_t *last = arena.last_block;
+
+      last->chunk->used = (size_t) ((char *) last - chunk_data (last->chunk));
+
+      arena.last_block = last->prev;
+      arena.current_chunk = arena.last_block != NULL
+                          ? arena.last_block->chunk
+                          : arena.first_chunk;
+    }
+}
+
+// mutest_arena_reset:
+//
+// Releases all the allocations in the arena of the current thread,
+// and the memory it used, except for the first chunk.
+void
+mutest_arena_reset (void)
+{
+  if (arena.first_chunk == NULL)
+    return;
+
+  arena_chunk_t *chunk = arena.first_chunk->next;
+
+  while (chunk != NULL)
+    {
+      arena_chunk_t *next = chunk->next;
+
+      free (chunk);
+
+      chunk = next;
+    }
+
+  arena.first_chunk->next = NULL;
+  arena.first_chunk->used = 0;
+  arena.current_chunk = arena.first_chunk;
+  arena.last_block = NULL;
+}
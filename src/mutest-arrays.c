@@ -0,0 +1,588 @@
+/* mutest-arrays.c: Numeric arrays
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// The matchers for numeric arrays check every element of the arrays in
+// a single expectation, so they need to be fast even for arrays with
+// millions of elements, and they must not report millions of failures.
+//
+// Each check is implemented by a pair of kernels for each type of the
+// elements: the first counts the mismatching elements in a block of a
+// fixed size, using a loop without branches that the compiler can turn
+// into SIMD instructions; the second checks a single element, and it's
+// only called for the blocks that contain mismatches, in order to find
+// their indices. Since arrays are expected to match most of the time,
+// the second kernel is rarely used.
+//
+// The kernel for a block of a closeness check only uses the absolute
+// and relative tolerances, which can be vectorized; the tolerance in
+// units in the last place is only checked for the elements of the
+// blocks that have mismatches.
+//
+// SSE2, the baseline on x86-64, cannot compare 64 bits integers, and
+// only has 16 bytes vectors, so on x86-64 the kernels for the blocks
+// are also compiled for AVX2, and selected when the program is loaded,
+// if the CPU supports it. The selection uses an indirect function,
+// which is only supported by the GNU C library; musl, for instance,
+// does not have them.
+#define ARRAY_BLOCK_SIZE        64
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__GLIBC__)
+#define ARRAY_KERNEL_TARGETS    __attribute__((target_clones ("avx2", "default")))
+#else
+#define ARRAY_KERNEL_TARGETS
+#endif
+
+typedef struct {
+  const void *a;
+  const void *b;
+
+  double abs_tolerance;
+  double rel_tolerance;
+  int max_ulps;
+
+  int64_t int_min;
+  int64_t int_max;
+  double float_min;
+  double float_max;
+} array_args_t;
+
+typedef struct {
+  // Returns: the number of mismatches in the block at @start
+  size_t (* count_block) (const array_args_t *args,
+                          size_t start);
+
+  // Returns: true if the element at @i is a mismatch
+  bool (* mismatch_at) (const array_args_t *args,
+                        size_t i);
+} array_kernel_t;
+
+static const struct {
+  const char *name;
+  size_t element_size;
+} array_types[] = {
+  [MUTEST_ARRAY_INT32] = { "int32", sizeof (int32_t) },
+  [MUTEST_ARRAY_INT64] = { "int64", sizeof (int64_t) },
+  [MUTEST_ARRAY_FLOAT] = { "float", sizeof (float) },
+  [MUTEST_ARRAY_DOUBLE] = { "double", sizeof (double) },
+};
+
+static inline bool
+close_abs_rel (double x,
+               double y,
+               double abs_tolerance,
+               double rel_tolerance)
+{
+  double diff = fabs (x - y);
+  double magnitude = fabs (x) > fabs (y) ? fabs (x) : fabs (y);
+
+  // No short circuits, so that the checks can be vectorized
+  return (x == y) | (diff <= abs_tolerance) | (diff <= rel_tolerance * magnitude);
+}
+
+// Maps the bits of a floating point value to integers with the same
+// ordering, so that the distance between them is the number of values
+// that can be represented between them
+static inline int64_t
+double_to_ordered (double x)
+{
+  int64_t bits;
+
+  memcpy (&bits, &x, sizeof (int64_t));
+
+  return bits < 0 ? INT64_MIN - bits : bits;
+}
+
+static inline int32_t
+float_to_ordered (float x)
+{
+  int32_t bits;
+
+  memcpy (&bits, &x, sizeof (int32_t));
+
+  return bits < 0 ? INT32_MIN - bits : bits;
+}
+
+static bool
+close_ulps_double (double x,
+                   double y,
+                   int max_ulps)
+{
+  if (max_ulps <= 0 || isnan (x) || isnan (y))
+    return false;
+
+  int64_t ox = double_to_ordered (x);
+  int64_t oy = double_to_ordered (y);
+  uint64_t distance = ox > oy
+                    ? (uint64_t) ox - (uint64_t) oy
+                    : (uint64_t) oy - (uint64_t) ox;
+
+  return distance <= (uint64_t) max_ulps;
+}
+
+static bool
+close_ulps_float (float x,
+                  float y,
+                  int max_ulps)
+{
+  if (max_ulps <= 0 || isnan (x) || isnan (y))
+    return false;
+
+  int64_t ox = float_to_ordered (x);
+  int64_t oy = float_to_ordered (y);
+  uint64_t distance = (uint64_t) (ox > oy ? ox - oy : oy - ox);
+
+  return distance <= (uint64_t) max_ulps;
+}
+
+// Defines the kernels of a check, where @fast_mismatch and @mismatch
+// are expressions using the elements a[i] and b[i]; @fast_mismatch
+// must be true for every element for which @mismatch is true
+#define DEFINE_ARRAY_KERNEL(name, type, fast_mismatch, mismatch) \
+ARRAY_KERNEL_TARGETS \
+static size_t \
+name##_count_block (const array_args_t *args, \
+                    size_t start) \
+{ \
+  const type *a = (const type *) args->a + start; \
+  const type *b = (const type *) args->b + start; \
+  size_t n = 0; \
+\
+  (void) b; \
+\
+  for (size_t i = 0; i < ARRAY_BLOCK_SIZE; i++) \
+    n += (fast_mismatch) ? 1 : 0; \
+\
+  return n; \
+} \
+\
+static bool \
+name##_mismatch_at (const array_args_t *args, \
+                    size_t i) \
+{ \
+  const type *a = (const type *) args->a; \
+  const type *b = (const type *) args->b; \
+\
+  (void) b; \
+\
+  return (mismatch); \
+}
+
+#define CLOSE_ABS_REL(x, y) \
+  close_abs_rel ((double) (x), (double) (y), args->abs_tolerance, args->rel_tolerance)
+
+DEFINE_ARRAY_KERNEL (equal_int32, int32_t, a[i] != b[i], a[i] != b[i])
+DEFINE_ARRAY_KERNEL (equal_int64, int64_t, a[i] != b[i], a[i] != b[i])
+DEFINE_ARRAY_KERNEL (equal_float, float, a[i] != b[i], a[i] != b[i])
+DEFINE_ARRAY_KERNEL (equal_double, double, a[i] != b[i], a[i] != b[i])
+
+DEFINE_ARRAY_KERNEL (close_int32, int32_t,
+                     !CLOSE_ABS_REL (a[i], b[i]),
+                     !CLOSE_ABS_REL (a[i], b[i]))
+DEFINE_ARRAY_KERNEL (close_int64, int64_t,
+                     !CLOSE_ABS_REL (a[i], b[i]),
+                     !CLOSE_ABS_REL (a[i], b[i]))
+DEFINE_ARRAY_KERNEL (close_float, float,
+                     !CLOSE_ABS_REL (a[i], b[i]),
+                     !CLOSE_ABS_REL (a[i], b[i]) && !close_ulps_float (a[i], b[i], args->max_ulps))
+DEFINE_ARRAY_KERNEL (close_double, double,
+                     !CLOSE_ABS_REL (a[i], b[i]),
+                     !CLOSE_ABS_REL (a[i], b[i]) && !close_ulps_double (a[i], b[i], args->max_ulps))
+
+// NaN is never in range
+DEFINE_ARRAY_KERNEL (range_int32, int32_t,
+                     (a[i] < args->int_min) | (a[i] > args->int_max),
+                     (a[i] < args->int_min) | (a[i] > args->int_max))
+DEFINE_ARRAY_KERNEL (range_int64, int64_t,
+                     (a[i] < args->int_min) | (a[i] > args->int_max),
+                     (a[i] < args->int_min) | (a[i] > args->int_max))
+DEFINE_ARRAY_KERNEL (range_float, float,
+                     !((a[i] >= args->float_min) & (a[i] <= args->float_max)),
+                     !((a[i] >= args->float_min) & (a[i] <= args->float_max)))
+DEFINE_ARRAY_KERNEL (range_double, double,
+                     !((a[i] >= args->float_min) & (a[i] <= args->float_max)),
+                     !((a[i] >= args->float_min) & (a[i] <= args->float_max)))
+
+// Here, b[i] is the element after a[i]; NaN is never sorted
+DEFINE_ARRAY_KERNEL (sorted_int32, int32_t, b[i] < a[i], b[i] < a[i])
+DEFINE_ARRAY_KERNEL (sorted_int64, int64_t, b[i] < a[i], b[i] < a[i])
+DEFINE_ARRAY_KERNEL (sorted_float, float, !(a[i] <= b[i]), !(a[i] <= b[i]))
+DEFINE_ARRAY_KERNEL (sorted_double, double, !(a[i] <= b[i]), !(a[i] <= b[i]))
+
+#define ARRAY_KERNEL(name) { name##_count_block, name##_mismatch_at }
+
+static const array_kernel_t array_kernels[][4] = {
+  [MUTEST_ARRAY_INT32] = {
+    [MUTEST_ARRAY_CHECK_EQUAL] = ARRAY_KERNEL (equal_int32),
+    [MUTEST_ARRAY_CHECK_CLOSE] = ARRAY_KERNEL (close_int32),
+    [MUTEST_ARRAY_CHECK_RANGE] = ARRAY_KERNEL (range_int32),
+    [MUTEST_ARRAY_CHECK_SORTED] = ARRAY_KERNEL (sorted_int32),
+  },
+  [MUTEST_ARRAY_INT64] = {
+    [MUTEST_ARRAY_CHECK_EQUAL] = ARRAY_KERNEL (equal_int64),
+    [MUTEST_ARRAY_CHECK_CLOSE] = ARRAY_KERNEL (close_int64),
+    [MUTEST_ARRAY_CHECK_RANGE] = ARRAY_KERNEL (range_int64),
+    [MUTEST_ARRAY_CHECK_SORTED] = ARRAY_KERNEL (sorted_int64),
+  },
+  [MUTEST_ARRAY_FLOAT] = {
+    [MUTEST_ARRAY_CHECK_EQUAL] = ARRAY_KERNEL (equal_float),
+    [MUTEST_ARRAY_CHECK_CLOSE] = ARRAY_KERNEL (close_float),
+    [MUTEST_ARRAY_CHECK_RANGE] = ARRAY_KERNEL (range_float),
+    [MUTEST_ARRAY_CHECK_SORTED] = ARRAY_KERNEL (sorted_float),
+  },
+  [MUTEST_ARRAY_DOUBLE] = {
+    [MUTEST_ARRAY_CHECK_EQUAL] = ARRAY_KERNEL (equal_double),
+    [MUTEST_ARRAY_CHECK_CLOSE] = ARRAY_KERNEL (close_double),
+    [MUTEST_ARRAY_CHECK_RANGE] = ARRAY_KERNEL (range_double),
+    [MUTEST_ARRAY_CHECK_SORTED] = ARRAY_KERNEL (sorted_double),
+  },
+};
+
+// Checks the elements from @start to @end one at a time, and stores
+// the indices of the first mismatches
+//
+// Returns: the number of mismatches
+static size_t
+array_scan (const array_kernel_t *kernel,
+            const array_args_t *args,
+            size_t start,
+            size_t end,
+            size_t *indices,
+            size_t *n_indices)
+{
+  size_t n_mismatches = 0;
+
+  for (size_t i = start; i < end; i++)
+    {
+      if (!kernel->mismatch_at (args, i))
+        continue;
+
+      if (*n_indices < MUTEST_ARRAY_REPORTED_MISMATCHES)
+        {
+          indices[*n_indices] = i;
+          *n_indices += 1;
+        }
+
+      n_mismatches += 1;
+    }
+
+  return n_mismatches;
+}
+
+static size_t
+array_count_mismatches (const array_kernel_t *kernel,
+                        const array_args_t *args,
+                        size_t n_elements,
+                        size_t *indices,
+                        size_t *n_indices)
+{
+  size_t n_mismatches = 0;
+  size_t i = 0;
+
+  *n_indices = 0;
+
+  for (; i + ARRAY_BLOCK_SIZE <= n_elements; i += ARRAY_BLOCK_SIZE)
+    {
+      if (mutest_likely (kernel->count_block (args, i) == 0))
+        continue;
+
+      n_mismatches += array_scan (kernel, args, i, i + ARRAY_BLOCK_SIZE, indices, n_indices);
+    }
+
+  n_mismatches += array_scan (kernel, args, i, n_elements, indices, n_indices);
+
+  return n_mismatches;
+}
+
+static void
+array_get_element (const mutest_expect_res_t *res,
+                   size_t i,
+                   mutest_array_mismatch_t *element)
+{
+  const void *data = res->expect.v_array.data;
+
+  element->index = i;
+
+  switch (res->expect.v_array.array_type)
+    {
+    case MUTEST_ARRAY_INT32:
+      element->value.v_int = ((const int32_t *) data)[i];
+      break;
+
+    case MUTEST_ARRAY_INT64:
+      element->value.v_int = ((const int64_t *) data)[i];
+      break;
+
+    case MUTEST_ARRAY_FLOAT:
+      element->value.v_float = ((const float *) data)[i];
+      break;
+
+    case MUTEST_ARRAY_DOUBLE:
+      element->value.v_float = ((const double *) data)[i];
+      break;
+    }
+}
+
+// Stores the mismatches at @indices inside @res
+static void
+array_set_mismatches (mutest_expect_res_t *res,
+                      size_t n_mismatches,
+                      const size_t *indices,
+                      size_t n_indices)
+{
+  mutest_arena_free (res->expect.v_array.reported);
+
+  res->expect.v_array.checked = true;
+  res->expect.v_array.n_mismatches = n_mismatches;
+  res->expect.v_array.n_reported = n_indices;
+  res->expect.v_array.reported = NULL;
+
+  if (n_indices == 0)
+    return;
+
+  mutest_array_mismatch_t *reported = mutest_arena_alloc (n_indices * sizeof (mutest_array_mismatch_t));
+
+  for (size_t i = 0; i < n_indices; i++)
+    array_get_element (res, indices[i], &reported[i]);
+
+  res->expect.v_array.reported = (uint8_t *) reported;
+}
+
+// Copies the mismatch at @i out of @res; the mismatches replayed from
+// a worker are not aligned, so they cannot be accessed in place
+static void
+array_get_mismatch (const mutest_expect_res_t *res,
+                    size_t i,
+                    mutest_array_mismatch_t *element)
+{
+  memcpy (element,
+          res->expect.v_array.reported + i * sizeof (mutest_array_mismatch_t),
+          sizeof (mutest_array_mismatch_t));
+}
+
+static bool
+array_is_integer (const mutest_expect_res_t *res)
+{
+  return res->expect.v_array.array_type == MUTEST_ARRAY_INT32 ||
+         res->expect.v_array.array_type == MUTEST_ARRAY_INT64;
+}
+
+// mutest_array_check:
+// @check_type: the check to perform
+// @value: the array to check
+// @check: the value collected by the matcher
+//
+// Checks the elements of @value; the mismatches are stored inside
+// @value, and inside @check if it's an array as well.
+//
+// Returns: true if all the elements passed the check
+bool
+mutest_array_check (mutest_array_check_t check_type,
+                    mutest_expect_res_t *value,
+                    mutest_expect_res_t *check)
+{
+  if (value->expect_type != MUTEST_EXPECT_ARRAY)
+    return false;
+
+  array_args_t args = {
+    .a = value->expect.v_array.data,
+    .b = value->expect.v_array.data,
+    .abs_tolerance = 0.0,
+    .rel_tolerance = 0.0,
+    .max_ulps = 0,
+    .int_min = 0,
+    .int_max = 0,
+    .float_min = 0.0,
+    .float_max = 0.0,
+  };
+
+  size_t length = value->expect.v_array.length;
+  size_t n_elements = length;
+  size_t index_offset = 0;
+  bool compare_arrays = false;
+
+  switch (check_type)
+    {
+    case MUTEST_ARRAY_CHECK_EQUAL:
+    case MUTEST_ARRAY_CHECK_CLOSE:
+      if (check == NULL || check->expect_type != MUTEST_EXPECT_ARRAY ||
+          check->expect.v_array.array_type != value->expect.v_array.array_type ||
+          check->expect.v_array.length != length)
+        return false;
+
+      args.b = check->expect.v_array.data;
+      args.abs_tolerance = check->expect.v_array.abs_tolerance;
+      args.rel_tolerance = check->expect.v_array.rel_tolerance;
+      args.max_ulps = check->expect.v_array.max_ulps;
+      compare_arrays = true;
+      break;
+
+    case MUTEST_ARRAY_CHECK_RANGE:
+      if (check != NULL && check->expect_type == MUTEST_EXPECT_INT_RANGE &&
+          array_is_integer (value))
+        {
+          args.int_min = check->expect.v_irange.min;
+          args.int_max = check->expect.v_irange.max;
+        }
+      else if (check != NULL && check->expect_type == MUTEST_EXPECT_FLOAT_RANGE &&
+               !array_is_integer (value))
+        {
+          args.float_min = check->expect.v_frange.min;
+          args.float_max = check->expect.v_frange.max;
+        }
+      else
+        return false;
+      break;
+
+    case MUTEST_ARRAY_CHECK_SORTED:
+      if (length < 2)
+        n_elements = 0;
+      else
+        {
+          // Compare each element with the one after it, and report
+          // the one that is out of order
+          size_t element_size = array_types[value->expect.v_array.array_type].element_size;
+
+          args.b = (const char *) args.a + element_size;
+          n_elements = length - 1;
+          index_offset = 1;
+        }
+      break;
+    }
+
+  const array_kernel_t *kernel = &array_kernels[value->expect.v_array.array_type][check_type];
+
+  size_t indices[MUTEST_ARRAY_REPORTED_MISMATCHES];
+  size_t n_indices = 0;
+  size_t n_mismatches = 0;
+
+  if (n_elements > 0)
+    n_mismatches = array_count_mismatches (kernel, &args, n_elements, indices, &n_indices);
+
+  for (size_t i = 0; i < n_indices; i++)
+    indices[i] += index_offset;
+
+  array_set_mismatches (value, n_mismatches, indices, n_indices);
+
+  if (compare_arrays)
+    array_set_mismatches (check, n_mismatches, indices, n_indices);
+
+  return n_mismatches == 0;
+}
+
+// Advances @pos past the result of snprintf(), without overflowing @len
+static size_t
+format_advance (size_t pos,
+                int res,
+                size_t len)
+{
+  if (res < 0 || pos + (size_t) res >= len)
+    return len;
+
+  return pos + (size_t) res;
+}
+
+static size_t
+format_tolerances (const mutest_expect_res_t *res,
+                   char *buf,
+                   size_t pos,
+                   size_t len)
+{
+  double abs_tolerance = res->expect.v_array.abs_tolerance;
+  double rel_tolerance = res->expect.v_array.rel_tolerance;
+  int max_ulps = array_is_integer (res) ? 0 : res->expect.v_array.max_ulps;
+
+  if (abs_tolerance <= 0 && rel_tolerance <= 0 && max_ulps <= 0)
+    return pos;
+
+  const char *sep = " (within";
+
+  if (pos < len && abs_tolerance > 0)
+    {
+      pos = format_advance (pos, snprintf (buf + pos, len - pos, "%s %g", sep, abs_tolerance), len);
+      sep = ",";
+    }
+
+  if (pos < len && rel_tolerance > 0)
+    {
+      pos = format_advance (pos, snprintf (buf + pos, len - pos, "%s %g relative", sep, rel_tolerance), len);
+      sep = ",";
+    }
+
+  if (pos < len && max_ulps > 0)
+    pos = format_advance (pos, snprintf (buf + pos, len - pos, "%s %d ULPs", sep, max_ulps), len);
+
+  if (pos < len)
+    pos = format_advance (pos, snprintf (buf + pos, len - pos, ")"), len);
+
+  return pos;
+}
+
+// mutest_format_array:
+// @res: a numeric array value
+// @buf: the buffer to write to
+// @len: the size of @buf
+//
+// Formats the length of @res and, if it was checked, the number of
+// mismatching elements, followed by the first ones.
+void
+mutest_format_array (const mutest_expect_res_t *res,
+                     char *buf,
+                     size_t len)
+{
+  bool is_integer = array_is_integer (res);
+
+  // Enough digits to tell apart elements that differ in the last place
+  int precision = res->expect.v_array.array_type == MUTEST_ARRAY_FLOAT ? 9 : 17;
+
+  size_t pos = format_advance (0, snprintf (buf, len, "%zu %s elements",
+                                            res->expect.v_array.length,
+                                            array_types[res->expect.v_array.array_type].name),
+                               len);
+
+  pos = format_tolerances (res, buf, pos, len);
+
+  if (!res->expect.v_array.checked || res->expect.v_array.n_mismatches == 0)
+    return;
+
+  if (pos < len)
+    pos = format_advance (pos, snprintf (buf + pos, len - pos, ", %zu mismatches:",
+                                         res->expect.v_array.n_mismatches),
+                          len);
+
+  for (size_t i = 0; i < res->expect.v_array.n_reported && pos < len; i++)
+    {
+      mutest_array_mismatch_t element;
+
+      array_get_mismatch (res, i, &element);
+
+      int written;
+
+      if (is_integer)
+        written = snprintf (buf + pos, len - pos, "%s [%zu] = %" PRId64,
+                            i > 0 ? "," : "",
+                            element.index,
+                            element.value.v_int);
+      else
+        written = snprintf (buf + pos, len - pos, "%s [%zu] = %.*g",
+                            i > 0 ? "," : "",
+                            element.index,
+                            precision,
+                            element.value.v_float);
+
+      pos = format_advance (pos, written, len);
+    }
+
+  if (pos < len && res->expect.v_array.n_mismatches > res->expect.v_array.n_reported)
+    snprintf (buf + pos, len - pos, ", …");
+}
@@ -0,0 +1,474 @@
+/* mutest-async.c: Asynchronous output
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_CLOCK_GETTIME) && defined(__GNUC__)
+#define MUTEST_HAVE_ASYNC_OUTPUT 1
+#endif
+
+#ifdef MUTEST_HAVE_ASYNC_OUTPUT
+
+// With asynchronous output, the formatters run on a dedicated output
+// thread, so that a slow terminal, or pipe, does not stall the specs,
+// or skew their timings.
+//
+// The threads calling the formatters record each call as an event,
+// using the same encoding used by the worker processes, and copy it
+// into a ring buffer; the output thread takes the events out of the
+// ring, in order, and formats them through the current formatter.
+//
+// The ring supports multiple producers, and has a single consumer.
+// Producers reserve the space for an event by moving the head of the
+// ring forward, copy the event, and then commit it by storing its
+// length at the start of the reserved space; the consumer waits for
+// the event at the tail of the ring to be committed, formats it, and
+// clears its space before moving the tail forward. Events that would
+// wrap around the end of the ring are preceded by a padding record,
+// so that each event is contiguous, and can be formatted in place.
+//
+// When the ring is full, producers wait for the output thread to make
+// room: events are never dropped, so a slow output eventually stalls
+// the specs, like synchronous output would. Events too large for the
+// ring are formatted by the producer, once the ring is empty.
+//
+// Before the results of the run, before forking, and at exit, the
+// output is synchronized by waiting until all the events queued so
+// far are formatted; mutest_assert_message() does the same, so that
+// the error comes after the results preceding it. When the process
+// crashes, the crash handler waits for a bounded amount of time, as
+// the output thread may be stuck on a full pipe, or the crash may
+// have interrupted a producer.
+//
+// Threads only take the lock of the ring to sleep, when they have to
+// wait, and to wake up a sleeping thread; waking up a thread for each
+// event would cost more than formatting it, especially when both run
+// on the same CPU, so:
+//
+//  - producers only wake up the output thread at the end of a spec, or
+//    once a batch of events is queued; otherwise, the output thread
+//    wakes up on its own after a short delay, so that the progress of
+//    long running specs is still visible
+//  - producers waiting for room sleep until half of the ring is free
+//  - the output thread moves the tail after formatting a batch of
+//    events, or when the ring is empty
+#define ASYNC_RING_SIZE         (1024 * 1024)
+
+// Events are aligned to the size of their header
+#define ASYNC_ALIGNMENT         8
+
+#define ASYNC_ALIGN(n)          (((n) + ASYNC_ALIGNMENT - 1) & ~((size_t) ASYNC_ALIGNMENT - 1))
+
+#define ASYNC_HEADER_SIZE       ASYNC_ALIGNMENT
+
+// The header of a padding record
+#define ASYNC_PADDING           UINT32_MAX
+
+// The number of bytes formatted before moving the tail
+#define ASYNC_BATCH_SIZE        (ASYNC_RING_SIZE / 16)
+
+// The time the output thread sleeps before checking for new events,
+// and the time the crash handler waits for the output thread
+#define ASYNC_LATENCY_MS        50
+#define ASYNC_CRASH_TIMEOUT_MS  1000
+
+// Keeps the positions written by the producers and by the output
+// thread on separate cache lines
+#define ASYNC_CACHE_LINE        __attribute__((aligned (64)))
+
+static struct {
+  bool enabled;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  char *data;
+
+  // Byte offsets, wrapped around the size of the ring; the head is
+  // where the next event will be reserved, and the tail is the
+  // first event not yet formatted
+  uint64_t head ASYNC_CACHE_LINE;
+  uint64_t tail ASYNC_CACHE_LINE;
+
+  // The threads waiting for the tail, and the first position
+  // they are waiting for
+  int n_waiting ASYNC_CACHE_LINE;
+  uint64_t wait_tail;
+
+  // Whether the output thread is waiting for an event
+  int consumer_waiting;
+} ring;
+
+// Set while formatting the queued events, which must not be queued
+// again; that is, always on the output thread
+static MUTEST_THREAD_LOCAL bool is_formatting;
+
+// The event being recorded by the current thread
+static MUTEST_THREAD_LOCAL mutest_event_buffer_t queued_event;
+
+// The last tail seen by the current thread, to avoid reading the
+// one written by the output thread for every event
+static MUTEST_THREAD_LOCAL uint64_t known_tail;
+
+static inline uint32_t *
+ring_header (uint64_t pos)
+{
+  return (uint32_t *) (void *) (ring.data + (pos & (ASYNC_RING_SIZE - 1)));
+}
+
+// Wakes up the output thread, if it is waiting
+static void
+ring_wake_consumer (void)
+{
+  if (__atomic_load_n (&ring.consumer_waiting, __ATOMIC_SEQ_CST) == 0)
+    return;
+
+  // Only wake up the output thread once; if it has to wait again,
+  // it will say so
+  pthread_mutex_lock (&ring.lock);
+  __atomic_store_n (&ring.consumer_waiting, 0, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast (&ring.cond);
+  pthread_mutex_unlock (&ring.lock);
+}
+
+// Waits until the tail of the ring moves past @pos
+static void
+ring_wait_for_tail (uint64_t pos)
+{
+  if (__atomic_load_n (&ring.tail, __ATOMIC_ACQUIRE) >= pos)
+    return;
+
+  ring_wake_consumer ();
+
+  pthread_mutex_lock (&ring.lock);
+  __atomic_add_fetch (&ring.n_waiting, 1, __ATOMIC_SEQ_CST);
+
+  for (;;)
+    {
+      if (__atomic_load_n (&ring.wait_tail, __ATOMIC_SEQ_CST) > pos)
+        __atomic_store_n (&ring.wait_tail, pos, __ATOMIC_SEQ_CST);
+
+      if (__atomic_load_n (&ring.tail, __ATOMIC_SEQ_CST) >= pos)
+        break;
+
+      pthread_cond_wait (&ring.cond, &ring.lock);
+    }
+
+  __atomic_sub_fetch (&ring.n_waiting, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock (&ring.lock);
+}
+
+// Moves the tail to @pos, and wakes up the threads waiting for it
+static void
+ring_set_tail (uint64_t pos)
+{
+  __atomic_store_n (&ring.tail, pos, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n (&ring.n_waiting, __ATOMIC_SEQ_CST) == 0 ||
+      __atomic_load_n (&ring.wait_tail, __ATOMIC_SEQ_CST) > pos)
+    return;
+
+  // Threads still waiting set the position they wait for again
+  pthread_mutex_lock (&ring.lock);
+  __atomic_store_n (&ring.wait_tail, UINT64_MAX, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast (&ring.cond);
+  pthread_mutex_unlock (&ring.lock);
+}
+
+// Waits until the event at @pos is committed
+static uint32_t
+ring_wait_for_event (uint64_t pos)
+{
+  uint32_t *header = ring_header (pos);
+  uint32_t res;
+
+  pthread_mutex_lock (&ring.lock);
+
+  for (;;)
+    {
+      __atomic_store_n (&ring.consumer_waiting, 1, __ATOMIC_SEQ_CST);
+
+      res = __atomic_load_n (header, __ATOMIC_SEQ_CST);
+      if (res != 0)
+        break;
+
+      struct timespec ts;
+
+      clock_gettime (CLOCK_REALTIME, &ts);
+
+      ts.tv_nsec += ASYNC_LATENCY_MS * 1000000L;
+      if (ts.tv_nsec >= 1000000000)
+        {
+          ts.tv_sec += 1;
+          ts.tv_nsec -= 1000000000;
+        }
+
+      pthread_cond_timedwait (&ring.cond, &ring.lock, &ts);
+    }
+
+  __atomic_store_n (&ring.consumer_waiting, 0, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock (&ring.lock);
+
+  return res;
+}
+
+static void *
+output_thread (void *data MUTEST_UNUSED)
+{
+  uint64_t tail = 0;
+
+  is_formatting = true;
+
+  for (;;)
+    {
+      uint32_t *header = ring_header (tail);
+      uint32_t len = __atomic_load_n (header, __ATOMIC_ACQUIRE);
+
+      // Let the producers know how far we got before waiting
+      if (len == 0)
+        {
+          if (__atomic_load_n (&ring.tail, __ATOMIC_RELAXED) != tail)
+            ring_set_tail (tail);
+
+          len = ring_wait_for_event (tail);
+        }
+
+      size_t size;
+
+      if (len == ASYNC_PADDING)
+        size = ASYNC_RING_SIZE - (tail & (ASYNC_RING_SIZE - 1));
+      else
+        {
+          size = ASYNC_ALIGN (ASYNC_HEADER_SIZE + len);
+
+          mutest_event_format ((char *) header + ASYNC_HEADER_SIZE, len);
+        }
+
+      // The headers of the next events in this space must read as
+      // not committed
+      memset (header, 0, size);
+
+      tail += size;
+
+      if (tail - __atomic_load_n (&ring.tail, __ATOMIC_RELAXED) >= ASYNC_BATCH_SIZE)
+        ring_set_tail (tail);
+    }
+
+  return NULL;
+}
+
+// Reserves @size bytes, preceded by padding if needed, and returns
+// the position of the reserved space
+static uint64_t
+ring_reserve (size_t size)
+{
+  uint64_t head = __atomic_load_n (&ring.head, __ATOMIC_RELAXED);
+
+  for (;;)
+    {
+      size_t offset = head & (ASYNC_RING_SIZE - 1);
+      size_t padding = ASYNC_RING_SIZE - offset < size ? ASYNC_RING_SIZE - offset : 0;
+      uint64_t end = head + padding + size;
+
+      if (end - known_tail > ASYNC_RING_SIZE)
+        known_tail = __atomic_load_n (&ring.tail, __ATOMIC_ACQUIRE);
+
+      // Back-pressure: wait for the output thread to make room, and
+      // then some more
+      if (end - known_tail > ASYNC_RING_SIZE)
+        {
+          uint64_t pos = end - ASYNC_RING_SIZE / 2;
+
+          ring_wait_for_tail (pos < head ? pos : head);
+
+          head = __atomic_load_n (&ring.head, __ATOMIC_RELAXED);
+          continue;
+        }
+
+      if (__atomic_compare_exchange_n (&ring.head, &head, end, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+          if (padding != 0)
+            __atomic_store_n (ring_header (head), ASYNC_PADDING, __ATOMIC_RELEASE);
+
+          return head + padding;
+        }
+    }
+}
+
+// Child processes do not have an output thread
+static void
+async_after_fork (void)
+{
+  ring.enabled = false;
+}
+
+// mutest_async_init:
+// @enabled: whether to format the output asynchronously
+//
+// Starts the output thread.
+void
+mutest_async_init (bool enabled)
+{
+  if (!enabled)
+    return;
+
+  ring.data = calloc (1, ASYNC_RING_SIZE);
+  if (ring.data == NULL)
+    mutest_oom_abort ();
+
+  pthread_mutex_init (&ring.lock, NULL);
+  pthread_cond_init (&ring.cond, NULL);
+
+  ring.wait_tail = UINT64_MAX;
+
+  if (pthread_create (&ring.thread, NULL, output_thread, NULL) != 0)
+    mutest_assert_if_reached ("unable to create output thread");
+
+  pthread_atfork (NULL, NULL, async_after_fork);
+
+  ring.enabled = true;
+
+  // The queued results must be written out if the process crashes
+  mutest_output_catch_crashes ();
+}
+
+// mutest_async_get_queue:
+//
+// Retrieves the buffer used to record the next event of the current
+// thread, if its events must be queued for the output thread; once
+// recorded, the event is queued with mutest_async_push().
+//
+// Returns: (nullable): the event buffer of the current thread
+mutest_event_buffer_t *
+mutest_async_get_queue (void)
+{
+  if (!ring.enabled || is_formatting)
+    return NULL;
+
+  queued_event.len = 0;
+  queued_event.truncated = false;
+
+  return &queued_event;
+}
+
+// mutest_async_push:
+// @buffer: the buffer returned by mutest_async_get_queue()
+//
+// Queues the event recorded in @buffer.
+void
+mutest_async_push (mutest_event_buffer_t *buffer)
+{
+  size_t len = buffer->len;
+  size_t size = ASYNC_ALIGN (ASYNC_HEADER_SIZE + len);
+
+  if (size > ASYNC_RING_SIZE / 2)
+    {
+      mutest_async_sync ();
+
+      is_formatting = true;
+      mutest_event_format (buffer->data, len);
+      is_formatting = false;
+
+      return;
+    }
+
+  uint64_t pos = ring_reserve (size);
+
+  memcpy ((char *) ring_header (pos) + ASYNC_HEADER_SIZE, buffer->data, len);
+
+  __atomic_store_n (ring_header (pos), (uint32_t) len, __ATOMIC_SEQ_CST);
+
+  // The events of a spec are formatted in batches, but the results
+  // of each spec are formatted as soon as possible
+  mutest_event_type_t event_type = (uint8_t) buffer->data[sizeof (uint32_t)];
+
+  if ((event_type != MUTEST_EVENT_EXPECT_RESULT && event_type != MUTEST_EVENT_EXPECT_FAIL) ||
+      pos + size - known_tail >= ASYNC_BATCH_SIZE)
+    ring_wake_consumer ();
+}
+
+// mutest_async_sync:
+//
+// Waits until the output thread has formatted all the events queued
+// so far.
+void
+mutest_async_sync (void)
+{
+  if (!ring.enabled || is_formatting)
+    return;
+
+  ring_wait_for_tail (__atomic_load_n (&ring.head, __ATOMIC_ACQUIRE));
+}
+
+// mutest_async_try_sync:
+//
+// Like mutest_async_sync(), but without locking, and giving up after
+// a while; it can be called by a signal handler.
+//
+// Returns: true if all the queued events were formatted
+bool
+mutest_async_try_sync (void)
+{
+  if (!ring.enabled || is_formatting)
+    return true;
+
+  uint64_t head = __atomic_load_n (&ring.head, __ATOMIC_ACQUIRE);
+
+  for (int i = 0; i < ASYNC_CRASH_TIMEOUT_MS; i++)
+    {
+      if (__atomic_load_n (&ring.tail, __ATOMIC_ACQUIRE) >= head)
+        return true;
+
+      struct timespec ts = { 0, 1000000 };
+
+      nanosleep (&ts, NULL);
+    }
+
+  return false;
+}
+
+#else /* MUTEST_HAVE_ASYNC_OUTPUT */
+
+void
+mutest_async_init (bool enabled MUTEST_UNUSED)
+{
+}
+
+mutest_event_buffer_t *
+mutest_async_get_queue (void)
+{
+  return NULL;
+}
+
+void
+mutest_async_push (mutest_event_buffer_t *buffer MUTEST_UNUSED)
+{
+}
+
+void
+mutest_async_sync (void)
+{
+}
+
+bool
+mutest_async_try_sync (void)
+{
+  return true;
+}
+
+#endif /* MUTEST_HAVE_ASYNC_OUTPUT */
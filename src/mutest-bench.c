@@ -0,0 +1,205 @@
+/* mutest-bench.c: Benchmark specs
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A benchmark is a spec whose function is called repeatedly, after a
+// first call that checks its expectations.
+//
+// The measurement is split into samples, each timing a batch of calls;
+// the size of a batch is calibrated so that each sample takes long
+// enough to make the resolution of the clock irrelevant, and the batch
+// is then repeated a few times without recording anything, to warm up
+// caches and branch predictors. The samples are summarized using their
+// median and median absolute deviation, which are not skewed by the
+// outliers caused by preemption, or by page faults.
+#define BENCH_SAMPLES           20
+#define BENCH_WARMUP_SAMPLES    3
+
+// Never grow the batch by more than this factor in a calibration round,
+// as the first rounds are the noisiest
+#define BENCH_MAX_GROWTH        100
+
+// Times @iterations calls of the benchmark
+//
+// Returns: the elapsed time, in nanoseconds
+static int64_t
+bench_sample (mutest_spec_t *spec,
+              int64_t iterations)
+{
+  mutest_spec_func_t func = spec->func;
+
+  int64_t start = mutest_clock_get_time ();
+
+  for (int64_t i = 0; i < iterations; i++)
+    func (spec);
+
+  return mutest_clock_get_time () - start;
+}
+
+// Finds the number of calls for each sample to take @sample_time
+static int64_t
+bench_calibrate (mutest_spec_t *spec,
+                 int64_t sample_time)
+{
+  int64_t iterations = 1;
+
+  for (;;)
+    {
+      int64_t elapsed = bench_sample (spec, iterations);
+
+      if (elapsed >= sample_time)
+        return iterations;
+
+      int64_t next;
+
+      if (elapsed <= 0)
+        next = iterations * BENCH_MAX_GROWTH;
+      else
+        {
+          // Aim a bit higher than the target, to converge faster
+          double predicted = (double) iterations * sample_time * 1.2 / elapsed;
+
+          next = predicted > (double) iterations * BENCH_MAX_GROWTH
+               ? iterations * BENCH_MAX_GROWTH
+               : (int64_t) predicted;
+        }
+
+      if (next <= iterations)
+        next = iterations + 1;
+
+      iterations = next;
+    }
+}
+
+static int
+compare_double (const void *a,
+                const void *b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  if (da < db)
+    return -1;
+  if (da > db)
+    return 1;
+
+  return 0;
+}
+
+// Returns: the median of the sorted @values
+static double
+sorted_median (const double *values,
+               int n_values)
+{
+  if (n_values % 2 == 1)
+    return values[n_values / 2];
+
+  return (values[n_values / 2 - 1] + values[n_values / 2]) / 2.0;
+}
+
+// Computes the median, the median absolute deviation, and the 95%
+// confidence interval of the median, using the order statistics of
+// the samples, so that no distribution is assumed
+static void
+bench_summarize (double *samples,
+                 int n_samples,
+                 mutest_bench_results_t *res)
+{
+  qsort (samples, n_samples, sizeof (double), compare_double);
+
+  double median = sorted_median (samples, n_samples);
+
+  double *deviations = malloc (n_samples * sizeof (double));
+  if (deviations == NULL)
+    mutest_oom_abort ();
+
+  for (int i = 0; i < n_samples; i++)
+    deviations[i] = fabs (samples[i] - median);
+
+  qsort (deviations, n_samples, sizeof (double), compare_double);
+
+  double mad = sorted_median (deviations, n_samples);
+
+  free (deviations);
+
+  // The ranks bounding the median with a 95% confidence, using the
+  // normal approximation of the binomial distribution
+  double half_width = 1.96 * sqrt ((double) n_samples) / 2.0;
+  int low = (int) floor (n_samples / 2.0 - half_width);
+  int high = (int) ceil (n_samples / 2.0 + half_width) - 1;
+
+  if (low < 0)
+    low = 0;
+  if (high > n_samples - 1)
+    high = n_samples - 1;
+
+  res->n_samples = n_samples;
+  res->median = median;
+  res->mad = mad;
+  res->ci_low = samples[low];
+  res->ci_high = samples[high];
+}
+
+// mutest_bench_run:
+// @spec: a benchmark spec, whose function was already called once
+//
+// Measures the function of @spec, and stores the results inside
+// the spec.
+void
+mutest_bench_run (mutest_spec_t *spec)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  memset (&spec->bench, 0, sizeof (mutest_bench_results_t));
+
+  if (state->bench_time <= 0)
+    return;
+
+  int64_t sample_time = state->bench_time * 1000 / BENCH_SAMPLES;
+  if (sample_time < 1)
+    sample_time = 1;
+
+  spec->bench_running = true;
+
+  int64_t iterations = bench_calibrate (spec, sample_time);
+
+  for (int i = 0; i < BENCH_WARMUP_SAMPLES; i++)
+    bench_sample (spec, iterations);
+
+  double samples[BENCH_SAMPLES];
+
+  for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+      int64_t elapsed = bench_sample (spec, iterations);
+
+      samples[i] = (double) elapsed / (double) iterations;
+    }
+
+  spec->bench_running = false;
+
+  spec->bench.iterations = iterations;
+  bench_summarize (samples, BENCH_SAMPLES, &spec->bench);
+}
+
+void
+mutest_bench_full (const char *file,
+                   int line,
+                   const char *func_name,
+                   const char *description,
+                   mutest_spec_func_t func)
+{
+  mutest_it_full (file, line, func_name, description, func);
+
+  mutest_suite_t *suite = mutest_get_current_suite ();
+
+  suite->last_spec->is_bench = true;
+}
@@ -0,0 +1,214 @@
+/* mutest-bytes.c: Byte array comparison
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MUTEST_HAVE_SSE2 1
+#endif
+
+// Byte arrays can be several megabytes large, so the first different
+// byte is found using the widest vector instructions available: AVX2,
+// if the CPU supports it, or SSE2, which all x86-64 CPUs support; on
+// other platforms, the arrays are compared a word at a time.
+//
+// Failures only display the bytes around the first difference, so
+// that the size of the report does not depend on the size of the
+// arrays.
+
+// The number of bytes displayed, and the ones before the mismatch
+#define BYTE_ARRAY_WINDOW       16
+#define BYTE_ARRAY_CONTEXT      8
+
+static size_t
+mismatch_scalar (const uint8_t *a,
+                 const uint8_t *b,
+                 size_t len)
+{
+  size_t i = 0;
+
+  for (; i + sizeof (uint64_t) <= len; i += sizeof (uint64_t))
+    {
+      uint64_t wa, wb;
+
+      memcpy (&wa, a + i, sizeof (uint64_t));
+      memcpy (&wb, b + i, sizeof (uint64_t));
+
+      if (wa != wb)
+        break;
+    }
+
+  for (; i < len; i++)
+    {
+      if (a[i] != b[i])
+        return i;
+    }
+
+  return len;
+}
+
+#ifdef MUTEST_HAVE_SSE2
+static size_t
+mismatch_sse2 (const uint8_t *a,
+               const uint8_t *b,
+               size_t len)
+{
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i va = _mm_loadu_si128 ((const __m128i *) (const void *) (a + i));
+      __m128i vb = _mm_loadu_si128 ((const __m128i *) (const void *) (b + i));
+      unsigned int mask = (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (va, vb));
+
+      if (mask != 0xffff)
+        return i + (size_t) __builtin_ctz (~mask);
+    }
+
+  return i + mismatch_scalar (a + i, b + i, len - i);
+}
+
+__attribute__((target ("avx2")))
+static size_t
+mismatch_avx2 (const uint8_t *a,
+               const uint8_t *b,
+               size_t len)
+{
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i va = _mm256_loadu_si256 ((const __m256i *) (const void *) (a + i));
+      __m256i vb = _mm256_loadu_si256 ((const __m256i *) (const void *) (b + i));
+      unsigned int mask = (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (va, vb));
+
+      if (mask != 0xffffffffu)
+        return i + (size_t) __builtin_ctz (~mask);
+    }
+
+  return i + mismatch_sse2 (a + i, b + i, len - i);
+}
+#endif /* MUTEST_HAVE_SSE2 */
+
+// mutest_bytes_mismatch:
+// @a: a buffer
+// @b: a buffer
+// @len: the size of both buffers
+//
+// Returns: the offset of the first different byte, or @len if the
+//   buffers are equal
+size_t
+mutest_bytes_mismatch (const void *a,
+                       const void *b,
+                       size_t len)
+{
+  if (len == 0 || a == b)
+    return len;
+
+#ifdef MUTEST_HAVE_SSE2
+  if (__builtin_cpu_supports ("avx2"))
+    return mismatch_avx2 (a, b, len);
+
+  return mismatch_sse2 (a, b, len);
+#else
+  return mismatch_scalar (a, b, len);
+#endif
+}
+
+// mutest_byte_array_get_window:
+// @res: a byte array value
+// @start: return location for the offset of the first displayed byte
+// @end: return location for the offset after the last displayed byte
+//
+// Retrieves the bytes of @res to display: the ones around the first
+// difference, if @res was compared, or the first ones.
+void
+mutest_byte_array_get_window (const mutest_expect_res_t *res,
+                              size_t *start,
+                              size_t *end)
+{
+  size_t size = res->expect.v_bytearray.element_size * res->expect.v_bytearray.length;
+  size_t first = 0;
+
+  if (res->expect.v_bytearray.has_mismatch &&
+      res->expect.v_bytearray.mismatch > BYTE_ARRAY_CONTEXT)
+    first = res->expect.v_bytearray.mismatch - BYTE_ARRAY_CONTEXT;
+
+  if (first > size)
+    first = size;
+
+  *start = first;
+  *end = size - first > BYTE_ARRAY_WINDOW ? first + BYTE_ARRAY_WINDOW : size;
+}
+
+// mutest_format_byte_array:
+// @res: a byte array value
+// @buf: the buffer to write to
+// @len: the size of @buf
+//
+// Formats the size of @res and a hex dump of the bytes around the
+// first difference, which is enclosed in brackets; a difference past
+// the end of the array is displayed as "[--]".
+void
+mutest_format_byte_array (const mutest_expect_res_t *res,
+                          char *buf,
+                          size_t len)
+{
+  size_t element_size = res->expect.v_bytearray.element_size;
+  size_t size = element_size * res->expect.v_bytearray.length;
+  bool has_mismatch = res->expect.v_bytearray.has_mismatch;
+  size_t mismatch = res->expect.v_bytearray.mismatch;
+
+  size_t start, end;
+  mutest_byte_array_get_window (res, &start, &end);
+
+  int pos;
+
+  if (has_mismatch && element_size > 1)
+    pos = snprintf (buf, len, "%zu bytes, differing at offset %zu (element %zu):",
+                    size, mismatch, mismatch / element_size);
+  else if (has_mismatch)
+    pos = snprintf (buf, len, "%zu bytes, differing at offset %zu:", size, mismatch);
+  else
+    pos = snprintf (buf, len, "%zu bytes:", size);
+
+  if (pos < 0 || (size_t) pos >= len)
+    return;
+
+  if (start > 0)
+    pos += snprintf (buf + pos, len - pos, " …");
+
+  const uint8_t *data = res->expect.v_bytearray.data;
+  size_t data_offset = res->expect.v_bytearray.data_offset;
+  size_t data_end = data_offset + res->expect.v_bytearray.data_size;
+
+  for (size_t i = start; i < end && (size_t) pos < len; i++)
+    {
+      // Only the displayed bytes are available in replayed values
+      if (i < data_offset || i >= data_end)
+        break;
+
+      uint8_t byte = data[i - data_offset];
+
+      if (has_mismatch && i == mismatch)
+        pos += snprintf (buf + pos, len - pos, " [%02x]", byte);
+      else
+        pos += snprintf (buf + pos, len - pos, " %02x", byte);
+    }
+
+  if ((size_t) pos >= len)
+    return;
+
+  if (has_mismatch && mismatch >= size)
+    snprintf (buf + pos, len - pos, " [--]");
+  else if (end < size)
+    snprintf (buf + pos, len - pos, " …");
+}
@@ -0,0 +1,237 @@
+/* mutest-clock.c: Clocks used to time specs
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The duration of specs, and of each call of a benchmark, is measured
+// using a selectable clock, in nanoseconds:
+//
+//  - "monotonic", the default, is the same clock used for the total
+//    duration of the run
+//  - "raw" is the monotonic clock, without the frequency adjustments
+//    made by NTP; it's only available on Linux
+//  - "cpu" is the CPU time of the thread running the spec, which does
+//    not include the time spent waiting, or preempted
+//  - "tsc" reads the time stamp counter of x86 CPUs, and converts it
+//    to nanoseconds; it is the cheapest clock to read, which matters
+//    when timing very short operations, but it's only available on
+//    CPUs with an invariant TSC
+//
+// The clock is selected once, before running any spec, so that worker
+// processes inherit the calibration of the TSC.
+typedef struct {
+  const char *name;
+
+  // Whether the clock measures the elapsed time
+  bool is_wall_time;
+
+  // Returns: true if the clock is available
+  bool (* init) (void);
+
+  int64_t (* get_time) (void);
+} clock_backend_t;
+
+static bool
+always_available (void)
+{
+  return true;
+}
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_RAW)
+static bool
+raw_init (void)
+{
+  struct timespec ts;
+
+  return clock_gettime (CLOCK_MONOTONIC_RAW, &ts) == 0;
+}
+
+static int64_t
+raw_get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &ts);
+
+  return (((int64_t) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+}
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+static bool
+cpu_init (void)
+{
+  struct timespec ts;
+
+  return clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0;
+}
+
+static int64_t
+cpu_get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return (((int64_t) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+}
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MUTEST_HAVE_TSC 1
+
+// The TSC is calibrated against the monotonic clock for this long
+#define TSC_CALIBRATION_TIME    20000000
+
+static struct {
+  uint64_t base_ticks;
+  int64_t base_time;
+  double nsec_per_tick;
+} tsc;
+
+static inline uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+
+  // The fence keeps rdtsc from being executed ahead of the code
+  // we are timing
+  __asm__ volatile ("lfence\n\trdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static void
+cpuid (uint32_t leaf,
+       uint32_t regs[4])
+{
+  __asm__ volatile ("cpuid"
+                    : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+                    : "a" (leaf), "c" (0));
+}
+
+static bool
+tsc_init (void)
+{
+  uint32_t regs[4];
+
+  // The invariant TSC bit is in the advanced power management leaf;
+  // without it, the TSC frequency changes with the CPU frequency
+  cpuid (0x80000000, regs);
+  if (regs[0] < 0x80000007)
+    return false;
+
+  cpuid (0x80000007, regs);
+  if ((regs[3] & (1 << 8)) == 0)
+    return false;
+
+  int64_t start_time = mutest_get_current_time_ns ();
+  uint64_t start_ticks = read_tsc ();
+
+  int64_t end_time;
+  do
+    end_time = mutest_get_current_time_ns ();
+  while (end_time - start_time < TSC_CALIBRATION_TIME);
+
+  uint64_t end_ticks = read_tsc ();
+
+  if (end_ticks <= start_ticks)
+    return false;
+
+  tsc.base_ticks = start_ticks;
+  tsc.base_time = start_time;
+  tsc.nsec_per_tick = (double) (end_time - start_time) / (double) (end_ticks - start_ticks);
+
+  return true;
+}
+
+static int64_t
+tsc_get_time (void)
+{
+  uint64_t ticks = read_tsc () - tsc.base_ticks;
+
+  return tsc.base_time + (int64_t) ((double) ticks * tsc.nsec_per_tick);
+}
+#endif
+
+static const clock_backend_t clocks[] = {
+  { "monotonic", true, always_available, mutest_get_current_time_ns },
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_RAW)
+  { "raw", true, raw_init, raw_get_time },
+#endif
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+  { "cpu", false, cpu_init, cpu_get_time },
+#endif
+#ifdef MUTEST_HAVE_TSC
+  { "tsc", true, tsc_init, tsc_get_time },
+#endif
+};
+
+static const size_t n_clocks = sizeof (clocks) / sizeof (clocks[0]);
+
+static const clock_backend_t *current_clock = &clocks[0];
+
+// mutest_clock_init:
+// @name: (nullable): the name of the clock; %NULL for the default one
+//
+// Selects the clock used to time specs; unknown, or unavailable,
+// clocks are a fatal error.
+void
+mutest_clock_init (const char *name)
+{
+  current_clock = &clocks[0];
+
+  if (name == NULL || *name == '\0')
+    return;
+
+  for (size_t i = 0; i < n_clocks; i++)
+    {
+      if (strcmp (clocks[i].name, name) != 0)
+        continue;
+
+      if (!clocks[i].init ())
+        {
+          fprintf (stderr, "ERROR: the '%s' clock is not available on this system\n", name);
+          exit (EXIT_FAILURE);
+        }
+
+      current_clock = &clocks[i];
+      return;
+    }
+
+  fprintf (stderr, "ERROR: unknown clock '%s'; available clocks:", name);
+  for (size_t i = 0; i < n_clocks; i++)
+    fprintf (stderr, " %s", clocks[i].name);
+  fprintf (stderr, "\n");
+
+  exit (EXIT_FAILURE);
+}
+
+// mutest_clock_get_time:
+//
+// Returns: the current time of the clock used to time specs,
+//   in nanoseconds
+int64_t
+mutest_clock_get_time (void)
+{
+  return current_clock->get_time ();
+}
+
+// mutest_clock_is_wall_time:
+//
+// Returns: true if the clock used to time specs measures the
+//   elapsed time, instead of the CPU time
+bool
+mutest_clock_is_wall_time (void)
+{
+  return current_clock->is_wall_time;
+}
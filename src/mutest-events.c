@@ -0,0 +1,1061 @@
+/* mutest-events.c: Event recording and replay
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Events are stored as a length-prefixed record, so that a reader can
+// stop at a truncated trailing record, e.g. if a worker process died
+// in the middle of writing its results:
+//
+//   uint32_t  length of the payload, including the type
+//   uint8_t   event type
+//   ...       payload
+//
+// Integers and floating point values are stored in the host byte
+// order, as the buffer never leaves the machine that generated it.
+// Strings are stored as a uint32_t length, including the trailing
+// NUL, followed by the string data; NULL strings have a length of
+// UINT32_MAX.
+
+#define NULL_STRING_LEN UINT32_MAX
+
+// The maximum length of the strings in an abort record
+#define MAX_ABORT_STRING_LEN 512
+
+void
+mutest_event_buffer_init (mutest_event_buffer_t *buffer)
+{
+  buffer->data = NULL;
+  buffer->len = 0;
+  buffer->size = 0;
+  buffer->is_static = false;
+  buffer->truncated = false;
+}
+
+// mutest_event_buffer_init_static:
+// @buffer: the buffer to initialize
+// @data: the storage of the buffer
+// @size: the size of @data
+//
+// Initializes @buffer with a fixed storage, for the cases where
+// we cannot allocate memory; data that does not fit in the storage
+// is discarded.
+void
+mutest_event_buffer_init_static (mutest_event_buffer_t *buffer,
+                                 char *data,
+                                 size_t size)
+{
+  buffer->data = data;
+  buffer->len = 0;
+  buffer->size = size;
+  buffer->is_static = true;
+  buffer->truncated = false;
+}
+
+void
+mutest_event_buffer_clear (mutest_event_buffer_t *buffer)
+{
+  if (!buffer->is_static)
+    free (buffer->data);
+
+  mutest_event_buffer_init (buffer);
+}
+
+static bool
+buffer_reserve (mutest_event_buffer_t *buffer,
+                size_t len)
+{
+  if (buffer->len + len <= buffer->size)
+    return true;
+
+  if (buffer->is_static)
+    return false;
+
+  size_t new_size = buffer->size > 0 ? buffer->size : 256;
+  while (new_size < buffer->len + len)
+    new_size *= 2;
+
+  char *data = realloc (buffer->data, new_size);
+  if (data == NULL)
+    mutest_oom_abort ();
+
+  buffer->data = data;
+  buffer->size = new_size;
+
+  return true;
+}
+
+void
+mutest_event_buffer_append (mutest_event_buffer_t *buffer,
+                            const void *data,
+                            size_t len)
+{
+  // Empty data, like a byte array without elements, may be NULL
+  if (len == 0)
+    return;
+
+  if (!buffer_reserve (buffer, len))
+    {
+      // The length of a truncated record is left to zero, so
+      // that it is discarded when replaying the buffer
+      buffer->truncated = true;
+      return;
+    }
+
+  memcpy (buffer->data + buffer->len, data, len);
+  buffer->len += len;
+}
+
+static void
+put_byte (mutest_event_buffer_t *buffer,
+          uint8_t value)
+{
+  mutest_event_buffer_append (buffer, &value, sizeof (uint8_t));
+}
+
+static void
+put_int (mutest_event_buffer_t *buffer,
+         int value)
+{
+  int32_t v = value;
+
+  mutest_event_buffer_append (buffer, &v, sizeof (int32_t));
+}
+
+static void
+put_int64 (mutest_event_buffer_t *buffer,
+           int64_t value)
+{
+  mutest_event_buffer_append (buffer, &value, sizeof (int64_t));
+}
+
+static void
+put_double (mutest_event_buffer_t *buffer,
+            double value)
+{
+  mutest_event_buffer_append (buffer, &value, sizeof (double));
+}
+
+static void
+put_string (mutest_event_buffer_t *buffer,
+            const char *str)
+{
+  if (str == NULL)
+    {
+      uint32_t len = NULL_STRING_LEN;
+      mutest_event_buffer_append (buffer, &len, sizeof (uint32_t));
+      return;
+    }
+
+  uint32_t len = (uint32_t) strlen (str) + 1;
+  mutest_event_buffer_append (buffer, &len, sizeof (uint32_t));
+  mutest_event_buffer_append (buffer, str, len);
+}
+
+static void
+put_string_n (mutest_event_buffer_t *buffer,
+              const char *str,
+              size_t max_len)
+{
+  if (str == NULL)
+    {
+      put_string (buffer, NULL);
+      return;
+    }
+
+  size_t str_len = strlen (str);
+  if (str_len > max_len)
+    str_len = max_len;
+
+  uint32_t len = (uint32_t) str_len + 1;
+  mutest_event_buffer_append (buffer, &len, sizeof (uint32_t));
+  mutest_event_buffer_append (buffer, str, str_len);
+  put_byte (buffer, '\0');
+}
+
+static void
+put_bytes (mutest_event_buffer_t *buffer,
+           const void *data,
+           size_t len)
+{
+  uint32_t len32 = (uint32_t) len;
+
+  mutest_event_buffer_append (buffer, &len32, sizeof (uint32_t));
+  mutest_event_buffer_append (buffer, data, len);
+}
+
+static void
+put_alloc_stats (mutest_event_buffer_t *buffer,
+                 const mutest_alloc_stats_t *stats)
+{
+  put_byte (buffer, stats->available ? 1 : 0);
+  put_int64 (buffer, stats->n_allocs);
+  put_int64 (buffer, stats->n_frees);
+  put_int64 (buffer, stats->n_bytes);
+}
+
+static void
+put_res (mutest_event_buffer_t *buffer,
+         const mutest_expect_res_t *res)
+{
+  if (res == NULL)
+    {
+      put_byte (buffer, MUTEST_EXPECT_INVALID);
+      return;
+    }
+
+  put_byte (buffer, res->expect_type);
+
+  switch (res->expect_type)
+    {
+    case MUTEST_EXPECT_INVALID:
+      break;
+
+    case MUTEST_EXPECT_BOOLEAN:
+      put_byte (buffer, res->expect.v_bool ? 1 : 0);
+      break;
+
+    case MUTEST_EXPECT_INT:
+      put_int (buffer, res->expect.v_int.value);
+      put_int (buffer, res->expect.v_int.tolerance);
+      break;
+
+    case MUTEST_EXPECT_INT_RANGE:
+      put_int (buffer, res->expect.v_irange.min);
+      put_int (buffer, res->expect.v_irange.max);
+      break;
+
+    case MUTEST_EXPECT_FLOAT:
+      put_double (buffer, res->expect.v_float.value);
+      put_double (buffer, res->expect.v_float.tolerance);
+      break;
+
+    case MUTEST_EXPECT_FLOAT_RANGE:
+      put_double (buffer, res->expect.v_frange.min);
+      put_double (buffer, res->expect.v_frange.max);
+      break;
+
+    case MUTEST_EXPECT_STR:
+      put_string (buffer, res->expect.v_str.str);
+      break;
+
+    case MUTEST_EXPECT_POINTER:
+      put_int64 (buffer, (int64_t) (intptr_t) res->expect.v_pointer);
+      break;
+
+    // The function cannot be called by the runner, so we only
+    // record what the matchers need to display it
+    case MUTEST_EXPECT_CLOSURE:
+      put_byte (buffer, res->expect.v_closure.called ? 1 : 0);
+      put_alloc_stats (buffer, &res->expect.v_closure.alloc);
+      break;
+
+    // Only the bytes that are displayed are recorded
+    case MUTEST_EXPECT_BYTE_ARRAY:
+      {
+        size_t start, end;
+
+        mutest_byte_array_get_window (res, &start, &end);
+
+        put_int64 (buffer, (int64_t) res->expect.v_bytearray.element_size);
+        put_int64 (buffer, (int64_t) res->expect.v_bytearray.length);
+        put_byte (buffer, res->expect.v_bytearray.has_mismatch ? 1 : 0);
+        put_int64 (buffer, (int64_t) res->expect.v_bytearray.mismatch);
+        put_int64 (buffer, (int64_t) start);
+        put_bytes (buffer, res->expect.v_bytearray.data != NULL
+                           ? res->expect.v_bytearray.data + start
+                           : NULL,
+                   end - start);
+      }
+      break;
+
+    // The elements are not recorded, only the reported mismatches
+    case MUTEST_EXPECT_ARRAY:
+      put_byte (buffer, res->expect.v_array.array_type);
+      put_int64 (buffer, (int64_t) res->expect.v_array.length);
+      put_double (buffer, res->expect.v_array.abs_tolerance);
+      put_double (buffer, res->expect.v_array.rel_tolerance);
+      put_int (buffer, res->expect.v_array.max_ulps);
+      put_byte (buffer, res->expect.v_array.checked ? 1 : 0);
+      put_int64 (buffer, (int64_t) res->expect.v_array.n_mismatches);
+      put_bytes (buffer, res->expect.v_array.reported,
+                 res->expect.v_array.n_reported * sizeof (mutest_array_mismatch_t));
+      break;
+    }
+}
+
+static size_t
+begin_event (mutest_event_buffer_t *buffer,
+             mutest_event_type_t event_type)
+{
+  size_t offset = buffer->len;
+  uint32_t len = 0;
+
+  mutest_event_buffer_append (buffer, &len, sizeof (uint32_t));
+  put_byte (buffer, event_type);
+
+  return offset;
+}
+
+static void
+end_event (mutest_event_buffer_t *buffer,
+           size_t offset)
+{
+  if (buffer->truncated)
+    return;
+
+  uint32_t len = (uint32_t) (buffer->len - offset - sizeof (uint32_t));
+
+  memcpy (buffer->data + offset, &len, sizeof (uint32_t));
+}
+
+static void
+put_expect (mutest_event_buffer_t *buffer,
+            const mutest_expect_t *expect)
+{
+  put_string (buffer, expect->file);
+  put_int (buffer, expect->line);
+  put_string (buffer, expect->func_name);
+  put_string (buffer, expect->description);
+  put_string (buffer, expect->skip_reason);
+  put_byte (buffer, expect->result);
+  put_res (buffer, expect->value);
+  put_string (buffer, expect->diagnostic);
+}
+
+void
+mutest_event_record_expect_result (mutest_event_buffer_t *buffer,
+                                   const mutest_expect_t *expect)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_EXPECT_RESULT);
+
+  put_expect (buffer, expect);
+
+  end_event (buffer, offset);
+}
+
+void
+mutest_event_record_expect_fail (mutest_event_buffer_t *buffer,
+                                 const mutest_expect_t *expect,
+                                 bool negate,
+                                 const mutest_expect_res_t *check,
+                                 const char *check_repr)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_EXPECT_FAIL);
+
+  put_expect (buffer, expect);
+  put_byte (buffer, negate ? 1 : 0);
+  put_res (buffer, check);
+  put_string (buffer, check_repr);
+
+  end_event (buffer, offset);
+}
+
+static void
+put_spec (mutest_event_buffer_t *buffer,
+          const mutest_spec_t *spec)
+{
+  put_string (buffer, spec->description);
+  put_string (buffer, spec->file);
+  put_int (buffer, spec->line);
+  put_string (buffer, spec->func_name);
+}
+
+void
+mutest_event_record_spec_preamble (mutest_event_buffer_t *buffer,
+                                   const mutest_spec_t *spec)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_SPEC_PREAMBLE);
+
+  put_spec (buffer, spec);
+
+  end_event (buffer, offset);
+}
+
+void
+mutest_event_record_spec_results (mutest_event_buffer_t *buffer,
+                                  const mutest_spec_t *spec)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_SPEC_RESULTS);
+
+  put_spec (buffer, spec);
+  put_int (buffer, spec->n_expects);
+  put_int (buffer, spec->pass);
+  put_int (buffer, spec->fail);
+  put_int (buffer, spec->skip);
+  put_int64 (buffer, spec->start_time);
+  put_int64 (buffer, spec->end_time);
+  put_byte (buffer, spec->skip_all ? 1 : 0);
+  put_string (buffer, spec->skip_reason);
+  put_int64 (buffer, spec->bench.iterations);
+  put_int (buffer, spec->bench.n_samples);
+  put_double (buffer, spec->bench.median);
+  put_double (buffer, spec->bench.mad);
+  put_double (buffer, spec->bench.ci_low);
+  put_double (buffer, spec->bench.ci_high);
+  put_byte (buffer, spec->perf.enabled ? 1 : 0);
+  put_int (buffer, spec->perf.error);
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    put_int64 (buffer, spec->perf.values[i]);
+  put_alloc_stats (buffer, &spec->alloc);
+
+  end_event (buffer, offset);
+}
+
+static void
+put_suite (mutest_event_buffer_t *buffer,
+           const mutest_suite_t *suite)
+{
+  put_string (buffer, suite->description);
+  put_string (buffer, suite->file);
+  put_int (buffer, suite->line);
+  put_string (buffer, suite->func_name);
+  put_int64 (buffer, suite->start_time);
+  put_int64 (buffer, suite->end_time);
+  put_int (buffer, suite->n_specs);
+  put_int (buffer, suite->pass);
+  put_int (buffer, suite->fail);
+  put_int (buffer, suite->skip);
+  put_byte (buffer, suite->skip_all ? 1 : 0);
+  put_string (buffer, suite->skip_reason);
+}
+
+void
+mutest_event_record_suite_preamble (mutest_event_buffer_t *buffer,
+                                    const mutest_suite_t *suite)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_SUITE_PREAMBLE);
+
+  put_suite (buffer, suite);
+
+  end_event (buffer, offset);
+}
+
+void
+mutest_event_record_suite_results (mutest_event_buffer_t *buffer,
+                                   const mutest_suite_t *suite)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_SUITE_RESULTS);
+
+  put_suite (buffer, suite);
+
+  end_event (buffer, offset);
+}
+
+// mutest_event_record_spec_abort:
+// @buffer: the buffer to record into
+// @file: the file name
+// @line: the line number
+// @func_name: the function name
+// @message: the message
+//
+// Records an abnormal termination of the current spec, typically
+// from mutest_assert_message().
+//
+// The strings are truncated, so that the record can be stored in a
+// static buffer of MUTEST_EVENT_ABORT_SIZE bytes.
+void
+mutest_event_record_spec_abort (mutest_event_buffer_t *buffer,
+                                const char *file,
+                                int line,
+                                const char *func_name,
+                                const char *message)
+{
+  size_t offset = begin_event (buffer, MUTEST_EVENT_SPEC_ABORT);
+
+  put_string_n (buffer, file, MAX_ABORT_STRING_LEN);
+  put_int (buffer, line);
+  put_string_n (buffer, func_name, MAX_ABORT_STRING_LEN);
+  put_string_n (buffer, message, MAX_ABORT_STRING_LEN);
+
+  end_event (buffer, offset);
+}
+
+typedef struct {
+  const char *data;
+  size_t len;
+  size_t pos;
+  bool error;
+} event_reader_t;
+
+static bool
+get_data (event_reader_t *reader,
+          void *data,
+          size_t len)
+{
+  if (reader->error || reader->len - reader->pos < len)
+    {
+      reader->error = true;
+      memset (data, 0, len);
+      return false;
+    }
+
+  memcpy (data, reader->data + reader->pos, len);
+  reader->pos += len;
+
+  return true;
+}
+
+static uint8_t
+get_byte (event_reader_t *reader)
+{
+  uint8_t res = 0;
+
+  get_data (reader, &res, sizeof (uint8_t));
+
+  return res;
+}
+
+static int
+get_int (event_reader_t *reader)
+{
+  int32_t res = 0;
+
+  get_data (reader, &res, sizeof (int32_t));
+
+  return res;
+}
+
+static int64_t
+get_int64 (event_reader_t *reader)
+{
+  int64_t res = 0;
+
+  get_data (reader, &res, sizeof (int64_t));
+
+  return res;
+}
+
+static double
+get_double (event_reader_t *reader)
+{
+  double res = 0;
+
+  get_data (reader, &res, sizeof (double));
+
+  return res;
+}
+
+// The returned string points into the reader's data
+static const char *
+get_string (event_reader_t *reader)
+{
+  uint32_t len = 0;
+
+  if (!get_data (reader, &len, sizeof (uint32_t)))
+    return NULL;
+
+  if (len == NULL_STRING_LEN)
+    return NULL;
+
+  if (len == 0 || reader->len - reader->pos < len ||
+      reader->data[reader->pos + len - 1] != '\0')
+    {
+      reader->error = true;
+      return NULL;
+    }
+
+  const char *res = reader->data + reader->pos;
+  reader->pos += len;
+
+  return res;
+}
+
+// The returned data points into the reader's data
+static const void *
+get_bytes (event_reader_t *reader,
+           size_t *len_p)
+{
+  uint32_t len = 0;
+
+  *len_p = 0;
+
+  if (!get_data (reader, &len, sizeof (uint32_t)))
+    return NULL;
+
+  if (reader->len - reader->pos < len)
+    {
+      reader->error = true;
+      return NULL;
+    }
+
+  const char *res = reader->data + reader->pos;
+  reader->pos += len;
+
+  *len_p = len;
+
+  return res;
+}
+
+static void
+get_alloc_stats (event_reader_t *reader,
+                 mutest_alloc_stats_t *stats)
+{
+  stats->available = get_byte (reader) != 0;
+  stats->n_allocs = get_int64 (reader);
+  stats->n_frees = get_int64 (reader);
+  stats->n_bytes = get_int64 (reader);
+}
+
+static bool
+get_res (event_reader_t *reader,
+         mutest_expect_res_t *res)
+{
+  memset (res, 0, sizeof (mutest_expect_res_t));
+
+  res->expect_type = get_byte (reader);
+
+  switch (res->expect_type)
+    {
+    case MUTEST_EXPECT_INVALID:
+      return false;
+
+    case MUTEST_EXPECT_BOOLEAN:
+      res->expect.v_bool = get_byte (reader) != 0;
+      break;
+
+    case MUTEST_EXPECT_INT:
+      res->expect.v_int.value = get_int (reader);
+      res->expect.v_int.tolerance = get_int (reader);
+      break;
+
+    case MUTEST_EXPECT_INT_RANGE:
+      res->expect.v_irange.min = get_int (reader);
+      res->expect.v_irange.max = get_int (reader);
+      break;
+
+    case MUTEST_EXPECT_FLOAT:
+      res->expect.v_float.value = get_double (reader);
+      res->expect.v_float.tolerance = get_double (reader);
+      break;
+
+    case MUTEST_EXPECT_FLOAT_RANGE:
+      res->expect.v_frange.min = get_double (reader);
+      res->expect.v_frange.max = get_double (reader);
+      break;
+
+    case MUTEST_EXPECT_STR:
+      res->expect.v_str.str = (char *) get_string (reader);
+      res->expect.v_str.len = res->expect.v_str.str != NULL
+                            ? strlen (res->expect.v_str.str)
+                            : 0;
+      break;
+
+    case MUTEST_EXPECT_POINTER:
+      res->expect.v_pointer = (void *) (intptr_t) get_int64 (reader);
+      break;
+
+    case MUTEST_EXPECT_CLOSURE:
+      res->expect.v_closure.called = get_byte (reader) != 0;
+      get_alloc_stats (reader, &res->expect.v_closure.alloc);
+      break;
+
+    case MUTEST_EXPECT_BYTE_ARRAY:
+      res->expect.v_bytearray.element_size = (size_t) get_int64 (reader);
+      res->expect.v_bytearray.length = (size_t) get_int64 (reader);
+      res->expect.v_bytearray.has_mismatch = get_byte (reader) != 0;
+      res->expect.v_bytearray.mismatch = (size_t) get_int64 (reader);
+      res->expect.v_bytearray.data_offset = (size_t) get_int64 (reader);
+      res->expect.v_bytearray.data = (uint8_t *) get_bytes (reader, &res->expect.v_bytearray.data_size);
+      break;
+
+    case MUTEST_EXPECT_ARRAY:
+      {
+        uint8_t array_type = get_byte (reader);
+
+        if (array_type > MUTEST_ARRAY_DOUBLE)
+          {
+            reader->error = true;
+            return false;
+          }
+
+        res->expect.v_array.array_type = array_type;
+        res->expect.v_array.data = NULL;
+        res->expect.v_array.length = (size_t) get_int64 (reader);
+        res->expect.v_array.abs_tolerance = get_double (reader);
+        res->expect.v_array.rel_tolerance = get_double (reader);
+        res->expect.v_array.max_ulps = get_int (reader);
+        res->expect.v_array.checked = get_byte (reader) != 0;
+        res->expect.v_array.n_mismatches = (size_t) get_int64 (reader);
+
+        size_t reported_size;
+
+        res->expect.v_array.reported = (uint8_t *) get_bytes (reader, &reported_size);
+        res->expect.v_array.n_reported = reported_size / sizeof (mutest_array_mismatch_t);
+      }
+      break;
+
+    default:
+      reader->error = true;
+      return false;
+    }
+
+  return true;
+}
+
+static void
+get_expect (event_reader_t *reader,
+            mutest_expect_t *expect,
+            mutest_expect_res_t *value)
+{
+  expect->file = get_string (reader);
+  expect->line = get_int (reader);
+  expect->func_name = get_string (reader);
+  expect->description = get_string (reader);
+  expect->skip_reason = get_string (reader);
+  expect->result = get_byte (reader);
+  expect->value = get_res (reader, value) ? value : NULL;
+  expect->diagnostic = get_string (reader);
+}
+
+static void
+get_spec (event_reader_t *reader,
+          mutest_spec_t *spec)
+{
+  spec->description = get_string (reader);
+  spec->file = get_string (reader);
+  spec->line = get_int (reader);
+  spec->func_name = get_string (reader);
+}
+
+static void
+get_spec_results (event_reader_t *reader,
+                  mutest_spec_t *spec)
+{
+  spec->n_expects = get_int (reader);
+  spec->pass = get_int (reader);
+  spec->fail = get_int (reader);
+  spec->skip = get_int (reader);
+  spec->start_time = get_int64 (reader);
+  spec->end_time = get_int64 (reader);
+  spec->skip_all = get_byte (reader) != 0;
+  spec->skip_reason = get_string (reader);
+
+  spec->bench.iterations = get_int64 (reader);
+  spec->bench.n_samples = get_int (reader);
+  spec->bench.median = get_double (reader);
+  spec->bench.mad = get_double (reader);
+  spec->bench.ci_low = get_double (reader);
+  spec->bench.ci_high = get_double (reader);
+
+  spec->perf.enabled = get_byte (reader) != 0;
+  spec->perf.error = get_int (reader);
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    spec->perf.values[i] = get_int64 (reader);
+
+  get_alloc_stats (reader, &spec->alloc);
+}
+
+static void
+get_suite (event_reader_t *reader,
+           mutest_suite_t *suite)
+{
+  suite->description = get_string (reader);
+  suite->file = get_string (reader);
+  suite->line = get_int (reader);
+  suite->func_name = get_string (reader);
+  suite->start_time = get_int64 (reader);
+  suite->end_time = get_int64 (reader);
+  suite->n_specs = get_int (reader);
+  suite->pass = get_int (reader);
+  suite->fail = get_int (reader);
+  suite->skip = get_int (reader);
+  suite->skip_all = get_byte (reader) != 0;
+  suite->skip_reason = get_string (reader);
+}
+
+// mutest_event_has_failures:
+// @data: the recorded events
+// @len: the length of @data
+//
+// Checks whether the events recorded for a spec contain a failure,
+// without replaying them; events without the results of the spec,
+// for instance because the spec crashed, count as a failure.
+//
+// Returns: true if the spec failed
+bool
+mutest_event_has_failures (const char *data,
+                           size_t len)
+{
+  size_t pos = 0;
+
+  while (len - pos > sizeof (uint32_t))
+    {
+      uint32_t event_len;
+
+      memcpy (&event_len, data + pos, sizeof (uint32_t));
+      pos += sizeof (uint32_t);
+
+      if (event_len == 0 || len - pos < event_len)
+        break;
+
+      event_reader_t reader = {
+        .data = data + pos,
+        .len = event_len,
+        .pos = 0,
+        .error = false,
+      };
+
+      pos += event_len;
+
+      if (get_byte (&reader) != MUTEST_EVENT_SPEC_RESULTS)
+        continue;
+
+      mutest_spec_t results;
+
+      get_spec (&reader, &results);
+      get_spec_results (&reader, &results);
+
+      return reader.error || results.fail > 0;
+    }
+
+  return true;
+}
+
+// mutest_event_replay:
+// @data: the recorded events
+// @len: the size of @data, in bytes
+// @spec: the spec that generated the events
+// @info: (nullable): return location for the replay information
+//
+// Replays the events recorded while running @spec through the
+// current formatter, and updates the results of @spec.
+//
+// The string fields of @spec and @info may point into @data after
+// this function returns.
+void
+mutest_event_replay (const char *data,
+                     size_t len,
+                     mutest_spec_t *spec,
+                     mutest_replay_info_t *info)
+{
+  mutest_replay_info_t dummy;
+  size_t pos = 0;
+
+  if (info == NULL)
+    info = &dummy;
+
+  memset (info, 0, sizeof (mutest_replay_info_t));
+
+  while (len - pos > sizeof (uint32_t))
+    {
+      uint32_t event_len;
+
+      memcpy (&event_len, data + pos, sizeof (uint32_t));
+      pos += sizeof (uint32_t);
+
+      // Truncated record
+      if (event_len == 0 || len - pos < event_len)
+        break;
+
+      event_reader_t reader = {
+        .data = data + pos,
+        .len = event_len,
+        .pos = 0,
+        .error = false,
+      };
+
+      pos += event_len;
+
+      mutest_event_type_t event_type = get_byte (&reader);
+
+      mutest_expect_t expect = { NULL, };
+      mutest_expect_res_t value, check;
+
+      switch (event_type)
+        {
+        case MUTEST_EVENT_EXPECT_RESULT:
+          get_expect (&reader, &expect, &value);
+          if (!reader.error)
+            {
+              mutest_format_expect_result (&expect);
+
+              switch (expect.result)
+                {
+                case MUTEST_RESULT_PASS:
+                  info->pass += 1;
+                  break;
+                case MUTEST_RESULT_FAIL:
+                  info->fail += 1;
+                  break;
+                case MUTEST_RESULT_SKIP:
+                  info->skip += 1;
+                  break;
+                }
+
+              info->file = expect.file;
+              info->line = expect.line;
+              info->func_name = expect.func_name;
+            }
+          break;
+
+        case MUTEST_EVENT_EXPECT_FAIL:
+          {
+            get_expect (&reader, &expect, &value);
+
+            bool negate = get_byte (&reader) != 0;
+            bool has_check = get_res (&reader, &check);
+            const char *check_repr = get_string (&reader);
+
+            if (!reader.error && (expect.value != NULL || expect.diagnostic != NULL))
+              mutest_format_expect_fail (&expect, negate,
+                                         has_check ? &check : NULL,
+                                         check_repr);
+          }
+          break;
+
+        case MUTEST_EVENT_SPEC_RESULTS:
+          {
+            // The description and location of the spec are
+            // already known to the runner
+            mutest_spec_t results;
+
+            get_spec (&reader, &results);
+            get_spec_results (&reader, &results);
+
+            if (!reader.error)
+              {
+                spec->n_expects = results.n_expects;
+                spec->pass = results.pass;
+                spec->fail = results.fail;
+                spec->skip = results.skip;
+                spec->start_time = results.start_time;
+                spec->end_time = results.end_time;
+                spec->skip_all = results.skip_all;
+                spec->skip_reason = results.skip_reason;
+                spec->bench = results.bench;
+                spec->perf = results.perf;
+                spec->alloc = results.alloc;
+                info->has_results = true;
+              }
+          }
+          break;
+
+        case MUTEST_EVENT_SPEC_ABORT:
+          {
+            const char *file = get_string (&reader);
+            int line = get_int (&reader);
+            const char *func_name = get_string (&reader);
+            const char *message = get_string (&reader);
+
+            if (!reader.error)
+              {
+                info->aborted = true;
+                info->file = file;
+                info->line = line;
+                info->func_name = func_name;
+                info->message = message;
+              }
+          }
+          break;
+
+        // Only recorded for the output thread
+        case MUTEST_EVENT_SPEC_PREAMBLE:
+        case MUTEST_EVENT_SUITE_PREAMBLE:
+        case MUTEST_EVENT_SUITE_RESULTS:
+          break;
+        }
+    }
+}
+
+// mutest_event_format:
+// @data: the recorded events
+// @len: the size of @data, in bytes
+//
+// Formats the recorded events through the current formatter, using
+// the specs and suites stored in the events, instead of the ones of
+// the runner.
+void
+mutest_event_format (const char *data,
+                     size_t len)
+{
+  size_t pos = 0;
+
+  while (len - pos > sizeof (uint32_t))
+    {
+      uint32_t event_len;
+
+      memcpy (&event_len, data + pos, sizeof (uint32_t));
+      pos += sizeof (uint32_t);
+
+      if (event_len == 0 || len - pos < event_len)
+        break;
+
+      event_reader_t reader = {
+        .data = data + pos,
+        .len = event_len,
+        .pos = 0,
+        .error = false,
+      };
+
+      pos += event_len;
+
+      mutest_event_type_t event_type = get_byte (&reader);
+
+      mutest_expect_t expect = { NULL, };
+      mutest_expect_res_t value, check;
+      mutest_spec_t spec = { NULL, };
+      mutest_suite_t suite = { NULL, };
+
+      switch (event_type)
+        {
+        case MUTEST_EVENT_EXPECT_RESULT:
+          get_expect (&reader, &expect, &value);
+          if (!reader.error)
+            mutest_format_expect_result (&expect);
+          break;
+
+        case MUTEST_EVENT_EXPECT_FAIL:
+          {
+            get_expect (&reader, &expect, &value);
+
+            bool negate = get_byte (&reader) != 0;
+            bool has_check = get_res (&reader, &check);
+            const char *check_repr = get_string (&reader);
+
+            if (!reader.error && (expect.value != NULL || expect.diagnostic != NULL))
+              mutest_format_expect_fail (&expect, negate,
+                                         has_check ? &check : NULL,
+                                         check_repr);
+          }
+          break;
+
+        case MUTEST_EVENT_SPEC_PREAMBLE:
+          get_spec (&reader, &spec);
+          if (!reader.error)
+            mutest_format_spec_preamble (&spec);
+          break;
+
+        case MUTEST_EVENT_SPEC_RESULTS:
+          get_spec (&reader, &spec);
+          get_spec_results (&reader, &spec);
+          if (!reader.error)
+            mutest_format_spec_results (&spec);
+          break;
+
+        case MUTEST_EVENT_SUITE_PREAMBLE:
+          get_suite (&reader, &suite);
+          if (!reader.error)
+            mutest_format_suite_preamble (&suite);
+          break;
+
+        case MUTEST_EVENT_SUITE_RESULTS:
+          get_suite (&reader, &suite);
+          if (!reader.error)
+            mutest_format_suite_results (&suite);
+          break;
+
+        // Handled by the runner
+        case MUTEST_EVENT_SPEC_ABORT:
+          break;
+        }
+    }
+}
@@ -76,6 +76,19 @@ mutest_collect_infinity (mutest_expect_type_t value_type MUTEST_UNUSED,
   return retval;
 }
 
+static mutest_expect_res_t *
+mutest_collect_zero (mutest_expect_type_t value_type MUTEST_UNUSED,
+                     mutest_collect_type_t collect_type MUTEST_UNUSED,
+                     va_list *args MUTEST_UNUSED)
+{
+  mutest_expect_res_t *retval = mutest_expect_res_alloc (MUTEST_EXPECT_INT);
+
+  retval->expect.v_int.value = 0;
+  retval->expect.v_int.tolerance = 0;
+
+  return retval;
+}
+
 static mutest_expect_res_t *
 mutest_collect_boolean (mutest_expect_type_t value_type MUTEST_UNUSED,
                         mutest_collect_type_t collect_type MUTEST_UNUSED,
@@ -170,6 +183,9 @@ mutest_collect_number (mutest_expect_type_t value_type,
     case MUTEST_EXPECT_BOOLEAN:
     case MUTEST_EXPECT_STR:
     case MUTEST_EXPECT_POINTER:
+    case MUTEST_EXPECT_CLOSURE:
+    case MUTEST_EXPECT_BYTE_ARRAY:
+    case MUTEST_EXPECT_ARRAY:
       mutest_assert_if_reached ("invalid number");
       break;
     }
@@ -184,8 +200,7 @@ mutest_collect_string (mutest_expect_type_t value_type MUTEST_UNUSED,
 {
   mutest_expect_res_t *retval = mutest_expect_res_alloc (MUTEST_EXPECT_STR);
 
-  char *str = va_arg (*args, char *);
-  retval->expect.v_str.str = mutest_strdup_and_len (str, &(retval->expect.v_str.len));
+  mutest_expect_res_set_string (retval, va_arg (*args, char *));
 
   return retval;
 }
@@ -244,15 +259,82 @@ mutest_collect_scalar (mutest_expect_type_t value_type,
   if (value_type == MUTEST_EXPECT_POINTER && collect_pointer)
     return mutest_collect_pointer (value_type, collect_type, args);
 
+  /* Arrays need a size, so they are passed using an explicit
+   * value wrapper
+   */
+  if (value_type == MUTEST_EXPECT_BYTE_ARRAY || value_type == MUTEST_EXPECT_ARRAY)
+    return va_arg (*args, mutest_expect_res_t *);
+
   return NULL;
 }
 
+// The values collected by the array matchers depend on the type of
+// the elements of the array, so they are collected like the values of
+// the matchers added by mutest_register_matcher()
+static mutest_expect_res_t *
+mutest_collect_array (const mutest_expect_res_t *value MUTEST_UNUSED,
+                      va_list *args)
+{
+  return va_arg (*args, mutest_expect_res_t *);
+}
+
+static mutest_expect_res_t *
+mutest_collect_close_array (const mutest_expect_res_t *value MUTEST_UNUSED,
+                            va_list *args)
+{
+  mutest_expect_res_t *retval = va_arg (*args, mutest_expect_res_t *);
+
+  if (retval == NULL || retval->expect_type != MUTEST_EXPECT_ARRAY)
+    mutest_assert_if_reached ("invalid array");
+
+  retval->expect.v_array.abs_tolerance = va_arg (*args, double);
+  retval->expect.v_array.rel_tolerance = va_arg (*args, double);
+  retval->expect.v_array.max_ulps = va_arg (*args, int);
+
+  if (retval->expect.v_array.abs_tolerance < 0 ||
+      retval->expect.v_array.rel_tolerance < 0 ||
+      retval->expect.v_array.max_ulps < 0)
+    mutest_assert_if_reached ("invalid tolerance");
+
+  return retval;
+}
+
+static mutest_expect_res_t *
+mutest_collect_array_range (const mutest_expect_res_t *value,
+                            va_list *args)
+{
+  if (value->expect_type != MUTEST_EXPECT_ARRAY)
+    mutest_assert_if_reached ("invalid array");
+
+  // The range has the type of the elements
+  bool is_integer = value->expect.v_array.array_type == MUTEST_ARRAY_INT32 ||
+                    value->expect.v_array.array_type == MUTEST_ARRAY_INT64;
+
+  return mutest_collect_number (is_integer ? MUTEST_EXPECT_INT : MUTEST_EXPECT_FLOAT,
+                                MUTEST_COLLECT_NUMBER | MUTEST_COLLECT_MATCHING_TYPE | MUTEST_COLLECT_RANGE,
+                                args);
+}
+
+// Describes how to collect the expected value of a matcher
+typedef struct {
+  mutest_matcher_func_t matcher;
+
+  // Built-in matchers
+  mutest_collect_type_t collect_rule;
+  mutest_collect_func_t collector;
+
+  const char *repr;
+
+  // Matchers added by mutest_register_matcher()
+  mutest_matcher_collect_func_t custom_collector;
+} matcher_desc_t;
+
 static const struct {
   mutest_matcher_func_t matcher;
   mutest_collect_type_t collect_rule;
   mutest_collect_func_t collector;
   const char *repr;
-} matchers[] = {
+} builtin_matchers[] = {
   /* Unary matchers */
   { mutest_to_be_true, MUTEST_COLLECT_NONE, mutest_collect_true, "true" },
   { mutest_to_be_false, MUTEST_COLLECT_NONE, mutest_collect_false, "false" },
@@ -260,6 +342,8 @@ static const struct {
   { mutest_to_be_nan, MUTEST_COLLECT_NONE, mutest_collect_nan, "NaN" },
   { mutest_to_be_positive_infinity, MUTEST_COLLECT_NONE, mutest_collect_infinity, "+∞" },
   { mutest_to_be_negative_infinity, MUTEST_COLLECT_NONE, mutest_collect_infinity, "-∞" },
+  { mutest_to_not_allocate, MUTEST_COLLECT_NONE, mutest_collect_zero, NULL },
+  { mutest_to_be_sorted, MUTEST_COLLECT_NONE, mutest_collect_true, "sorted" },
 
   /* Numeric matchers */
   { mutest_to_be_close_to,
@@ -310,6 +394,13 @@ static const struct {
     NULL,
   },
 
+  /* Closure matchers */
+  { mutest_to_allocate_at_most,
+    MUTEST_COLLECT_INT,
+    mutest_collect_number,
+    NULL,
+  },
+
   /* Generic scalar matcher */
   { mutest_to_be,
     MUTEST_COLLECT_SCALAR | MUTEST_COLLECT_MATCHING_TYPE,
@@ -323,7 +414,163 @@ static const struct {
   },
 };
 
-static const size_t n_matchers = sizeof (matchers) / sizeof (matchers[0]);
+static const size_t n_builtin_matchers = sizeof (builtin_matchers) / sizeof (builtin_matchers[0]);
+
+static const struct {
+  mutest_matcher_func_t matcher;
+  mutest_matcher_collect_func_t collector;
+} array_matchers[] = {
+  { mutest_to_have_equal_elements, mutest_collect_array },
+  { mutest_to_have_close_elements, mutest_collect_close_array },
+  { mutest_to_have_elements_in_range, mutest_collect_array_range },
+};
+
+static const size_t n_array_matchers = sizeof (array_matchers) / sizeof (array_matchers[0]);
+
+// The descriptors are stored in an open addressing hash table, keyed
+// by the matcher function, so that finding the descriptor of a matcher
+// does not depend on the number of matchers
+static struct {
+  matcher_desc_t *slots;
+
+  // A power of two, at least twice the number of entries
+  size_t size;
+  size_t n_entries;
+} matcher_table;
+
+static inline size_t
+matcher_hash (mutest_matcher_func_t matcher)
+{
+  uint64_t key = (uint64_t) (uintptr_t) matcher;
+
+  // Functions are aligned, so we need to mix the low bits
+  key ^= key >> 33;
+  key *= UINT64_C (0xff51afd7ed558ccd);
+  key ^= key >> 33;
+
+  return (size_t) key;
+}
+
+static matcher_desc_t *
+matcher_table_find_slot (matcher_desc_t *slots,
+                         size_t size,
+                         mutest_matcher_func_t matcher)
+{
+  size_t mask = size - 1;
+  size_t i = matcher_hash (matcher) & mask;
+
+  while (slots[i].matcher != NULL && slots[i].matcher != matcher)
+    i = (i + 1) & mask;
+
+  return &slots[i];
+}
+
+static void
+matcher_table_resize (size_t size)
+{
+  matcher_desc_t *slots = calloc (size, sizeof (matcher_desc_t));
+  if (slots == NULL)
+    mutest_oom_abort ();
+
+  for (size_t i = 0; i < matcher_table.size; i++)
+    {
+      const matcher_desc_t *desc = &matcher_table.slots[i];
+
+      if (desc->matcher != NULL)
+        *matcher_table_find_slot (slots, size, desc->matcher) = *desc;
+    }
+
+  free (matcher_table.slots);
+
+  matcher_table.slots = slots;
+  matcher_table.size = size;
+}
+
+static void
+matcher_table_insert (const matcher_desc_t *desc)
+{
+  if ((matcher_table.n_entries + 1) * 2 > matcher_table.size)
+    matcher_table_resize (matcher_table.size > 0 ? matcher_table.size * 2 : 64);
+
+  matcher_desc_t *slot = matcher_table_find_slot (matcher_table.slots,
+                                                  matcher_table.size,
+                                                  desc->matcher);
+  if (slot->matcher == NULL)
+    matcher_table.n_entries += 1;
+
+  *slot = *desc;
+}
+
+// mutest_matchers_init:
+//
+// Adds the built-in matchers to the table of matchers; this is called
+// by mutest_init(), before running any spec, as the table is shared
+// between threads.
+void
+mutest_matchers_init (void)
+{
+  if (mutest_likely (matcher_table.size != 0))
+    return;
+
+  for (size_t i = 0; i < n_builtin_matchers; i++)
+    {
+      matcher_desc_t desc = {
+        .matcher = builtin_matchers[i].matcher,
+        .collect_rule = builtin_matchers[i].collect_rule,
+        .collector = builtin_matchers[i].collector,
+        .repr = builtin_matchers[i].repr,
+        .custom_collector = NULL,
+      };
+
+      matcher_table_insert (&desc);
+    }
+
+  for (size_t i = 0; i < n_array_matchers; i++)
+    {
+      matcher_desc_t desc = {
+        .matcher = array_matchers[i].matcher,
+        .collect_rule = MUTEST_COLLECT_NONE,
+        .collector = NULL,
+        .repr = NULL,
+        .custom_collector = array_matchers[i].collector,
+      };
+
+      matcher_table_insert (&desc);
+    }
+}
+
+static const matcher_desc_t *
+matcher_table_lookup (mutest_matcher_func_t matcher)
+{
+  mutest_matchers_init ();
+
+  const matcher_desc_t *desc = matcher_table_find_slot (matcher_table.slots,
+                                                        matcher_table.size,
+                                                        matcher);
+
+  return desc->matcher != NULL ? desc : NULL;
+}
+
+void
+mutest_register_matcher (mutest_matcher_func_t matcher,
+                         mutest_matcher_collect_func_t collect,
+                         const char *repr)
+{
+  if (matcher == NULL || matcher == mutest_not || matcher == mutest_skip)
+    mutest_assert_if_reached ("invalid matcher");
+
+  mutest_matchers_init ();
+
+  matcher_desc_t desc = {
+    .matcher = matcher,
+    .collect_rule = MUTEST_COLLECT_NONE,
+    .collector = NULL,
+    .repr = mutest_strdup (repr),
+    .custom_collector = collect,
+  };
+
+  matcher_table_insert (&desc);
+}
 
 void
 mutest_expect_full (const char *file,
@@ -343,6 +590,18 @@ mutest_expect_full (const char *file,
   if (first_matcher_func == NULL)
     mutest_assert_if_reached ("invalid matcher");
 
+  mutest_spec_t *current = mutest_get_current_spec ();
+  if (current == NULL)
+    mutest_assert_if_reached ("No current spec defined. mutest_expect() may "
+                              "only be called from within a spec, "
+                              "not from within hooks.");
+
+  // Benchmarks already reported their expectations on the first call
+  bool report = !current->bench_running;
+
+  // Our own allocations do not count towards the ones of the spec
+  mutest_alloc_suspend ();
+
   mutest_expect_t e = {
     .description = description,
     .value = value,
@@ -377,31 +636,47 @@ mutest_expect_full (const char *file,
           matcher_func = va_arg (args, void *);
         }
 
-      for (size_t i = 0; i < n_matchers; i++)
+      const matcher_desc_t *desc = matcher_table_lookup (matcher_func);
+
+      if (desc == NULL)
         {
-          if (matchers[i].matcher == matcher_func)
-            {
-              repr = matchers[i].repr;
-              check = matchers[i].collector (value->expect_type,
-                                             matchers[i].collect_rule,
-                                             &args);
-              break;
-            }
+          /* If we're using a custom matcher that was not registered
+           * then we collect the value as a pointer instead of unpacking
+           * raw arguments. The ownership of the comparison value
+           * is transferred to us in any case.
+           */
+          check = va_arg (args, mutest_expect_res_t *);
         }
+      else if (desc->collector != NULL)
+        {
+          repr = desc->repr;
+          check = desc->collector (value->expect_type, desc->collect_rule, &args);
 
-      /* If we're using a custom matcher then we collect
-       * the value as a pointer instead of unpacking raw
-       * arguments. The ownership of the comparison value
-       * is transferred to us in any case.
-       */
-      if (check == NULL)
-        check = va_arg (args, mutest_expect_res_t *);
+          if (check == NULL)
+            check = va_arg (args, mutest_expect_res_t *);
+        }
+      else
+        {
+          // Registered matchers without a collector take no argument,
+          // but they can still describe what they expect
+          repr = desc->repr;
+
+          if (desc->custom_collector != NULL)
+            check = desc->custom_collector (value, &args);
+        }
 
       bool res = matcher_func (&e, check);
 
+      /* The matcher could not check the value */
+      if (e.result == MUTEST_RESULT_SKIP)
+        {
+          mutest_expect_res_free (check);
+          break;
+        }
+
       res = negate ? !res : res;
 
-      if (!res)
+      if (!res && report)
         mutest_format_expect_fail (&e, negate, check, repr);
 
       if (e.result == MUTEST_RESULT_PASS)
@@ -414,17 +689,16 @@ mutest_expect_full (const char *file,
 
   va_end (args);
 
-  mutest_spec_t *current = mutest_get_current_spec ();
-  if (current == NULL)
-    mutest_assert_if_reached ("No current spec defined. mutest_expect() may "
-                              "only be called from within a spec, "
-                              "not from within hooks.");
-
-  mutest_spec_add_expect_result (mutest_get_current_spec (), &e);
+  if (report)
+    {
+      mutest_spec_add_expect_result (current, &e);
 
-  mutest_format_expect_result (&e);
+      mutest_format_expect_result (&e);
+    }
 
   mutest_expect_res_free (value);
+
+  mutest_alloc_resume ();
 }
 
 mutest_expect_res_t *
@@ -450,11 +724,23 @@ mutest_expect_diagnostic (mutest_expect_t *expect,
             expect->file,
             expect->line);
 
-  char lhs[256], rhs[256], comparison[16];
+  // Results read back from a log only have the diagnostic
+  if (expect->diagnostic != NULL)
+    {
+      if (diagnostic_p != NULL)
+        *diagnostic_p = mutest_strdup (expect->diagnostic);
+
+      if (location_p != NULL)
+        *location_p = mutest_strdup (location);
+
+      return;
+    }
+
+  char lhs[512], rhs[512], comparison[16];
 
-  mutest_expect_res_to_string (expect->value, lhs, 256);
+  mutest_expect_res_to_string (expect->value, lhs, 512);
 
-  if (check != NULL)
+  if (check != NULL || check_repr != NULL)
     {
       switch (expect->value->expect_type)
         {
@@ -465,6 +751,7 @@ mutest_expect_diagnostic (mutest_expect_t *expect,
         case MUTEST_EXPECT_INT:
         case MUTEST_EXPECT_STR:
         case MUTEST_EXPECT_POINTER:
+        case MUTEST_EXPECT_BYTE_ARRAY:
           snprintf (comparison, 16, " %s ", negate ? "≢" : "≡");
           break;
         case MUTEST_EXPECT_FLOAT:
@@ -474,12 +761,29 @@ mutest_expect_diagnostic (mutest_expect_t *expect,
         case MUTEST_EXPECT_FLOAT_RANGE:
           snprintf (comparison, 16, " %s ", negate ? "∌" : "∋");
           break;
+        case MUTEST_EXPECT_CLOSURE:
+          snprintf (comparison, 16, " %s ", negate ? ">" : "≤");
+          break;
+        case MUTEST_EXPECT_ARRAY:
+          if (check != NULL &&
+              (check->expect_type == MUTEST_EXPECT_INT_RANGE ||
+               check->expect_type == MUTEST_EXPECT_FLOAT_RANGE))
+            snprintf (comparison, 16, " %s ", negate ? "⊄" : "⊂");
+          else if (check != NULL &&
+                   check->expect_type == MUTEST_EXPECT_ARRAY &&
+                   (check->expect.v_array.abs_tolerance > 0 ||
+                    check->expect.v_array.rel_tolerance > 0 ||
+                    check->expect.v_array.max_ulps > 0))
+            snprintf (comparison, 16, " %s ", negate ? "≉" : "≈");
+          else
+            snprintf (comparison, 16, " %s ", negate ? "≢" : "≡");
+          break;
         }
 
       if (check_repr != NULL)
-        snprintf (rhs, 256, "%s", check_repr);
+        snprintf (rhs, 512, "%s", check_repr);
       else
-        mutest_expect_res_to_string (check, rhs, 256);
+        mutest_expect_res_to_string (check, rhs, 512);
     }
   else
     {
@@ -506,3 +810,191 @@ mutest_expect_diagnostic (mutest_expect_t *expect,
       snprintf (*location_p, loc_len + 1, "%s", location);
     }
 }
+
+void
+mutest_expect_pass_full (const char *file,
+                         int line,
+                         const char *func_name,
+                         const char *description)
+{
+  if (description == NULL)
+    mutest_assert_if_reached ("invalid description");
+
+  mutest_spec_t *current = mutest_get_current_spec ();
+  if (current == NULL)
+    mutest_assert_if_reached ("No current spec defined. mutest_expect() may "
+                              "only be called from within a spec, "
+                              "not from within hooks.");
+
+  // Benchmarks already reported their expectations on the first call
+  if (current->bench_running)
+    return;
+
+  mutest_expect_t e = {
+    .description = description,
+    .file = file,
+    .line = line,
+    .func_name = func_name,
+    .result = MUTEST_RESULT_PASS,
+  };
+
+  mutest_alloc_suspend ();
+
+  mutest_spec_add_expect_result (current, &e);
+
+  mutest_format_expect_result (&e);
+
+  mutest_alloc_resume ();
+}
+
+// The typed expectations that failed are checked again using the
+// equivalent matchers, so that the failure is reported in the same
+// way, with the same diagnostic
+static mutest_matcher_func_t
+compare_matcher (mutest_compare_t compare)
+{
+  switch (compare)
+    {
+    case MUTEST_COMPARE_EQ:
+    case MUTEST_COMPARE_NE:
+      return mutest_to_be;
+
+    case MUTEST_COMPARE_LT:
+      return mutest_to_be_less_than;
+
+    case MUTEST_COMPARE_LE:
+      return mutest_to_be_less_than_or_equal;
+
+    case MUTEST_COMPARE_GT:
+      return mutest_to_be_greater_than;
+
+    case MUTEST_COMPARE_GE:
+      return mutest_to_be_greater_than_or_equal;
+
+    case MUTEST_COMPARE_IN_RANGE:
+      return mutest_to_be_in_range;
+    }
+
+  mutest_assert_if_reached ("invalid comparison");
+
+  return NULL;
+}
+
+void
+mutest_expect_int_fail_full (const char *file,
+                             int line,
+                             const char *func_name,
+                             const char *description,
+                             mutest_compare_t compare,
+                             int value,
+                             int expected,
+                             int expected_max)
+{
+  mutest_matcher_func_t matcher = compare_matcher (compare);
+
+  if (compare == MUTEST_COMPARE_NE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_int_value (value),
+                        mutest_not, matcher, expected,
+                        NULL);
+  else if (compare == MUTEST_COMPARE_IN_RANGE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_int_value (value),
+                        matcher, expected, expected_max,
+                        NULL);
+  else
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_int_value (value),
+                        matcher, expected,
+                        NULL);
+}
+
+void
+mutest_expect_float_fail_full (const char *file,
+                               int line,
+                               const char *func_name,
+                               const char *description,
+                               mutest_compare_t compare,
+                               double value,
+                               double expected,
+                               double expected_max)
+{
+  mutest_matcher_func_t matcher = compare_matcher (compare);
+
+  if (compare == MUTEST_COMPARE_NE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_float_value (value),
+                        mutest_not, matcher, expected,
+                        NULL);
+  else if (compare == MUTEST_COMPARE_IN_RANGE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_float_value (value),
+                        matcher, expected, expected_max,
+                        NULL);
+  else
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_float_value (value),
+                        matcher, expected,
+                        NULL);
+}
+
+void
+mutest_expect_bool_fail_full (const char *file,
+                              int line,
+                              const char *func_name,
+                              const char *description,
+                              bool value,
+                              bool expected)
+{
+  mutest_expect_full (file, line, func_name, description,
+                      mutest_bool_value (value),
+                      expected ? mutest_to_be_true : mutest_to_be_false,
+                      NULL);
+}
+
+void
+mutest_expect_pointer_fail_full (const char *file,
+                                 int line,
+                                 const char *func_name,
+                                 const char *description,
+                                 mutest_compare_t compare,
+                                 const void *value,
+                                 const void *expected)
+{
+  if (compare == MUTEST_COMPARE_NE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_pointer (value),
+                        mutest_not, mutest_to_be, expected,
+                        NULL);
+  else if (expected == NULL)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_pointer (value),
+                        mutest_to_be_null,
+                        NULL);
+  else
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_pointer (value),
+                        mutest_to_be, expected,
+                        NULL);
+}
+
+void
+mutest_expect_string_fail_full (const char *file,
+                                int line,
+                                const char *func_name,
+                                const char *description,
+                                mutest_compare_t compare,
+                                const char *value,
+                                const char *expected)
+{
+  if (compare == MUTEST_COMPARE_NE)
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_string_value (value),
+                        mutest_not, mutest_to_be, expected,
+                        NULL);
+  else
+    mutest_expect_full (file, line, func_name, description,
+                        mutest_string_value (value),
+                        mutest_to_be, expected,
+                        NULL);
+}
@@ -0,0 +1,330 @@
+/* mutest-filter.c: Spec filtering
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_REGEX_H
+#include <regex.h>
+#endif
+
+// Filters select the specs to run by matching their full name, which
+// is the description of the suite and the description of the spec,
+// separated by " › ".
+//
+// A filter enclosed in slashes, like "/^parser .* fails$/", is a POSIX
+// extended regular expression; any other filter is a glob, matching the
+// whole name, where '*' matches any string, '?' matches any character,
+// and '[...]' matches a set of characters.
+//
+// Globs are translated to regular expressions, so all filters are
+// compiled once, when they are added; a spec is run if it matches at
+// least one filter.
+#define FULL_NAME_SEPARATOR     " › "
+
+typedef struct {
+  char *pattern;
+
+#ifdef HAVE_REGEX_H
+  regex_t regex;
+#endif
+} filter_t;
+
+static struct {
+  filter_t *filters;
+  size_t n_filters;
+} filter_set;
+
+#ifdef HAVE_REGEX_H
+// Translates @glob into an anchored POSIX extended regular expression
+static char *
+glob_to_regex (const char *glob)
+{
+  // Every character expands to at most two, plus the anchors
+  size_t len = strlen (glob);
+  char *res = malloc (len * 2 + 3);
+  if (res == NULL)
+    mutest_oom_abort ();
+
+  char *p = res;
+  bool in_class = false;
+
+  *p++ = '^';
+
+  for (const char *g = glob; *g != '\0'; g++)
+    {
+      if (in_class)
+        {
+          if (*g == ']')
+            in_class = false;
+
+          *p++ = *g;
+          continue;
+        }
+
+      switch (*g)
+        {
+        case '*':
+          *p++ = '.';
+          *p++ = '*';
+          break;
+
+        case '?':
+          *p++ = '.';
+          break;
+
+        case '[':
+          // Only start a class if it's closed
+          if (strchr (g + 1, ']') != NULL)
+            {
+              in_class = true;
+              *p++ = '[';
+
+              if (g[1] == '!')
+                {
+                  *p++ = '^';
+                  g += 1;
+                }
+            }
+          else
+            {
+              *p++ = '\\';
+              *p++ = '[';
+            }
+          break;
+
+        case '.':
+        case '^':
+        case '$':
+        case '+':
+        case '(':
+        case ')':
+        case '{':
+        case '}':
+        case '|':
+        case '\\':
+        case ']':
+          *p++ = '\\';
+          *p++ = *g;
+          break;
+
+        default:
+          *p++ = *g;
+          break;
+        }
+    }
+
+  *p++ = '$';
+  *p = '\0';
+
+  return res;
+}
+#else
+// Matches @str against @glob, without regex.h
+static bool
+glob_match (const char *glob,
+            const char *str)
+{
+  const char *star_glob = NULL;
+  const char *star_str = NULL;
+
+  while (*str != '\0')
+    {
+      if (*glob == '*')
+        {
+          star_glob = ++glob;
+          star_str = str;
+          continue;
+        }
+
+      bool matched = false;
+
+      if (*glob == '?')
+        matched = true;
+      else if (*glob == '[' && strchr (glob + 1, ']') != NULL)
+        {
+          const char *g = glob + 1;
+          bool negate = *g == '!';
+          bool in_set = false;
+
+          if (negate)
+            g += 1;
+
+          for (; *g != ']'; g++)
+            {
+              if (g[1] == '-' && g[2] != ']' && g[2] != '\0')
+                {
+                  if (*str >= g[0] && *str <= g[2])
+                    in_set = true;
+                  g += 2;
+                }
+              else if (*g == *str)
+                in_set = true;
+            }
+
+          if (in_set != negate)
+            {
+              matched = true;
+              glob = g;
+            }
+        }
+      else
+        matched = *glob == *str;
+
+      if (matched)
+        {
+          glob += 1;
+          str += 1;
+        }
+      else if (star_glob != NULL)
+        {
+          glob = star_glob;
+          str = ++star_str;
+        }
+      else
+        return false;
+    }
+
+  while (*glob == '*')
+    glob += 1;
+
+  return *glob == '\0';
+}
+#endif
+
+static bool
+is_regex_pattern (const char *pattern,
+                  size_t len)
+{
+  return len >= 2 && pattern[0] == '/' && pattern[len - 1] == '/';
+}
+
+// mutest_filter_init:
+// @pattern: a glob, or a regular expression enclosed in slashes
+//
+// Adds a filter for the specs to run.
+void
+mutest_filter_init (const char *pattern)
+{
+  if (pattern == NULL || *pattern == '\0')
+    return;
+
+  filter_t filter = {
+    .pattern = mutest_strdup (pattern),
+  };
+
+  size_t len = strlen (pattern);
+
+#ifdef HAVE_REGEX_H
+  char *regex;
+
+  if (is_regex_pattern (pattern, len))
+    regex = mutest_strndup (pattern + 1, len - 2);
+  else
+    regex = glob_to_regex (pattern);
+
+  int res = regcomp (&filter.regex, regex != NULL ? regex : "", REG_EXTENDED | REG_NOSUB);
+
+  free (regex);
+
+  if (res != 0)
+    {
+      char error[256];
+
+      regerror (res, &filter.regex, error, sizeof (error));
+
+      fprintf (stderr, "ERROR: invalid filter '%s': %s\n", pattern, error);
+      exit (EXIT_FAILURE);
+    }
+#else
+  if (is_regex_pattern (pattern, len))
+    {
+      fprintf (stderr, "ERROR: invalid filter '%s': regular expressions "
+                       "are not supported on this platform\n",
+               pattern);
+      exit (EXIT_FAILURE);
+    }
+#endif
+
+  filter_t *filters = realloc (filter_set.filters, (filter_set.n_filters + 1) * sizeof (filter_t));
+  if (filters == NULL)
+    mutest_oom_abort ();
+
+  filter_set.filters = filters;
+  filter_set.filters[filter_set.n_filters] = filter;
+  filter_set.n_filters += 1;
+}
+
+typedef struct {
+  char *buf;
+  size_t size;
+} name_buffer_t;
+
+static bool
+matches_filters (mutest_suite_t *suite,
+                 mutest_spec_t *spec,
+                 void *data)
+{
+  name_buffer_t *name = data;
+
+  size_t suite_len = strlen (suite->description);
+  size_t sep_len = strlen (FULL_NAME_SEPARATOR);
+  size_t spec_len = strlen (spec->description);
+  size_t len = suite_len + sep_len + spec_len + 1;
+
+  if (len > name->size)
+    {
+      char *buf = realloc (name->buf, len);
+      if (buf == NULL)
+        mutest_oom_abort ();
+
+      name->buf = buf;
+      name->size = len;
+    }
+
+  memcpy (name->buf, suite->description, suite_len);
+  memcpy (name->buf + suite_len, FULL_NAME_SEPARATOR, sep_len);
+  memcpy (name->buf + suite_len + sep_len, spec->description, spec_len + 1);
+
+  for (size_t i = 0; i < filter_set.n_filters; i++)
+    {
+#ifdef HAVE_REGEX_H
+      if (regexec (&filter_set.filters[i].regex, name->buf, 0, NULL, 0) == 0)
+        return true;
+#else
+      if (glob_match (filter_set.filters[i].pattern, name->buf))
+        return true;
+#endif
+    }
+
+  return false;
+}
+
+// mutest_filter_suites:
+//
+// Removes all the specs that do not match any of the filters, and the
+// suites left without specs, so that none of their hooks are called,
+// and nothing is reported for them; the removed specs are counted
+// as filtered.
+void
+mutest_filter_suites (void)
+{
+  if (filter_set.n_filters == 0)
+    return;
+
+  mutest_state_t *state = mutest_get_global_state ();
+  name_buffer_t name = { NULL, 0 };
+
+  size_t n_filtered = mutest_prune_specs (matches_filters, &name, false);
+
+  state->total_filtered += (int) n_filtered;
+
+  free (name.buf);
+}
@@ -0,0 +1,865 @@
+/* mutest-format-binary.c: Binary results log
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef OS_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// The binary output is a compact log of the results, meant to be read
+// back by the mutest-results tool, which merges the logs of several
+// runs and renders them with any of the other output formats.
+//
+// The log starts with a header:
+//
+//   "MUTR"    magic
+//   uint8_t   version
+//
+// followed by length-prefixed records, so that a reader can skip the
+// records it does not know, and stop at a truncated trailing record:
+//
+//   varint    length of the payload, including the type
+//   uint8_t   record type
+//   ...       payload
+//
+// Integers are stored as LEB128 varints, with signed values zig-zag
+// encoded first; times are in nanoseconds, and floating point values
+// are stored as little-endian IEEE 754 doubles, so that logs can be
+// read on a different machine. Strings are interned: the first time
+// a string is used, a string record assigns it the next identifier,
+// and later records only contain the identifier plus one, or zero for
+// NULL strings. The diagnostics of failed expectations are rarely
+// repeated, and are stored inline as a varint length, including the
+// trailing NUL, followed by the string data.
+
+#define BINARY_MAGIC            "MUTR"
+#define BINARY_MAGIC_LEN        4
+#define BINARY_VERSION          1
+
+// The optional parts of a spec results record
+enum {
+  SPEC_HAS_BENCH = 1 << 0,
+  SPEC_HAS_PERF = 1 << 1,
+  SPEC_HAS_ALLOC = 1 << 2,
+};
+
+typedef struct {
+  uint64_t hash;
+  char *str;
+  uint64_t id;
+} interned_string_t;
+
+static struct {
+  // The payload of the record being written
+  mutest_event_buffer_t record;
+
+  // The string records written while building a record
+  mutest_event_buffer_t strings;
+
+  // An open addressing hash table of the strings written so far;
+  // the size is a power of two, at least twice the number of entries
+  interned_string_t *slots;
+  size_t size;
+  size_t n_entries;
+} binary;
+
+static void
+put_byte (mutest_event_buffer_t *buffer,
+          uint8_t value)
+{
+  mutest_event_buffer_append (buffer, &value, sizeof (uint8_t));
+}
+
+// Returns: the number of bytes written in @data
+static size_t
+encode_varint (uint8_t data[10],
+               uint64_t value)
+{
+  size_t len = 0;
+
+  do
+    {
+      uint8_t byte = value & 0x7f;
+
+      value >>= 7;
+      if (value != 0)
+        byte |= 0x80;
+
+      data[len++] = byte;
+    }
+  while (value != 0);
+
+  return len;
+}
+
+static void
+put_varint (mutest_event_buffer_t *buffer,
+            uint64_t value)
+{
+  uint8_t data[10];
+  size_t len = encode_varint (data, value);
+
+  mutest_event_buffer_append (buffer, data, len);
+}
+
+static void
+put_svarint (mutest_event_buffer_t *buffer,
+             int64_t value)
+{
+  put_varint (buffer, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static void
+put_double (mutest_event_buffer_t *buffer,
+            double value)
+{
+  uint64_t bits;
+  uint8_t data[8];
+
+  memcpy (&bits, &value, sizeof (double));
+
+  for (int i = 0; i < 8; i++)
+    data[i] = (uint8_t) (bits >> (i * 8));
+
+  mutest_event_buffer_append (buffer, data, 8);
+}
+
+static void
+put_literal (mutest_event_buffer_t *buffer,
+             const char *str)
+{
+  if (str == NULL)
+    {
+      put_varint (buffer, 0);
+      return;
+    }
+
+  size_t len = strlen (str) + 1;
+
+  put_varint (buffer, len);
+  mutest_event_buffer_append (buffer, str, len);
+}
+
+static interned_string_t *
+string_table_find_slot (interned_string_t *slots,
+                        size_t size,
+                        uint64_t hash,
+                        const char *str)
+{
+  size_t mask = size - 1;
+  size_t i = (size_t) hash & mask;
+
+  while (slots[i].str != NULL &&
+         (slots[i].hash != hash || strcmp (slots[i].str, str) != 0))
+    i = (i + 1) & mask;
+
+  return &slots[i];
+}
+
+static void
+string_table_resize (size_t size)
+{
+  interned_string_t *slots = calloc (size, sizeof (interned_string_t));
+  if (slots == NULL)
+    mutest_oom_abort ();
+
+  for (size_t i = 0; i < binary.size; i++)
+    {
+      const interned_string_t *entry = &binary.slots[i];
+
+      if (entry->str != NULL)
+        *string_table_find_slot (slots, size, entry->hash, entry->str) = *entry;
+    }
+
+  free (binary.slots);
+
+  binary.slots = slots;
+  binary.size = size;
+}
+
+static void
+string_table_clear (void)
+{
+  for (size_t i = 0; i < binary.size; i++)
+    free (binary.slots[i].str);
+
+  free (binary.slots);
+
+  binary.slots = NULL;
+  binary.size = 0;
+  binary.n_entries = 0;
+}
+
+// Writes the identifier of @str in the current record, and queues
+// a string record for it if this is the first time it is used
+static void
+put_string (const char *str)
+{
+  if (str == NULL)
+    {
+      put_varint (&binary.record, 0);
+      return;
+    }
+
+  if ((binary.n_entries + 1) * 2 > binary.size)
+    string_table_resize (binary.size > 0 ? binary.size * 2 : 256);
+
+  uint64_t hash = mutest_hash_string (MUTEST_HASH_INIT, str);
+  interned_string_t *slot =
+    string_table_find_slot (binary.slots, binary.size, hash, str);
+
+  if (slot->str == NULL)
+    {
+      slot->hash = hash;
+      slot->str = mutest_strdup (str);
+      slot->id = binary.n_entries++;
+
+      uint8_t id[10];
+      size_t id_len = encode_varint (id, slot->id);
+      size_t str_len = strlen (str) + 1;
+      uint8_t len[10];
+      size_t len_len = encode_varint (len, str_len);
+
+      put_varint (&binary.strings, 1 + id_len + len_len + str_len);
+      put_byte (&binary.strings, MUTEST_BINARY_STRING);
+      mutest_event_buffer_append (&binary.strings, id, id_len);
+      mutest_event_buffer_append (&binary.strings, len, len_len);
+      mutest_event_buffer_append (&binary.strings, str, str_len);
+    }
+
+  put_varint (&binary.record, slot->id + 1);
+}
+
+static void
+begin_record (mutest_binary_record_type_t record_type)
+{
+  binary.record.len = 0;
+  binary.strings.len = 0;
+
+  put_byte (&binary.record, record_type);
+}
+
+// Writes the string records used by the current record, followed by
+// the record itself
+static void
+end_record (void)
+{
+  uint8_t len[10];
+  size_t len_len = encode_varint (len, binary.record.len);
+
+  if (binary.strings.len > 0)
+    mutest_output_write (stdout, binary.strings.data, binary.strings.len);
+
+  mutest_output_write (stdout, (const char *) len, len_len);
+  mutest_output_write (stdout, binary.record.data, binary.record.len);
+}
+
+static void
+binary_main_preamble (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+#ifdef OS_WINDOWS
+  _setmode (_fileno (stdout), _O_BINARY);
+#endif
+
+  const uint8_t version = BINARY_VERSION;
+
+  mutest_output_write (stdout, BINARY_MAGIC, BINARY_MAGIC_LEN);
+  mutest_output_write (stdout, (const char *) &version, 1);
+
+  begin_record (MUTEST_BINARY_START);
+  put_svarint (&binary.record, state->shard_index);
+  put_svarint (&binary.record, state->shard_count);
+  end_record ();
+}
+
+static void
+binary_suite_preamble (mutest_suite_t *suite)
+{
+  begin_record (MUTEST_BINARY_SUITE);
+  put_string (suite->description);
+  put_string (suite->file);
+  put_svarint (&binary.record, suite->line);
+  put_string (suite->func_name);
+  end_record ();
+}
+
+static void
+binary_spec_preamble (mutest_spec_t *spec)
+{
+  begin_record (MUTEST_BINARY_SPEC);
+  put_string (spec->description);
+  put_string (spec->file);
+  put_svarint (&binary.record, spec->line);
+  put_string (spec->func_name);
+  end_record ();
+}
+
+static void
+put_expect (const mutest_expect_t *expect)
+{
+  put_string (expect->description);
+  put_string (expect->file);
+  put_svarint (&binary.record, expect->line);
+  put_string (expect->func_name);
+}
+
+static void
+binary_expect_result (mutest_expect_t *expect)
+{
+  begin_record (MUTEST_BINARY_EXPECT);
+  put_expect (expect);
+  put_byte (&binary.record, expect->result);
+  put_string (expect->skip_reason);
+  end_record ();
+}
+
+static void
+binary_expect_fail (mutest_expect_t *expect,
+                    bool negate,
+                    mutest_expect_res_t *check,
+                    const char *check_repr)
+{
+  char *diagnostic = NULL;
+  mutest_expect_diagnostic (expect, negate, check, check_repr,
+                            &diagnostic,
+                            NULL);
+
+  begin_record (MUTEST_BINARY_EXPECT_FAIL);
+  put_expect (expect);
+  put_literal (&binary.record, diagnostic);
+  end_record ();
+
+  free (diagnostic);
+}
+
+static void
+binary_spec_results (mutest_spec_t *spec)
+{
+  mutest_event_buffer_t *record = &binary.record;
+  uint8_t flags = 0;
+
+  if (spec->bench.n_samples != 0)
+    flags |= SPEC_HAS_BENCH;
+  if (spec->perf.enabled)
+    flags |= SPEC_HAS_PERF;
+  if (mutest_get_global_state ()->alloc_stats)
+    flags |= SPEC_HAS_ALLOC;
+
+  begin_record (MUTEST_BINARY_SPEC_RESULTS);
+  put_string (spec->description);
+  put_string (spec->file);
+  put_svarint (record, spec->line);
+  put_string (spec->func_name);
+  put_svarint (record, spec->n_expects);
+  put_svarint (record, spec->pass);
+  put_svarint (record, spec->fail);
+  put_svarint (record, spec->skip);
+  put_svarint (record, spec->start_time);
+  put_svarint (record, spec->end_time - spec->start_time);
+  put_byte (record, spec->skip_all ? 1 : 0);
+  put_string (spec->skip_reason);
+  put_byte (record, flags);
+
+  if ((flags & SPEC_HAS_BENCH) != 0)
+    {
+      put_svarint (record, spec->bench.iterations);
+      put_svarint (record, spec->bench.n_samples);
+      put_double (record, spec->bench.median);
+      put_double (record, spec->bench.mad);
+      put_double (record, spec->bench.ci_low);
+      put_double (record, spec->bench.ci_high);
+    }
+
+  if ((flags & SPEC_HAS_PERF) != 0)
+    {
+      put_svarint (record, spec->perf.error);
+      for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+        put_svarint (record, spec->perf.values[i]);
+    }
+
+  if ((flags & SPEC_HAS_ALLOC) != 0)
+    {
+      put_byte (record, spec->alloc.available ? 1 : 0);
+      put_svarint (record, spec->alloc.n_allocs);
+      put_svarint (record, spec->alloc.n_frees);
+      put_svarint (record, spec->alloc.n_bytes);
+    }
+
+  end_record ();
+}
+
+static void
+binary_suite_results (mutest_suite_t *suite)
+{
+  mutest_event_buffer_t *record = &binary.record;
+
+  begin_record (MUTEST_BINARY_SUITE_RESULTS);
+  put_string (suite->description);
+  put_string (suite->file);
+  put_svarint (record, suite->line);
+  put_string (suite->func_name);
+  put_svarint (record, suite->n_specs);
+  put_svarint (record, suite->pass);
+  put_svarint (record, suite->fail);
+  put_svarint (record, suite->skip);
+  put_svarint (record, suite->start_time);
+  put_svarint (record, suite->end_time - suite->start_time);
+  put_byte (record, suite->skip_all ? 1 : 0);
+  put_string (suite->skip_reason);
+  end_record ();
+}
+
+static void
+binary_total_results (mutest_state_t *state)
+{
+  mutest_event_buffer_t *record = &binary.record;
+  int total_pass, total_fail, total_skip;
+
+  mutest_get_results (&total_pass, &total_fail, &total_skip);
+
+  begin_record (MUTEST_BINARY_RESULTS);
+  put_svarint (record, total_pass);
+  put_svarint (record, total_fail);
+  put_svarint (record, total_skip);
+  put_svarint (record, state->total_filtered);
+  put_svarint (record, state->end_time - state->start_time);
+  put_byte (record, mutest_is_cancelled () ? 1 : 0);
+  end_record ();
+
+  mutest_event_buffer_clear (&binary.record);
+  mutest_event_buffer_clear (&binary.strings);
+  string_table_clear ();
+}
+
+const mutest_formatter_t *
+mutest_get_binary_formatter (void)
+{
+  static mutest_formatter_t binary_formatter = {
+    .main_preamble = binary_main_preamble,
+    .suite_preamble = binary_suite_preamble,
+    .spec_preamble = binary_spec_preamble,
+    .expect_result = binary_expect_result,
+    .expect_fail = binary_expect_fail,
+    .spec_results = binary_spec_results,
+    .suite_results = binary_suite_results,
+    .total_results = binary_total_results,
+  };
+
+  return &binary_formatter;
+}
+
+// Reading the log
+
+typedef struct {
+  const char *data;
+  size_t end;
+  size_t pos;
+  bool error;
+} binary_cursor_t;
+
+static uint8_t
+get_byte (binary_cursor_t *cursor)
+{
+  if (cursor->error || cursor->pos >= cursor->end)
+    {
+      cursor->error = true;
+      return 0;
+    }
+
+  return (uint8_t) cursor->data[cursor->pos++];
+}
+
+static uint64_t
+get_varint (binary_cursor_t *cursor)
+{
+  uint64_t res = 0;
+
+  for (int shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t byte = get_byte (cursor);
+
+      res |= (uint64_t) (byte & 0x7f) << shift;
+
+      if ((byte & 0x80) == 0)
+        return res;
+    }
+
+  cursor->error = true;
+
+  return 0;
+}
+
+static int64_t
+get_svarint (binary_cursor_t *cursor)
+{
+  uint64_t value = get_varint (cursor);
+
+  return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static int
+get_int (binary_cursor_t *cursor)
+{
+  int64_t value = get_svarint (cursor);
+
+  if (value < INT32_MIN || value > INT32_MAX)
+    {
+      cursor->error = true;
+      return 0;
+    }
+
+  return (int) value;
+}
+
+static double
+get_double (binary_cursor_t *cursor)
+{
+  uint64_t bits = 0;
+  double res;
+
+  for (int i = 0; i < 8; i++)
+    bits |= (uint64_t) get_byte (cursor) << (i * 8);
+
+  memcpy (&res, &bits, sizeof (double));
+
+  return res;
+}
+
+// The returned string points into the data of the log
+static const char *
+get_literal (binary_cursor_t *cursor)
+{
+  uint64_t len = get_varint (cursor);
+
+  if (cursor->error || len == 0)
+    return NULL;
+
+  if (cursor->end - cursor->pos < len ||
+      cursor->data[cursor->pos + len - 1] != '\0')
+    {
+      cursor->error = true;
+      return NULL;
+    }
+
+  const char *res = cursor->data + cursor->pos;
+  cursor->pos += len;
+
+  return res;
+}
+
+static const char *
+get_string (mutest_binary_reader_t *reader,
+            binary_cursor_t *cursor)
+{
+  uint64_t id = get_varint (cursor);
+
+  if (cursor->error || id == 0)
+    return NULL;
+
+  if (id > reader->n_strings)
+    {
+      cursor->error = true;
+      return NULL;
+    }
+
+  return reader->strings[id - 1];
+}
+
+static void
+get_string_record (mutest_binary_reader_t *reader,
+                   binary_cursor_t *cursor)
+{
+  uint64_t id = get_varint (cursor);
+  const char *str = get_literal (cursor);
+
+  if (cursor->error || str == NULL || id > reader->n_strings)
+    {
+      cursor->error = true;
+      return;
+    }
+
+  // Strings are already known when reading a part of the log again
+  if (id < reader->n_strings)
+    return;
+
+  if (reader->n_strings == reader->size_strings)
+    {
+      size_t size = reader->size_strings > 0 ? reader->size_strings * 2 : 256;
+      const char **strings = realloc (reader->strings, size * sizeof (char *));
+      if (strings == NULL)
+        mutest_oom_abort ();
+
+      reader->strings = strings;
+      reader->size_strings = size;
+    }
+
+  reader->strings[reader->n_strings++] = str;
+}
+
+static void
+get_location (mutest_binary_reader_t *reader,
+              binary_cursor_t *cursor,
+              const char **description,
+              const char **file,
+              int *line,
+              const char **func_name)
+{
+  *description = get_string (reader, cursor);
+  *file = get_string (reader, cursor);
+  *line = get_int (cursor);
+  *func_name = get_string (reader, cursor);
+}
+
+static void
+get_spec_results (mutest_binary_reader_t *reader,
+                  binary_cursor_t *cursor,
+                  mutest_spec_t *spec)
+{
+  spec->n_expects = get_int (cursor);
+  spec->pass = get_int (cursor);
+  spec->fail = get_int (cursor);
+  spec->skip = get_int (cursor);
+  spec->start_time = get_svarint (cursor);
+  spec->end_time = spec->start_time + get_svarint (cursor);
+  spec->skip_all = get_byte (cursor) != 0;
+  spec->skip_reason = get_string (reader, cursor);
+
+  uint8_t flags = get_byte (cursor);
+
+  if ((flags & SPEC_HAS_BENCH) != 0)
+    {
+      spec->bench.iterations = get_svarint (cursor);
+      spec->bench.n_samples = get_int (cursor);
+      spec->bench.median = get_double (cursor);
+      spec->bench.mad = get_double (cursor);
+      spec->bench.ci_low = get_double (cursor);
+      spec->bench.ci_high = get_double (cursor);
+    }
+
+  if ((flags & SPEC_HAS_PERF) != 0)
+    {
+      spec->perf.enabled = true;
+      spec->perf.error = get_int (cursor);
+      for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+        spec->perf.values[i] = get_svarint (cursor);
+    }
+
+  if ((flags & SPEC_HAS_ALLOC) != 0)
+    {
+      reader->has_alloc_stats = true;
+
+      spec->alloc.available = get_byte (cursor) != 0;
+      spec->alloc.n_allocs = get_svarint (cursor);
+      spec->alloc.n_frees = get_svarint (cursor);
+      spec->alloc.n_bytes = get_svarint (cursor);
+    }
+}
+
+static void
+get_suite_results (mutest_binary_reader_t *reader,
+                   binary_cursor_t *cursor,
+                   mutest_suite_t *suite)
+{
+  suite->n_specs = get_int (cursor);
+  suite->pass = get_int (cursor);
+  suite->fail = get_int (cursor);
+  suite->skip = get_int (cursor);
+  suite->start_time = get_svarint (cursor);
+  suite->end_time = suite->start_time + get_svarint (cursor);
+  suite->skip_all = get_byte (cursor) != 0;
+  suite->skip_reason = get_string (reader, cursor);
+}
+
+// mutest_binary_reader_init:
+// @reader: the reader to initialize
+// @data: the contents of a log
+// @len: the length of @data
+//
+// Initializes @reader, and checks the header of the log; @data must
+// stay valid as long as the records read from @reader are in use.
+//
+// Returns: true if @data is a log in a known version
+bool
+mutest_binary_reader_init (mutest_binary_reader_t *reader,
+                           const char *data,
+                           size_t len)
+{
+  memset (reader, 0, sizeof (mutest_binary_reader_t));
+
+  reader->data = data;
+  reader->len = len;
+
+  if (len < BINARY_MAGIC_LEN + 1 ||
+      memcmp (data, BINARY_MAGIC, BINARY_MAGIC_LEN) != 0 ||
+      data[BINARY_MAGIC_LEN] != BINARY_VERSION)
+    {
+      reader->error = true;
+      return false;
+    }
+
+  reader->pos = BINARY_MAGIC_LEN + 1;
+
+  return true;
+}
+
+void
+mutest_binary_reader_clear (mutest_binary_reader_t *reader)
+{
+  free (reader->strings);
+
+  reader->strings = NULL;
+  reader->n_strings = 0;
+  reader->size_strings = 0;
+}
+
+// mutest_binary_reader_next:
+// @reader: a reader
+// @record: return location for the next record
+//
+// Reads the next record of the log; string records are handled by
+// the reader, and unknown records are skipped. The strings of @record
+// point into the log.
+//
+// To read again a part of the log, set the position of @reader to the
+// offset of one of its records.
+//
+// Returns: false at the end of the log, or if the log is malformed,
+//   in which case the error flag of @reader is set
+bool
+mutest_binary_reader_next (mutest_binary_reader_t *reader,
+                           mutest_binary_record_t *record)
+{
+  while (!reader->error && reader->pos < reader->len)
+    {
+      binary_cursor_t cursor = {
+        .data = reader->data,
+        .end = reader->len,
+        .pos = reader->pos,
+        .error = false,
+      };
+
+      uint64_t len = get_varint (&cursor);
+
+      // A truncated trailing record is the end of the log
+      if (cursor.error || cursor.end - cursor.pos < len)
+        {
+          reader->truncated = true;
+          reader->pos = reader->len;
+          return false;
+        }
+
+      memset (record, 0, sizeof (mutest_binary_record_t));
+
+      record->offset = reader->pos;
+      cursor.end = cursor.pos + len;
+      reader->pos = cursor.end;
+
+      record->type = get_byte (&cursor);
+
+      switch (record->type)
+        {
+        case MUTEST_BINARY_STRING:
+          get_string_record (reader, &cursor);
+          break;
+
+        case MUTEST_BINARY_START:
+          record->shard_index = get_int (&cursor);
+          record->shard_count = get_int (&cursor);
+          break;
+
+        case MUTEST_BINARY_SUITE:
+          get_location (reader, &cursor,
+                        &record->suite.description,
+                        &record->suite.file,
+                        &record->suite.line,
+                        &record->suite.func_name);
+          break;
+
+        case MUTEST_BINARY_SPEC:
+          get_location (reader, &cursor,
+                        &record->spec.description,
+                        &record->spec.file,
+                        &record->spec.line,
+                        &record->spec.func_name);
+          break;
+
+        case MUTEST_BINARY_EXPECT:
+          get_location (reader, &cursor,
+                        &record->expect.description,
+                        &record->expect.file,
+                        &record->expect.line,
+                        &record->expect.func_name);
+          record->expect.result = get_byte (&cursor);
+          record->expect.skip_reason = get_string (reader, &cursor);
+          if (record->expect.result > MUTEST_RESULT_SKIP)
+            cursor.error = true;
+          break;
+
+        case MUTEST_BINARY_EXPECT_FAIL:
+          get_location (reader, &cursor,
+                        &record->expect.description,
+                        &record->expect.file,
+                        &record->expect.line,
+                        &record->expect.func_name);
+          record->expect.result = MUTEST_RESULT_FAIL;
+          record->expect.diagnostic = get_literal (&cursor);
+          if (record->expect.diagnostic == NULL)
+            cursor.error = true;
+          break;
+
+        case MUTEST_BINARY_SPEC_RESULTS:
+          get_location (reader, &cursor,
+                        &record->spec.description,
+                        &record->spec.file,
+                        &record->spec.line,
+                        &record->spec.func_name);
+          get_spec_results (reader, &cursor, &record->spec);
+          break;
+
+        case MUTEST_BINARY_SUITE_RESULTS:
+          get_location (reader, &cursor,
+                        &record->suite.description,
+                        &record->suite.file,
+                        &record->suite.line,
+                        &record->suite.func_name);
+          get_suite_results (reader, &cursor, &record->suite);
+          break;
+
+        case MUTEST_BINARY_RESULTS:
+          record->pass = get_int (&cursor);
+          record->fail = get_int (&cursor);
+          record->skip = get_int (&cursor);
+          record->filtered = get_int (&cursor);
+          record->duration = get_svarint (&cursor);
+          record->cancelled = get_byte (&cursor) != 0;
+          break;
+
+        // Records from newer versions of the log
+        default:
+          continue;
+        }
+
+      if (cursor.error)
+        {
+          reader->error = true;
+          return false;
+        }
+
+      if (record->type != MUTEST_BINARY_STRING)
+        return true;
+    }
+
+  return false;
+}
@@ -0,0 +1,398 @@
+/* mutest-format-json.c: JSON format output
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+// The JSON output is a stream of events, one JSON object per line, as
+// soon as they happen; each object has an "event" member with the type
+// of the event:
+//
+//  - "start", at the beginning of the run
+//  - "suite", when a suite starts
+//  - "spec", when a spec starts
+//  - "diagnostic", for a failed expectation, before its result
+//  - "expect", for the result of an expectation
+//  - "spec-results", when a spec ends
+//  - "suite-results", when a suite ends
+//  - "results", at the end of the run
+//
+// The events of a spec come between its "spec" and "spec-results"
+// events, and the ones of a suite between its "suite" and
+// "suite-results" events.
+//
+// Each object is written out directly to the output buffer, escaping
+// the strings on the fly, so the memory used does not depend on the
+// number of events, or on their size.
+
+static const char *counter_keys[MUTEST_PERF_N_COUNTERS] = {
+  [MUTEST_PERF_CYCLES] = "cycles",
+  [MUTEST_PERF_INSTRUCTIONS] = "instructions",
+  [MUTEST_PERF_BRANCH_MISSES] = "branch_misses",
+  [MUTEST_PERF_L1D_MISSES] = "l1d_misses",
+  [MUTEST_PERF_LLC_MISSES] = "llc_misses",
+};
+
+// Whether the next member of the current object needs a separator
+static bool needs_comma;
+
+static void
+json_write (const char *str,
+            size_t len)
+{
+  mutest_output_write (stdout, str, len);
+}
+
+static void
+json_write_string (const char *str)
+{
+  if (str == NULL)
+    {
+      json_write ("null", 4);
+      return;
+    }
+
+  json_write ("\"", 1);
+
+  const char *run = str;
+
+  for (const char *p = str; *p != '\0'; p++)
+    {
+      unsigned char c = (unsigned char) *p;
+      char escape[8];
+
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+
+      json_write (run, (size_t) (p - run));
+      run = p + 1;
+
+      switch (c)
+        {
+        case '"':
+          json_write ("\\\"", 2);
+          break;
+        case '\\':
+          json_write ("\\\\", 2);
+          break;
+        case '\n':
+          json_write ("\\n", 2);
+          break;
+        case '\r':
+          json_write ("\\r", 2);
+          break;
+        case '\t':
+          json_write ("\\t", 2);
+          break;
+        default:
+          snprintf (escape, sizeof (escape), "\\u%04x", c);
+          json_write (escape, 6);
+          break;
+        }
+    }
+
+  json_write (run, strlen (run));
+  json_write ("\"", 1);
+}
+
+static void
+json_key (const char *key)
+{
+  if (needs_comma)
+    json_write (",", 1);
+
+  json_write_string (key);
+  json_write (":", 1);
+
+  needs_comma = true;
+}
+
+static void
+json_begin (const char *event)
+{
+  json_write ("{", 1);
+
+  needs_comma = false;
+
+  json_key ("event");
+  json_write_string (event);
+}
+
+static void
+json_end (void)
+{
+  json_write ("}\n", 2);
+
+  mutest_output_end_line (stdout);
+}
+
+static void
+json_begin_object (const char *key)
+{
+  json_key (key);
+  json_write ("{", 1);
+
+  needs_comma = false;
+}
+
+static void
+json_end_object (void)
+{
+  json_write ("}", 1);
+
+  needs_comma = true;
+}
+
+static void
+json_string_member (const char *key,
+                    const char *value)
+{
+  json_key (key);
+  json_write_string (value);
+}
+
+static void
+json_int_member (const char *key,
+                 int64_t value)
+{
+  char buf[32];
+  int len = snprintf (buf, sizeof (buf), "%" PRId64, value);
+
+  json_key (key);
+  json_write (buf, (size_t) len);
+}
+
+static void
+json_double_member (const char *key,
+                    double value)
+{
+  json_key (key);
+
+  // JSON has no representation for infinities and NaNs
+  if (!isfinite (value))
+    {
+      json_write ("null", 4);
+      return;
+    }
+
+  char buf[32];
+  int len = snprintf (buf, sizeof (buf), "%.17g", value);
+
+  json_write (buf, (size_t) len);
+}
+
+static void
+json_bool_member (const char *key,
+                  bool value)
+{
+  json_key (key);
+
+  if (value)
+    json_write ("true", 4);
+  else
+    json_write ("false", 5);
+}
+
+static void
+json_main_preamble (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  json_begin ("start");
+
+  if (state->shard_count > 1)
+    {
+      json_int_member ("shard_index", state->shard_index);
+      json_int_member ("shard_count", state->shard_count);
+    }
+
+  json_end ();
+}
+
+static void
+json_suite_preamble (mutest_suite_t *suite)
+{
+  json_begin ("suite");
+  json_string_member ("description", suite->description);
+  json_string_member ("file", suite->file);
+  json_int_member ("line", suite->line);
+  json_end ();
+}
+
+static void
+json_spec_preamble (mutest_spec_t *spec)
+{
+  json_begin ("spec");
+  json_string_member ("description", spec->description);
+  json_string_member ("file", spec->file);
+  json_int_member ("line", spec->line);
+  json_end ();
+}
+
+static void
+json_expect_result (mutest_expect_t *expect)
+{
+  json_begin ("expect");
+  json_string_member ("description", expect->description);
+
+  switch (expect->result)
+    {
+    case MUTEST_RESULT_PASS:
+      json_string_member ("result", "pass");
+      break;
+
+    case MUTEST_RESULT_FAIL:
+      json_string_member ("result", "fail");
+      break;
+
+    case MUTEST_RESULT_SKIP:
+      json_string_member ("result", "skip");
+      json_string_member ("skip_reason", expect->skip_reason);
+      break;
+    }
+
+  json_string_member ("file", expect->file);
+  json_int_member ("line", expect->line);
+  json_string_member ("function", expect->func_name);
+  json_end ();
+}
+
+static void
+json_expect_fail (mutest_expect_t *expect,
+                  bool negate,
+                  mutest_expect_res_t *check,
+                  const char *check_repr)
+{
+  char *diagnostic = NULL;
+  char *location = NULL;
+  mutest_expect_diagnostic (expect, negate, check, check_repr,
+                            &diagnostic,
+                            &location);
+
+  json_begin ("diagnostic");
+  json_string_member ("description", expect->description);
+  json_string_member ("diagnostic", diagnostic);
+  json_string_member ("location", location);
+  json_end ();
+
+  free (diagnostic);
+  free (location);
+}
+
+static void
+json_spec_results (mutest_spec_t *spec)
+{
+  json_begin ("spec-results");
+  json_string_member ("description", spec->description);
+  json_int_member ("pass", spec->pass);
+  json_int_member ("fail", spec->fail);
+  json_int_member ("skip", spec->skip);
+
+  if (spec->skip_all)
+    {
+      json_bool_member ("skipped", true);
+      json_string_member ("skip_reason", spec->skip_reason);
+    }
+
+  json_int_member ("duration_ns", spec->end_time - spec->start_time);
+
+  if (spec->bench.n_samples != 0)
+    {
+      json_begin_object ("bench");
+      json_int_member ("iterations", spec->bench.iterations);
+      json_int_member ("samples", spec->bench.n_samples);
+      json_double_member ("median_ns", spec->bench.median);
+      json_double_member ("mad_ns", spec->bench.mad);
+      json_double_member ("ci_low_ns", spec->bench.ci_low);
+      json_double_member ("ci_high_ns", spec->bench.ci_high);
+      json_end_object ();
+    }
+
+  if (spec->perf.enabled && spec->perf.error != 0)
+    {
+      json_key ("counters");
+      json_write ("null", 4);
+    }
+  else if (spec->perf.enabled)
+    {
+      json_begin_object ("counters");
+      for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+        {
+          if (spec->perf.values[i] >= 0)
+            json_int_member (counter_keys[i], spec->perf.values[i]);
+        }
+      json_end_object ();
+    }
+
+  if (mutest_get_global_state ()->alloc_stats && spec->alloc.available)
+    {
+      json_begin_object ("allocations");
+      json_int_member ("allocs", spec->alloc.n_allocs);
+      json_int_member ("frees", spec->alloc.n_frees);
+      json_int_member ("bytes", spec->alloc.n_bytes);
+      json_end_object ();
+    }
+
+  json_end ();
+}
+
+static void
+json_suite_results (mutest_suite_t *suite)
+{
+  json_begin ("suite-results");
+  json_string_member ("description", suite->description);
+  json_int_member ("specs", suite->n_specs);
+  json_int_member ("pass", suite->pass);
+  json_int_member ("fail", suite->fail);
+  json_int_member ("skip", suite->skip);
+
+  if (suite->skip_all)
+    {
+      json_bool_member ("skipped", true);
+      json_string_member ("skip_reason", suite->skip_reason);
+    }
+
+  json_int_member ("duration_ns", suite->end_time - suite->start_time);
+  json_end ();
+}
+
+static void
+json_total_results (mutest_state_t *state)
+{
+  int total_pass, total_fail, total_skip;
+
+  mutest_get_results (&total_pass, &total_fail, &total_skip);
+
+  json_begin ("results");
+  json_int_member ("pass", total_pass);
+  json_int_member ("fail", total_fail);
+  json_int_member ("skip", total_skip);
+  json_int_member ("filtered", state->total_filtered);
+  json_int_member ("duration_ns", state->end_time - state->start_time);
+  json_bool_member ("cancelled", mutest_is_cancelled ());
+  json_end ();
+}
+
+const mutest_formatter_t *
+mutest_get_json_formatter (void)
+{
+  static mutest_formatter_t json = {
+    .main_preamble = json_main_preamble,
+    .suite_preamble = json_suite_preamble,
+    .spec_preamble = json_spec_preamble,
+    .expect_result = json_expect_result,
+    .expect_fail = json_expect_fail,
+    .spec_results = json_spec_results,
+    .suite_results = json_suite_results,
+    .total_results = json_total_results,
+  };
+
+  return &json;
+}
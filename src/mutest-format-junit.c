@@ -0,0 +1,383 @@
+/* mutest-format-junit.c: JUnit XML format output
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <string.h>
+
+// Each suite is a <testsuite> element, and each spec of the suite is
+// a <testcase> element, with a <failure> element listing the failed
+// expectations, or a <skipped> element for skipped specs.
+//
+// The attributes of a <testsuite> element contain the results of the
+// suite, so the test cases are collected in a buffer until the suite
+// ends; then the whole element is written out and flushed, so that the
+// suites that completed are available even if the run does not.
+
+static struct {
+  // A copy of the description of the current suite
+  char *suite_name;
+
+  // The <testcase> elements of the current suite
+  mutest_event_buffer_t testcases;
+
+  int n_failures;
+  int n_skipped;
+
+  // The failed expectations of the current spec
+  mutest_event_buffer_t failures;
+
+  // A copy of the description of the first failed expectation
+  char *failure_message;
+
+  // Whether the last failed expectation had a diagnostic
+  bool has_diagnostic;
+} junit;
+
+static void
+junit_append (mutest_event_buffer_t *buffer,
+              const char *str)
+{
+  mutest_event_buffer_append (buffer, str, strlen (str));
+}
+
+static void
+junit_append_escaped (mutest_event_buffer_t *buffer,
+                      const char *str,
+                      bool is_attribute)
+{
+  if (str == NULL)
+    return;
+
+  const char *run = str;
+
+  for (const char *p = str; *p != '\0'; p++)
+    {
+      unsigned char c = (unsigned char) *p;
+      const char *entity = NULL;
+
+      switch (c)
+        {
+        case '&':
+          entity = "&amp;";
+          break;
+        case '<':
+          entity = "&lt;";
+          break;
+        case '>':
+          entity = "&gt;";
+          break;
+        case '"':
+          entity = "&quot;";
+          break;
+        case '\n':
+          entity = is_attribute ? "&#10;" : NULL;
+          break;
+        case '\t':
+          entity = is_attribute ? "&#9;" : NULL;
+          break;
+        case '\r':
+          entity = "&#13;";
+          break;
+        default:
+          // Other control characters are not allowed in XML 1.0
+          // documents, not even as character references
+          if (c < 0x20)
+            entity = "?";
+          break;
+        }
+
+      if (entity == NULL)
+        continue;
+
+      mutest_event_buffer_append (buffer, run, (size_t) (p - run));
+      junit_append (buffer, entity);
+      run = p + 1;
+    }
+
+  junit_append (buffer, run);
+}
+
+static void
+junit_append_attribute (mutest_event_buffer_t *buffer,
+                        const char *name,
+                        const char *value)
+{
+  junit_append (buffer, " ");
+  junit_append (buffer, name);
+  junit_append (buffer, "=\"");
+  junit_append_escaped (buffer, value, true);
+  junit_append (buffer, "\"");
+}
+
+static void
+junit_append_int_attribute (mutest_event_buffer_t *buffer,
+                            const char *name,
+                            int value)
+{
+  char buf[32];
+
+  snprintf (buf, 32, "%d", value);
+
+  junit_append_attribute (buffer, name, buf);
+}
+
+static void
+junit_append_time_attribute (mutest_event_buffer_t *buffer,
+                             int64_t t)
+{
+  char buf[64];
+
+  // JUnit times are in seconds
+  snprintf (buf, 64, "%.6f", (double) t / 1e9);
+
+  junit_append_attribute (buffer, "time", buf);
+}
+
+static void
+junit_main_preamble (void)
+{
+  mutest_print (stdout, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>", NULL);
+  mutest_print (stdout, "<testsuites>", NULL);
+}
+
+static void
+junit_suite_preamble (mutest_suite_t *suite)
+{
+  free (junit.suite_name);
+  junit.suite_name = mutest_strdup (suite->description);
+
+  junit.testcases.len = 0;
+  junit.n_failures = 0;
+  junit.n_skipped = 0;
+}
+
+static void
+junit_reset_failures (void)
+{
+  junit.failures.len = 0;
+  junit.has_diagnostic = false;
+
+  free (junit.failure_message);
+  junit.failure_message = NULL;
+}
+
+static void
+junit_spec_preamble (mutest_spec_t *spec)
+{
+  (void) spec;
+
+  junit_reset_failures ();
+}
+
+static void
+junit_expect_result (mutest_expect_t *expect)
+{
+  if (expect->result != MUTEST_RESULT_FAIL)
+    return;
+
+  if (junit.failure_message == NULL)
+    junit.failure_message = mutest_strdup (expect->description);
+
+  // Failures without a diagnostic, like crashing specs, are
+  // described by the expectation itself
+  if (!junit.has_diagnostic)
+    {
+      junit_append_escaped (&junit.failures, expect->description, false);
+      junit_append (&junit.failures, "\n");
+    }
+
+  junit.has_diagnostic = false;
+}
+
+static void
+junit_expect_fail (mutest_expect_t *expect,
+                   bool negate,
+                   mutest_expect_res_t *check,
+                   const char *check_repr)
+{
+  char *diagnostic = NULL;
+  char *location = NULL;
+  mutest_expect_diagnostic (expect, negate, check, check_repr,
+                           &diagnostic,
+                           &location);
+
+  junit_append_escaped (&junit.failures, location, false);
+  junit_append (&junit.failures, ": ");
+  junit_append_escaped (&junit.failures, diagnostic, false);
+  junit_append (&junit.failures, "\n");
+
+  junit.has_diagnostic = true;
+
+  free (diagnostic);
+  free (location);
+}
+
+static void
+junit_spec_results (mutest_spec_t *spec)
+{
+  mutest_event_buffer_t *buffer = &junit.testcases;
+
+  junit_append (buffer, "    <testcase");
+  junit_append_attribute (buffer, "name", spec->description);
+  junit_append_attribute (buffer, "classname", junit.suite_name);
+  junit_append_attribute (buffer, "file", spec->file);
+  junit_append_int_attribute (buffer, "line", spec->line);
+  junit_append_int_attribute (buffer, "assertions", spec->pass + spec->fail + spec->skip);
+  junit_append_time_attribute (buffer, spec->end_time - spec->start_time);
+
+  bool is_skipped = spec->skip_all || (spec->pass == 0 && spec->fail == 0 && spec->skip > 0);
+  bool has_output = spec->bench.n_samples != 0
+                 || spec->perf.enabled
+                 || mutest_get_global_state ()->alloc_stats;
+
+  if (spec->fail == 0 && !is_skipped && !has_output)
+    {
+      junit_append (buffer, "/>\n");
+      junit_reset_failures ();
+      return;
+    }
+
+  junit_append (buffer, ">\n");
+
+  if (spec->fail > 0)
+    {
+      junit.n_failures += 1;
+
+      junit_append (buffer, "      <failure");
+      junit_append_attribute (buffer, "message", junit.failure_message);
+      junit_append_attribute (buffer, "type", "expectation");
+      junit_append (buffer, ">");
+      mutest_event_buffer_append (buffer, junit.failures.data, junit.failures.len);
+      junit_append (buffer, "</failure>\n");
+    }
+  else if (is_skipped)
+    {
+      junit.n_skipped += 1;
+
+      junit_append (buffer, "      <skipped");
+      if (spec->skip_reason != NULL)
+        junit_append_attribute (buffer, "message", spec->skip_reason);
+      junit_append (buffer, "/>\n");
+    }
+
+  if (has_output)
+    {
+      char buf[256];
+
+      junit_append (buffer, "      <system-out>");
+
+      if (spec->bench.n_samples != 0)
+        {
+          mutest_format_bench_results (&spec->bench, buf, 256);
+          junit_append (buffer, "bench: ");
+          junit_append_escaped (buffer, buf, false);
+          junit_append (buffer, "\n");
+        }
+
+      if (spec->perf.enabled)
+        {
+          mutest_format_perf_counters (&spec->perf, buf, 256);
+          junit_append (buffer, "counters: ");
+          junit_append_escaped (buffer, buf, false);
+          junit_append (buffer, "\n");
+        }
+
+      if (mutest_get_global_state ()->alloc_stats)
+        {
+          mutest_format_alloc_stats (&spec->alloc, buf, 256);
+          junit_append (buffer, "allocations: ");
+          junit_append_escaped (buffer, buf, false);
+          junit_append (buffer, "\n");
+        }
+
+      junit_append (buffer, "</system-out>\n");
+    }
+
+  junit_append (buffer, "    </testcase>\n");
+
+  junit_reset_failures ();
+}
+
+static void
+junit_suite_results (mutest_suite_t *suite)
+{
+  mutest_event_buffer_t header;
+
+  mutest_event_buffer_init (&header);
+
+  // A skipped suite is reported as a single skipped test case, as it
+  // counts as a single skipped test in the total results
+  if (suite->skip_all && suite->n_specs == 0)
+    {
+      junit_append (&junit.testcases, "    <testcase");
+      junit_append_attribute (&junit.testcases, "name", suite->description);
+      junit_append_attribute (&junit.testcases, "classname", suite->description);
+      junit_append_attribute (&junit.testcases, "time", "0");
+      junit_append (&junit.testcases, ">\n      <skipped");
+      if (suite->skip_reason != NULL)
+        junit_append_attribute (&junit.testcases, "message", suite->skip_reason);
+      junit_append (&junit.testcases, "/>\n    </testcase>\n");
+
+      junit.n_skipped = 1;
+    }
+
+  junit_append (&header, "  <testsuite");
+  junit_append_attribute (&header, "name", suite->description);
+  junit_append_attribute (&header, "file", suite->file);
+  junit_append_int_attribute (&header, "tests", suite->n_specs > 0 ? suite->n_specs : junit.n_skipped);
+  junit_append_int_attribute (&header, "failures", junit.n_failures);
+  junit_append_int_attribute (&header, "errors", 0);
+  junit_append_int_attribute (&header, "skipped", junit.n_skipped);
+  junit_append_int_attribute (&header, "assertions", suite->pass + suite->fail + suite->skip);
+  junit_append_time_attribute (&header, suite->skip_all && suite->n_specs == 0
+                                         ? 0
+                                         : suite->end_time - suite->start_time);
+  junit_append (&header, ">\n");
+
+  mutest_output_write (stdout, header.data, header.len);
+  mutest_output_write (stdout, junit.testcases.data, junit.testcases.len);
+  mutest_print (stdout, "  </testsuite>", NULL);
+
+  // Make the suite available to readers as soon as it completes
+  mutest_output_flush ();
+
+  mutest_event_buffer_clear (&header);
+
+  free (junit.suite_name);
+  junit.suite_name = NULL;
+}
+
+static void
+junit_total_results (mutest_state_t *state)
+{
+  (void) state;
+
+  mutest_print (stdout, "</testsuites>", NULL);
+
+  junit_reset_failures ();
+
+  mutest_event_buffer_clear (&junit.testcases);
+  mutest_event_buffer_clear (&junit.failures);
+}
+
+const mutest_formatter_t *
+mutest_get_junit_formatter (void)
+{
+  static mutest_formatter_t junit_formatter = {
+    .main_preamble = junit_main_preamble,
+    .suite_preamble = junit_suite_preamble,
+    .spec_preamble = junit_spec_preamble,
+    .expect_result = junit_expect_result,
+    .expect_fail = junit_expect_fail,
+    .spec_results = junit_spec_results,
+    .suite_results = junit_suite_results,
+    .total_results = junit_total_results,
+  };
+
+  return &junit_formatter;
+}
@@ -157,6 +157,18 @@ mocha_spec_results (mutest_spec_t *spec)
   delta_t = mutest_format_time (spec->end_time - spec->start_time, &delta_u);
   snprintf (delta_s, 128, "(%.2f %s)", delta_t, delta_u);
 
+  char bench_s[256], counters_s[256], allocations_s[256];
+  bool alloc_stats = mutest_get_global_state ()->alloc_stats;
+
+  if (spec->bench.n_samples != 0)
+    mutest_format_bench_results (&spec->bench, bench_s, 256);
+
+  if (spec->perf.enabled)
+    mutest_format_perf_counters (&spec->perf, counters_s, 256);
+
+  if (alloc_stats)
+    mutest_format_alloc_stats (&spec->alloc, allocations_s, 256);
+
   if (mutest_use_colors ())
     {
       mutest_print (stdout,
@@ -166,6 +178,27 @@ mocha_spec_results (mutest_spec_t *spec)
                     MUTEST_COLOR_DARK_GREY, delta_s, MUTEST_COLOR_NONE,
                     NULL);
 
+      if (spec->perf.enabled)
+        mutest_print (stdout,
+                      indent_expect (),
+                      MUTEST_COLOR_BLUE, "counters: ", MUTEST_COLOR_NONE,
+                      MUTEST_COLOR_DARK_GREY, counters_s, MUTEST_COLOR_NONE,
+                      NULL);
+
+      if (alloc_stats)
+        mutest_print (stdout,
+                      indent_expect (),
+                      MUTEST_COLOR_BLUE, "allocations: ", MUTEST_COLOR_NONE,
+                      MUTEST_COLOR_DARK_GREY, allocations_s, MUTEST_COLOR_NONE,
+                      NULL);
+
+      if (spec->bench.n_samples != 0)
+        mutest_print (stdout,
+                      indent_expect (),
+                      MUTEST_COLOR_BLUE, "bench: ", MUTEST_COLOR_NONE,
+                      MUTEST_COLOR_DARK_GREY, bench_s, MUTEST_COLOR_NONE,
+                      NULL);
+
       if (spec->skip != 0)
         mutest_print (stdout,
                       indent_expect (),
@@ -182,12 +215,26 @@ mocha_spec_results (mutest_spec_t *spec)
       mutest_print (stdout, "", NULL);
     }
   else
-    mutest_print (stdout,
-                  "\n",
-                  indent_expect (), passing_s, " ", delta_s, "\n",
-                  indent_expect (), skipped_s, "\n",
-                  indent_expect (), failing_s, "\n",
-                  NULL);
+    {
+      mutest_print (stdout,
+                    "\n",
+                    indent_expect (), passing_s, " ", delta_s,
+                    NULL);
+
+      if (spec->perf.enabled)
+        mutest_print (stdout, indent_expect (), "counters: ", counters_s, NULL);
+
+      if (alloc_stats)
+        mutest_print (stdout, indent_expect (), "allocations: ", allocations_s, NULL);
+
+      if (spec->bench.n_samples != 0)
+        mutest_print (stdout, indent_expect (), "bench: ", bench_s, NULL);
+
+      mutest_print (stdout,
+                    indent_expect (), skipped_s, "\n",
+                    indent_expect (), failing_s, "\n",
+                    NULL);
+    }
 }
 
 static void
@@ -233,11 +280,12 @@ mocha_total_results (mutest_state_t *state)
 
   mutest_get_results (&total_pass, &total_fail, &total_skip);
 
-  char passing_s[128], failing_s[128], skipped_s[128];
+  char passing_s[128], failing_s[128], skipped_s[128], filtered_s[128];
 
   snprintf (passing_s, 128, "%d passing", total_pass);
   snprintf (failing_s, 128, "%d failing", total_fail);
   snprintf (skipped_s, 128, "%d skipped", total_skip);
+  snprintf (filtered_s, 128, "%d filtered", state->total_filtered);
 
   const char *delta_u;
   double delta_t;
@@ -265,16 +313,36 @@ mocha_total_results (mutest_state_t *state)
                       MUTEST_COLOR_RED, failing_s, MUTEST_COLOR_NONE,
                       NULL);
 
+      if (state->total_filtered != 0)
+        mutest_print (stdout,
+                      MUTEST_COLOR_DARK_GREY, filtered_s, MUTEST_COLOR_NONE,
+                      NULL);
+
+      if (mutest_is_cancelled ())
+        mutest_print (stdout,
+                      MUTEST_COLOR_DARK_GREY, "stopped after the first failure", MUTEST_COLOR_NONE,
+                      NULL);
+
       mutest_print (stdout, "", NULL);
     }
   else
-    mutest_print (stdout,
-                  "\n",
-                  "Total\n",
-                  passing_s, " ", delta_s, "\n",
-                  skipped_s, "\n",
-                  failing_s, "\n",
-                  NULL);
+    {
+      mutest_print (stdout,
+                    "\n",
+                    "Total\n",
+                    passing_s, " ", delta_s, "\n",
+                    skipped_s, "\n",
+                    failing_s,
+                    NULL);
+
+      if (state->total_filtered != 0)
+        mutest_print (stdout, filtered_s, NULL);
+
+      if (mutest_is_cancelled ())
+        mutest_print (stdout, "stopped after the first failure", NULL);
+
+      mutest_print (stdout, "", NULL);
+    }
 }
 
 static void
@@ -62,6 +62,37 @@ tap_expect_fail (mutest_expect_t *expect,
   free (location);
 }
 
+static void
+tap_spec_results (mutest_spec_t *spec)
+{
+  if (spec->perf.enabled)
+    {
+      char counters[256];
+
+      mutest_format_perf_counters (&spec->perf, counters, 256);
+
+      mutest_print (stdout, "# counters: ", counters, NULL);
+    }
+
+  if (mutest_get_global_state ()->alloc_stats)
+    {
+      char allocations[256];
+
+      mutest_format_alloc_stats (&spec->alloc, allocations, 256);
+
+      mutest_print (stdout, "# allocations: ", allocations, NULL);
+    }
+
+  if (spec->bench.n_samples != 0)
+    {
+      char bench[256];
+
+      mutest_format_bench_results (&spec->bench, bench, 256);
+
+      mutest_print (stdout, "# bench: ", bench, NULL);
+    }
+}
+
 static void
 tap_spec_preamble (mutest_spec_t *spec)
 {
@@ -81,10 +112,32 @@ tap_main_preamble (void)
 }
 
 static void
-tap_total_results (mutest_state_t *state MUTEST_UNUSED)
+tap_total_results (mutest_state_t *state)
 {
   int n_tests, n_skipped;
 
+  // The plan only covers the specs of this shard
+  if (state->shard_count > 1)
+    {
+      char shard[128];
+
+      snprintf (shard, 128, "# shard %d of %d", state->shard_index + 1, state->shard_count);
+
+      mutest_print (stdout, shard, NULL);
+    }
+
+  if (state->total_filtered > 0)
+    {
+      char filtered[128];
+
+      snprintf (filtered, 128, "# filtered %d", state->total_filtered);
+
+      mutest_print (stdout, filtered, NULL);
+    }
+
+  if (mutest_is_cancelled ())
+    mutest_print (stdout, "# stopped after the first failure", NULL);
+
   n_tests = mutest_get_results (NULL, NULL, &n_skipped);
 
   if (n_tests == n_skipped)
@@ -108,7 +161,7 @@ mutest_get_tap_formatter (void)
     .spec_preamble = tap_spec_preamble,
     .expect_result = tap_expect_result,
     .expect_fail = tap_expect_fail,
-    .spec_results = NULL,
+    .spec_results = tap_spec_results,
     .suite_results = NULL,
     .total_results = tap_total_results,
   };
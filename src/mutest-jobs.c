@@ -0,0 +1,1220 @@
+/* mutest-jobs.c: Parallel spec execution
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H) && defined(HAVE_POLL_H) && defined(HAVE_SIGNAL_H)
+# define MUTEST_HAVE_JOBS 1
+#endif
+
+bool
+mutest_jobs_available (void)
+{
+#ifdef MUTEST_HAVE_JOBS
+  return true;
+#else
+  return false;
+#endif
+}
+
+// mutest_jobs_isolate_spec:
+// @spec: a spec
+//
+// Checks whether @spec must run inside a worker process even when the
+// current scheduler runs specs inside the runner: a spec with a timeout
+// cannot be stopped otherwise.
+//
+// Returns: true if @spec should be run by mutest_jobs_run_spec()
+bool
+mutest_jobs_isolate_spec (const mutest_spec_t *spec)
+{
+#ifdef MUTEST_HAVE_JOBS
+  return mutest_spec_get_timeout (spec) > 0;
+#else
+  return false;
+#endif
+}
+
+#ifdef MUTEST_HAVE_JOBS
+
+// Each spec is run inside a worker process forked from the runner; the
+// worker records every formatter event into a buffer, and sends it back
+// through a pipe once the spec is done. The runner replays the events of
+// each spec in the same order the specs were declared, so the output and
+// the results are identical to a serial run.
+//
+// The before_each() and after_each() hooks are called by the runner,
+// around the fork, so that the state they modify is the same as in a
+// serial run; each worker starts from a copy-on-write snapshot of the
+// state set up by the hooks.
+typedef struct {
+  pid_t pid;
+  int fd;
+
+  bool done;
+  int status;
+
+  mutest_spec_t *spec;
+  mutest_event_buffer_t events;
+
+  // What to blame if the job terminates abnormally
+  const char *subject;
+
+  // The deadline of the spec, or 0 for no timeout; once the deadline
+  // passes the worker is terminated, and killed after a grace period
+  int64_t start_time;
+  int64_t deadline;
+  bool timed_out;
+
+  // The time the worker ran for, in microseconds
+  int64_t elapsed;
+
+  // Whether the job was not run, or was terminated, because the
+  // run was cancelled after a failure; nothing is reported for it
+  bool cancelled;
+} mutest_job_t;
+
+static struct {
+  mutest_job_t *jobs;
+  size_t n_jobs;
+  size_t size;
+
+  // Index of the first job that hasn't been replayed yet
+  size_t head;
+
+  int n_running;
+} job_queue;
+
+static mutest_job_t *
+job_queue_push (void)
+{
+  if (job_queue.n_jobs == job_queue.size)
+    {
+      size_t new_size = job_queue.size > 0 ? job_queue.size * 2 : 16;
+      mutest_job_t *jobs = realloc (job_queue.jobs, new_size * sizeof (mutest_job_t));
+      if (jobs == NULL)
+        mutest_oom_abort ();
+
+      job_queue.jobs = jobs;
+      job_queue.size = new_size;
+    }
+
+  mutest_job_t *job = &job_queue.jobs[job_queue.n_jobs];
+
+  job_queue.n_jobs += 1;
+
+  memset (job, 0, sizeof (mutest_job_t));
+  mutest_event_buffer_init (&job->events);
+  job->fd = -1;
+  job->subject = "spec";
+
+  return job;
+}
+
+static void
+write_all (int fd,
+           const char *data,
+           size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t res = write (fd, data, len);
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          perror ("write");
+          _exit (EXIT_FAILURE);
+        }
+
+      data += res;
+      len -= res;
+    }
+}
+
+// Inside a suite server, the pipe used to forward the results
+// of the specs to the runner
+static int server_fd = -1;
+
+// The state of a worker process, used to send the recorded
+// events to the runner if the spec crashes
+static int worker_fd = -1;
+static mutest_event_buffer_t *worker_events;
+static volatile sig_atomic_t worker_flushed;
+
+// Called from signal handlers, so it must be async-signal-safe
+static void
+worker_flush (void)
+{
+  if (worker_fd < 0 || worker_flushed)
+    return;
+
+  worker_flushed = 1;
+
+  const char *data = worker_events->data;
+  size_t len = worker_events->len;
+
+  while (len > 0)
+    {
+      ssize_t res = write (worker_fd, data, len);
+
+      if (res < 0 && errno == EINTR)
+        continue;
+
+      if (res <= 0)
+        break;
+
+      data += res;
+      len -= res;
+    }
+}
+
+static void
+worker_crash_handler (int sig)
+{
+  worker_flush ();
+
+  // The handler is reset to the default action, so the
+  // signal will terminate the worker once we return
+  raise (sig);
+}
+
+// mutest_jobs_worker_abort:
+// @file: the file name
+// @line: the line number
+// @func_name: the function name
+// @message: the message
+//
+// Sends the recorded events, and the location of the abort, to
+// the runner, if we're inside a worker process.
+//
+// This function is called by mutest_assert_message(), so it cannot
+// allocate memory.
+void
+mutest_jobs_worker_abort (const char *file,
+                          int line,
+                          const char *func_name,
+                          const char *message)
+{
+  if (worker_fd < 0)
+    return;
+
+  worker_flush ();
+
+  char data[MUTEST_EVENT_ABORT_SIZE];
+  mutest_event_buffer_t buffer;
+
+  mutest_event_buffer_init_static (&buffer, data, MUTEST_EVENT_ABORT_SIZE);
+  mutest_event_record_spec_abort (&buffer, file, line, func_name, message);
+
+  if (write (worker_fd, buffer.data, buffer.len) < 0)
+    return;
+}
+
+MUTEST_NO_RETURN static void
+job_worker (int fd,
+            mutest_spec_t *spec)
+{
+  mutest_event_buffer_t events;
+
+  mutest_event_buffer_init (&events);
+  mutest_set_recorder (&events);
+
+  worker_fd = fd;
+  worker_events = &events;
+  worker_flushed = 0;
+
+  mutest_install_crash_handler (worker_crash_handler);
+
+  mutest_spec_exec (spec);
+  mutest_event_record_spec_results (&events, spec);
+
+  mutest_set_recorder (NULL);
+
+  // Flush anything the spec wrote using stdio before we go
+  mutest_output_sync ();
+  fflush (stdout);
+  fflush (stderr);
+
+  write_all (fd, events.data, events.len);
+  close (fd);
+
+  _exit (EXIT_SUCCESS);
+}
+
+// The time a worker has to terminate after its deadline, before
+// being killed
+#define JOB_GRACE_PERIOD        1000000
+
+// Terminates all the running workers after the first failure, in
+// fail-fast mode; their specs are not reported
+static void
+job_queue_cancel (void)
+{
+  int64_t now = mutest_get_current_time ();
+
+  mutest_cancel ();
+
+  for (size_t i = job_queue.head; i < job_queue.n_jobs; i++)
+    {
+      mutest_job_t *job = &job_queue.jobs[i];
+
+      if (job->done || job->pid == 0 || job->cancelled)
+        continue;
+
+      // The deadline check kills the worker if it does not
+      // terminate within the grace period
+      job->cancelled = true;
+      job->timed_out = true;
+      job->deadline = now + JOB_GRACE_PERIOD;
+      kill (job->pid, SIGTERM);
+    }
+}
+
+static bool
+job_failed (const mutest_job_t *job)
+{
+  if (job->timed_out ||
+      !WIFEXITED (job->status) ||
+      WEXITSTATUS (job->status) != EXIT_SUCCESS)
+    return true;
+
+  return mutest_event_has_failures (job->events.data, job->events.len);
+}
+
+static void
+job_finish (mutest_job_t *job)
+{
+  close (job->fd);
+  job->fd = -1;
+
+  while (waitpid (job->pid, &job->status, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          perror ("waitpid");
+          abort ();
+        }
+    }
+
+  // Timed out jobs stopped the clock at their deadline
+  if (!job->timed_out)
+    job->elapsed = mutest_get_current_time () - job->start_time;
+
+  job->done = true;
+  job_queue.n_running -= 1;
+
+  if (mutest_get_global_state ()->fail_fast &&
+      !job->cancelled &&
+      job_failed (job))
+    job_queue_cancel ();
+}
+
+// Terminates the workers that went past their deadline
+//
+// Returns: the timeout for poll(), in milliseconds, until the
+//   next deadline; or -1 if there is no deadline
+static int
+job_queue_check_deadlines (mutest_job_t **jobs,
+                           int n_jobs)
+{
+  int64_t now = mutest_get_current_time ();
+  int64_t next = -1;
+
+  for (int i = 0; i < n_jobs; i++)
+    {
+      mutest_job_t *job = jobs[i];
+
+      if (job->done || job->deadline == 0)
+        continue;
+
+      if (job->deadline <= now)
+        {
+          if (!job->timed_out)
+            {
+              // Allow the worker to send what it recorded so far
+              job->timed_out = true;
+              job->elapsed = now - job->start_time;
+              job->deadline = now + JOB_GRACE_PERIOD;
+              kill (job->pid, SIGTERM);
+            }
+          else
+            {
+              job->deadline = 0;
+              kill (job->pid, SIGKILL);
+              continue;
+            }
+        }
+
+      if (next < 0 || job->deadline < next)
+        next = job->deadline;
+    }
+
+  if (next < 0)
+    return -1;
+
+  return (int) ((next - now + 999) / 1000);
+}
+
+// Reads the output of the running jobs, and reaps the ones that
+// have terminated; blocks until at least one job is done
+static void
+job_queue_poll (void)
+{
+  struct pollfd *fds = malloc (sizeof (struct pollfd) * job_queue.n_running);
+  mutest_job_t **jobs = malloc (sizeof (mutest_job_t *) * job_queue.n_running);
+  if (fds == NULL || jobs == NULL)
+    mutest_oom_abort ();
+
+  int n_fds = 0;
+  for (size_t i = job_queue.head; i < job_queue.n_jobs; i++)
+    {
+      mutest_job_t *job = &job_queue.jobs[i];
+
+      // Done, or not started yet
+      if (job->done || job->pid == 0)
+        continue;
+
+      fds[n_fds].fd = job->fd;
+      fds[n_fds].events = POLLIN;
+      fds[n_fds].revents = 0;
+      jobs[n_fds] = job;
+      n_fds += 1;
+    }
+
+  bool finished = false;
+  while (!finished)
+    {
+      int res = poll (fds, n_fds, job_queue_check_deadlines (jobs, n_fds));
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          perror ("poll");
+          abort ();
+        }
+
+      for (int i = 0; i < n_fds; i++)
+        {
+          if (fds[i].revents == 0 || fds[i].fd < 0)
+            continue;
+
+          char buf[4096];
+          ssize_t len = read (fds[i].fd, buf, sizeof (buf));
+
+          if (len < 0 && errno == EINTR)
+            continue;
+
+          if (len > 0)
+            {
+              mutest_event_buffer_append (&jobs[i]->events, buf, len);
+              continue;
+            }
+
+          // EOF, or an error; either way, the worker is gone
+          job_finish (jobs[i]);
+          fds[i].fd = -1;
+          finished = true;
+        }
+    }
+
+  free (fds);
+  free (jobs);
+}
+
+static const char *
+signal_name (int sig)
+{
+  static const struct {
+    int sig;
+    const char *name;
+  } signal_names[] = {
+    { SIGSEGV, "SIGSEGV" },
+    { SIGBUS, "SIGBUS" },
+    { SIGFPE, "SIGFPE" },
+    { SIGILL, "SIGILL" },
+    { SIGABRT, "SIGABRT" },
+    { SIGTRAP, "SIGTRAP" },
+    { SIGKILL, "SIGKILL" },
+    { SIGTERM, "SIGTERM" },
+    { SIGINT, "SIGINT" },
+    { SIGPIPE, "SIGPIPE" },
+    { SIGALRM, "SIGALRM" },
+  };
+
+  for (size_t i = 0; i < sizeof (signal_names) / sizeof (signal_names[0]); i++)
+    {
+      if (signal_names[i].sig == sig)
+        return signal_names[i].name;
+    }
+
+  return "signal";
+}
+
+// Reports an abnormal termination of the worker, or of the suite
+// server, as a failed expectation of the spec
+static void
+job_report_failure (mutest_job_t *job,
+                    const char *subject,
+                    const mutest_replay_info_t *info)
+{
+  mutest_spec_t *spec = job->spec;
+
+  char reason[256];
+
+  if (job->timed_out)
+    {
+      const char *unit;
+      double elapsed = mutest_format_time (job->elapsed * 1000, &unit);
+
+      snprintf (reason, 256, "timed out after %.2f %s", elapsed, unit);
+    }
+  else if (WIFSIGNALED (job->status))
+    {
+      int sig = WTERMSIG (job->status);
+      const char *desc = NULL;
+
+#ifdef HAVE_STRSIGNAL
+      desc = strsignal (sig);
+#endif
+
+      snprintf (reason, 256, "terminated by %s (%d%s%s)",
+                signal_name (sig), sig,
+                desc != NULL ? ", " : "",
+                desc != NULL ? desc : "");
+    }
+  else if (WIFEXITED (job->status) && WEXITSTATUS (job->status) != EXIT_SUCCESS)
+    snprintf (reason, 256, "exited with status %d", WEXITSTATUS (job->status));
+  else
+    snprintf (reason, 256, "exited without results");
+
+  const char *file = spec->file;
+  int line = spec->line;
+  const char *func_name = spec->func_name;
+
+  if (info->file != NULL)
+    {
+      file = info->file;
+      line = info->line;
+      func_name = info->func_name;
+    }
+
+  char description[1024];
+
+  if (info->aborted)
+    snprintf (description, 1024, "%s %s: %s at %s (%s:%d)",
+              subject, reason,
+              info->message != NULL ? info->message : "assertion",
+              func_name != NULL ? func_name : "<local>",
+              file, line);
+  else if (info->file != NULL)
+    snprintf (description, 1024, "%s %s after the expectation at %s (%s:%d)",
+              subject, reason,
+              func_name != NULL ? func_name : "<local>",
+              file, line);
+  else
+    snprintf (description, 1024, "%s %s before any expectation (%s:%d)",
+              subject, reason,
+              file, line);
+
+  mutest_expect_t expect = {
+    .file = file,
+    .line = line,
+    .func_name = func_name,
+    .description = description,
+    .result = MUTEST_RESULT_FAIL,
+  };
+
+  mutest_format_expect_result (&expect);
+
+  // The worker did not send its results, so we use the
+  // ones of the expectations that were replayed
+  spec->pass = info->pass;
+  spec->fail = info->fail + 1;
+  spec->skip = info->skip;
+  spec->n_expects = spec->pass + spec->fail + spec->skip;
+  spec->skip_all = false;
+  spec->skip_reason = NULL;
+
+  // Nor its duration, so we use the time the worker ran for
+  spec->start_time = 0;
+  spec->end_time = job->elapsed * 1000;
+}
+
+static void
+job_forward (mutest_job_t *job);
+
+static void
+job_replay (mutest_suite_t *suite,
+            mutest_job_t *job)
+{
+  // Inside a suite server the runner does the replaying
+  if (server_fd >= 0)
+    {
+      job_forward (job);
+      return;
+    }
+
+  mutest_spec_t *spec = job->spec;
+
+  if (job->cancelled)
+    {
+      mutest_event_buffer_clear (&job->events);
+      return;
+    }
+
+  mutest_format_spec_preamble (spec);
+
+  if (job->pid != 0)
+    {
+      mutest_replay_info_t info;
+
+      mutest_event_replay (job->events.data, job->events.len, spec, &info);
+
+      if (!info.has_results ||
+          job->timed_out ||
+          !WIFEXITED (job->status) ||
+          WEXITSTATUS (job->status) != EXIT_SUCCESS)
+        job_report_failure (job, job->subject, &info);
+    }
+
+  mutest_suite_add_spec_results (suite, spec);
+
+  mutest_format_spec_results (spec);
+
+  // The skip reason is owned by the events buffer
+  spec->skip_reason = NULL;
+
+  mutest_event_buffer_clear (&job->events);
+
+  // Specs run by a suite server are only seen failing here
+  if (spec->fail > 0 && mutest_get_global_state ()->fail_fast)
+    mutest_cancel ();
+}
+
+static void
+job_queue_replay (mutest_suite_t *suite)
+{
+  while (job_queue.head < job_queue.n_jobs &&
+         job_queue.jobs[job_queue.head].done)
+    {
+      job_replay (suite, &job_queue.jobs[job_queue.head]);
+      job_queue.head += 1;
+    }
+
+  if (job_queue.head == job_queue.n_jobs)
+    {
+      job_queue.head = 0;
+      job_queue.n_jobs = 0;
+    }
+}
+
+// Runs the spec of @job inside a worker process, waiting for
+// a free slot if the maximum number of jobs is already running.
+//
+// The results of the spec are folded into @suite once the
+// worker is done, and the spec has been replayed.
+static void
+job_start (mutest_suite_t *suite,
+           mutest_job_t *job)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+  mutest_spec_t *spec = job->spec;
+
+  while (job_queue.n_running >= state->n_jobs)
+    {
+      job_queue_poll ();
+      job_queue_replay (suite);
+    }
+
+  if (mutest_is_cancelled ())
+    {
+      job->done = true;
+      job->cancelled = true;
+
+      job_queue_replay (suite);
+
+      return;
+    }
+
+  mutest_spec_before (suite, spec);
+
+  // Skipped by the before_each() hook; no need for a worker
+  if (spec->skip_all)
+    {
+      job->done = true;
+      job->pid = 0;
+      job->fd = -1;
+
+      mutest_spec_after (suite, spec);
+      job_queue_replay (suite);
+
+      return;
+    }
+
+  int fds[2];
+  if (pipe (fds) < 0)
+    {
+      perror ("pipe");
+      abort ();
+    }
+
+  // Avoid duplicating pending stdio buffers in the worker
+  mutest_output_sync ();
+  fflush (stdout);
+  fflush (stderr);
+
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      perror ("fork");
+      abort ();
+    }
+
+  if (pid == 0)
+    {
+      close (fds[0]);
+      job_worker (fds[1], spec);
+    }
+
+  close (fds[1]);
+
+  job->pid = pid;
+  job->fd = fds[0];
+
+  int64_t timeout = mutest_spec_get_timeout (spec);
+
+  job->start_time = mutest_get_current_time ();
+  job->deadline = timeout > 0 ? job->start_time + timeout : 0;
+
+  job_queue.n_running += 1;
+
+  mutest_spec_after (suite, spec);
+}
+
+// Waits for all the pending specs of @suite
+static void
+job_queue_wait (mutest_suite_t *suite)
+{
+  while (job_queue.n_running > 0)
+    {
+      job_queue_poll ();
+      job_queue_replay (suite);
+    }
+
+  job_queue_replay (suite);
+}
+
+// Runs all the specs of @suite in worker processes; the specs with
+// the longest recorded durations are started first, to avoid having
+// a slow spec hold up the whole suite at the end, but the results
+// are still replayed in declaration order
+static void
+job_queue_run (mutest_suite_t *suite)
+{
+  size_t n_specs = 0;
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    n_specs += 1;
+
+  if (n_specs == 0)
+    return;
+
+  // All the jobs are allocated upfront, so their position in the
+  // queue is the declaration order
+  size_t first = job_queue.n_jobs;
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    {
+      mutest_job_t *job = job_queue_push ();
+
+      job->spec = spec;
+    }
+
+  size_t *order = mutest_timings_order (suite, n_specs);
+
+  for (size_t i = 0; i < n_specs; i++)
+    {
+      size_t index = order != NULL ? order[i] : i;
+
+      job_start (suite, &job_queue.jobs[first + index]);
+    }
+
+  free (order);
+
+  job_queue_wait (suite);
+}
+
+// Suites with a before() hook are run inside a "suite server": a
+// process forked from the runner that calls the before() hook once,
+// and then forks a worker for each spec, so that every spec starts
+// from a copy-on-write snapshot of the state set up by the hook,
+// without paying its cost again, and without the state leaking into
+// the runner, or into the following suites.
+//
+// The suite server forwards the events recorded by each worker to the
+// runner, which replays them in order; the after() hook is called by
+// the server once the runner is done replaying the specs.
+typedef enum {
+  SERVER_FRAME_READY,
+  SERVER_FRAME_SKIP,
+  SERVER_FRAME_SPEC,
+  SERVER_FRAME_CANCELLED
+} server_frame_kind_t;
+
+typedef struct {
+  uint32_t kind;
+  int32_t status;
+  uint32_t len;
+
+  uint32_t timed_out;
+  int64_t elapsed;
+} server_frame_t;
+
+static struct {
+  pid_t pid;
+
+  // The runner side of the pipes
+  int cmd_fd;
+  int result_fd;
+
+  // Whether the server terminated, and its exit status
+  bool done;
+  int status;
+
+  // Whether the server terminated before setting up the suite
+  bool failed_setup;
+
+  mutest_event_buffer_t frame;
+} suite_server = {
+  .pid = 0,
+  .cmd_fd = -1,
+  .result_fd = -1,
+};
+
+static void
+server_write_frame (server_frame_kind_t kind,
+                    const mutest_job_t *job,
+                    const char *data,
+                    size_t len)
+{
+  server_frame_t frame = {
+    .kind = kind,
+    .status = job != NULL ? job->status : 0,
+    .len = (uint32_t) len,
+    .timed_out = job != NULL ? job->timed_out : false,
+    .elapsed = job != NULL ? job->elapsed : 0,
+  };
+
+  write_all (server_fd, (const char *) &frame, sizeof (server_frame_t));
+  if (len > 0)
+    write_all (server_fd, data, len);
+}
+
+static void
+job_forward (mutest_job_t *job)
+{
+  if (job->cancelled)
+    {
+      server_write_frame (SERVER_FRAME_CANCELLED, job, NULL, 0);
+      mutest_event_buffer_clear (&job->events);
+      return;
+    }
+
+  // Skipped by the before_each() hook, so there's no worker that
+  // recorded the results of the spec
+  if (job->pid == 0)
+    mutest_event_record_spec_results (&job->events, job->spec);
+
+  server_write_frame (SERVER_FRAME_SPEC, job,
+                      job->events.data,
+                      job->events.len);
+
+  mutest_event_buffer_clear (&job->events);
+}
+
+MUTEST_NO_RETURN static void
+server_main (mutest_suite_t *suite,
+             int cmd_fd,
+             int result_fd)
+{
+  server_fd = result_fd;
+
+  suite->before_hook ();
+
+  mutest_output_sync ();
+  fflush (stdout);
+  fflush (stderr);
+
+  if (suite->skip_all)
+    {
+      const char *reason = suite->skip_reason;
+
+      server_write_frame (SERVER_FRAME_SKIP, NULL,
+                          reason,
+                          reason != NULL ? strlen (reason) + 1 : 0);
+    }
+  else
+    {
+      server_write_frame (SERVER_FRAME_READY, NULL, NULL, 0);
+
+      job_queue_run (suite);
+    }
+
+  // Wait until the runner has replayed all the specs, and closed
+  // the command pipe, so that the after() hook is called at the
+  // same point of a serial run
+  char cmd;
+  while (read (cmd_fd, &cmd, 1) < 0 && errno == EINTR)
+    ;
+
+  if (suite->after_hook != NULL)
+    suite->after_hook ();
+
+  mutest_output_sync ();
+  fflush (stdout);
+  fflush (stderr);
+
+  close (result_fd);
+  close (cmd_fd);
+
+  _exit (EXIT_SUCCESS);
+}
+
+// Reads exactly @len bytes from the suite server; returns false
+// if the server went away
+static bool
+server_read (char *data,
+             size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t res = read (suite_server.result_fd, data, len);
+
+      if (res < 0 && errno == EINTR)
+        continue;
+
+      if (res <= 0)
+        return false;
+
+      data += res;
+      len -= res;
+    }
+
+  return true;
+}
+
+static void
+server_reap (void)
+{
+  if (suite_server.done)
+    return;
+
+  while (waitpid (suite_server.pid, &suite_server.status, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          perror ("waitpid");
+          abort ();
+        }
+    }
+
+  suite_server.done = true;
+}
+
+// Reads the next frame from the suite server into suite_server.frame;
+// returns false, and reaps the server, if the server went away
+static bool
+server_read_frame (server_frame_t *frame)
+{
+  mutest_event_buffer_clear (&suite_server.frame);
+
+  if (suite_server.done)
+    return false;
+
+  if (!server_read ((char *) frame, sizeof (server_frame_t)))
+    {
+      server_reap ();
+      return false;
+    }
+
+  if (frame->len > 0)
+    {
+      char buf[4096];
+      size_t left = frame->len;
+
+      while (left > 0)
+        {
+          size_t n = left < sizeof (buf) ? left : sizeof (buf);
+
+          if (!server_read (buf, n))
+            {
+              server_reap ();
+              return false;
+            }
+
+          mutest_event_buffer_append (&suite_server.frame, buf, n);
+          left -= n;
+        }
+    }
+
+  return true;
+}
+
+static void
+server_start (mutest_suite_t *suite)
+{
+  int cmd_fds[2], result_fds[2];
+
+  if (pipe (cmd_fds) < 0 || pipe (result_fds) < 0)
+    {
+      perror ("pipe");
+      abort ();
+    }
+
+  mutest_output_sync ();
+  fflush (stdout);
+  fflush (stderr);
+
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      perror ("fork");
+      abort ();
+    }
+
+  if (pid == 0)
+    {
+      close (cmd_fds[1]);
+      close (result_fds[0]);
+      server_main (suite, cmd_fds[0], result_fds[1]);
+    }
+
+  close (cmd_fds[0]);
+  close (result_fds[1]);
+
+  suite_server.pid = pid;
+  suite_server.cmd_fd = cmd_fds[1];
+  suite_server.result_fd = result_fds[0];
+  suite_server.done = false;
+  suite_server.status = 0;
+  suite_server.failed_setup = false;
+
+  server_frame_t frame;
+
+  if (!server_read_frame (&frame))
+    {
+      suite_server.failed_setup = true;
+      return;
+    }
+
+  if (frame.kind == SERVER_FRAME_SKIP)
+    {
+      suite->skip_all = true;
+
+      // The frame buffer is only released when the next server
+      // starts, so the reason is still valid for the suite results
+      if (frame.len > 0)
+        suite->skip_reason = suite_server.frame.data;
+      else
+        suite->skip_reason = NULL;
+    }
+}
+
+static void
+server_replay_specs (mutest_suite_t *suite)
+{
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    {
+      server_frame_t frame;
+      mutest_job_t job = {
+        .pid = suite_server.pid,
+        .fd = -1,
+        .done = true,
+        .spec = spec,
+        .subject = "spec",
+      };
+
+      bool has_frame = server_read_frame (&frame);
+
+      if (has_frame && frame.kind == SERVER_FRAME_CANCELLED)
+        continue;
+
+      if (has_frame && frame.kind == SERVER_FRAME_SPEC)
+        {
+          job.status = frame.status;
+          job.timed_out = frame.timed_out != 0;
+          job.elapsed = frame.elapsed;
+          job.events = suite_server.frame;
+        }
+      else
+        {
+          // The server is gone, so blame it for the rest of the specs
+          server_reap ();
+
+          job.status = suite_server.status;
+          job.subject = suite_server.failed_setup ? "suite setup" : "suite server";
+        }
+
+      job_replay (suite, &job);
+
+      suite_server.frame = job.events;
+    }
+}
+
+static void
+server_stop (mutest_suite_t *suite)
+{
+  // Closing the command pipe allows the server to call the
+  // after() hook; then we wait for it to terminate
+  close (suite_server.cmd_fd);
+
+  // If the server was already gone, we blamed it on the specs
+  bool reported = suite_server.done;
+
+  server_reap ();
+
+  close (suite_server.result_fd);
+
+  if (!reported &&
+      (!WIFEXITED (suite_server.status) ||
+       WEXITSTATUS (suite_server.status) != EXIT_SUCCESS))
+    {
+      mutest_output_sync ();
+      fprintf (stderr, "ERROR: server for suite '%s' terminated abnormally\n",
+               suite->description);
+    }
+
+  suite_server.pid = 0;
+  suite_server.cmd_fd = -1;
+  suite_server.result_fd = -1;
+}
+
+// mutest_jobs_suite_setup:
+// @suite: the suite to set up
+//
+// Calls the before() hook of @suite, either directly or, if the
+// suite has one, inside a suite server.
+void
+mutest_jobs_suite_setup (mutest_suite_t *suite)
+{
+  if (suite->before_hook != NULL)
+    server_start (suite);
+}
+
+// mutest_jobs_run_specs:
+// @suite: the current suite
+//
+// Runs all the specs of @suite in worker processes, and replays
+// their results.
+void
+mutest_jobs_run_specs (mutest_suite_t *suite)
+{
+  if (suite_server.pid != 0)
+    {
+      server_replay_specs (suite);
+      return;
+    }
+
+  job_queue_run (suite);
+}
+
+// mutest_jobs_run_spec:
+// @suite: the current suite
+// @spec: the spec to run
+//
+// Runs @spec in a worker process, waits for it, and replays its
+// results; used by the other schedulers for the specs selected by
+// mutest_jobs_isolate_spec().
+void
+mutest_jobs_run_spec (mutest_suite_t *suite,
+                      mutest_spec_t *spec)
+{
+  mutest_job_t *job = job_queue_push ();
+
+  job->spec = spec;
+
+  job_start (suite, job);
+  job_queue_wait (suite);
+}
+
+// mutest_jobs_suite_teardown:
+// @suite: the suite to tear down
+//
+// Calls the after() hook of @suite, and stops its suite server.
+void
+mutest_jobs_suite_teardown (mutest_suite_t *suite)
+{
+  if (suite_server.pid != 0)
+    {
+      server_stop (suite);
+      return;
+    }
+
+  if (suite->after_hook != NULL)
+    suite->after_hook ();
+}
+
+#else /* MUTEST_HAVE_JOBS */
+
+void
+mutest_jobs_suite_setup (mutest_suite_t *suite)
+{
+  if (suite->before_hook != NULL)
+    suite->before_hook ();
+}
+
+void
+mutest_jobs_run_specs (mutest_suite_t *suite)
+{
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    mutest_spec_run (suite, spec);
+}
+
+void
+mutest_jobs_run_spec (mutest_suite_t *suite,
+                      mutest_spec_t *spec)
+{
+  mutest_spec_run (suite, spec);
+}
+
+void
+mutest_jobs_suite_teardown (mutest_suite_t *suite)
+{
+  if (suite->after_hook != NULL)
+    suite->after_hook ();
+}
+
+void
+mutest_jobs_worker_abort (const char *file MUTEST_UNUSED,
+                          int line MUTEST_UNUSED,
+                          const char *func_name MUTEST_UNUSED,
+                          const char *message MUTEST_UNUSED)
+{
+}
+
+#endif /* MUTEST_HAVE_JOBS */
@@ -8,6 +8,7 @@
 #include "mutest-private.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,18 +32,45 @@ static mutest_state_t global_state = {
   .is_tty = false,
   .use_colors = false,
 
-  .current_suite = NULL,
-  .current_spec = NULL,
-
   .n_suites = 0,
   .total_pass = 0,
   .total_fail = 0,
   .total_skip = 0,
+  .total_filtered = 0,
 
   .start_time = 0,
   .end_time = 0,
+
+  .n_jobs = 1,
+  .isolate = false,
+  .default_timeout = 0,
+  .bench_time = 1000000,
+  .fail_fast = false,
+  .cancelled = 0,
+  .perf_counters = false,
+  .alloc_stats = false,
+  .scheduler = MUTEST_SCHEDULER_SERIAL,
+
+  .shard_index = 0,
+  .shard_count = 1,
+  .shard_by_duration = false,
+
+  .first_suite = NULL,
+  .last_suite = NULL,
+
+  .listeners = NULL,
+  .n_listeners = 0,
 };
 
+/* The execution context is per-thread, so that specs can
+ * run concurrently; see mutest-threads.c
+ */
+static MUTEST_THREAD_LOCAL mutest_suite_t *current_suite;
+static MUTEST_THREAD_LOCAL mutest_spec_t *current_spec;
+
+/* If set, formatter events are recorded instead of printed */
+static MUTEST_THREAD_LOCAL mutest_event_buffer_t *current_recorder;
+
 mutest_state_t *
 mutest_get_global_state (void)
 {
@@ -70,37 +98,50 @@ mutest_is_term_tty (void)
 bool
 mutest_use_colors (void)
 {
-  return global_state.use_colors;
+  // Files have no use for escape sequences
+  return global_state.use_colors && !mutest_output_is_redirected ();
 }
 
 mutest_suite_t *
 mutest_get_current_suite (void)
 {
-  return global_state.current_suite;
+  return current_suite;
 }
 
 mutest_spec_t *
 mutest_get_current_spec (void)
 {
-  return global_state.current_spec;
+  return current_spec;
 }
 
 void
 mutest_set_current_suite (mutest_suite_t *suite)
 {
-  if (suite != NULL && global_state.current_suite != NULL)
+  if (suite != NULL && current_suite != NULL)
     mutest_assert_if_reached ("overriding the current suite");
 
-  global_state.current_suite = suite;
+  current_suite = suite;
 }
 
 void
 mutest_set_current_spec (mutest_spec_t *spec)
 {
-  if (spec != NULL && global_state.current_spec != NULL)
+  if (spec != NULL && current_spec != NULL)
     mutest_assert_if_reached ("overriding the current spec");
 
-  global_state.current_spec = spec;
+  current_spec = spec;
+}
+
+void
+mutest_set_recorder (mutest_event_buffer_t *recorder)
+{
+  current_recorder = recorder;
+}
+
+mutest_event_buffer_t *
+mutest_get_recorder (void)
+{
+  return current_recorder;
 }
 
 void
@@ -223,6 +264,56 @@ update_term_size (void)
   errno = saved_errno;
 }
 
+static void
+add_output_sink (const char *name,
+                 mutest_output_format_t format,
+                 const char *path)
+{
+  for (int i = 0; i < global_state.n_output_sinks; i++)
+    {
+      mutest_output_sink_t *sink = &global_state.output_sinks[i];
+
+      // The formatters keep their state for a single output
+      if (sink->format == format)
+        {
+          fprintf (stderr, "WARNING: output format '%s' used more than once; "
+                           "only the first one is written\n",
+                   name);
+          return;
+        }
+
+      // Only one format can be written on the standard output
+      if (path == NULL && sink->output == 0)
+        {
+          fprintf (stderr, "WARNING: output format '%s' not written: only one "
+                           "format can be written on the standard output\n",
+                   name);
+          return;
+        }
+    }
+
+  int output = 0;
+
+  if (path != NULL)
+    {
+      output = mutest_output_open (path);
+      if (output < 0)
+        {
+          fprintf (stderr, "WARNING: unable to write output file '%s': %s\n",
+                   path,
+                   strerror (errno));
+          return;
+        }
+    }
+  else
+    global_state.output_format = format;
+
+  mutest_output_sink_t *sink = &global_state.output_sinks[global_state.n_output_sinks++];
+
+  sink->format = format;
+  sink->output = output;
+}
+
 static void
 update_output_format (void)
 {
@@ -233,32 +324,351 @@ update_output_format (void)
     { NULL, MUTEST_OUTPUT_MOCHA },
     { "tap", MUTEST_OUTPUT_TAP },
     { "mocha", MUTEST_OUTPUT_MOCHA },
+    { "json", MUTEST_OUTPUT_JSON },
+    { "junit", MUTEST_OUTPUT_JUNIT },
+    { "binary", MUTEST_OUTPUT_BINARY },
     { "default", MUTEST_OUTPUT_MOCHA },
   };
 
   const size_t n_available_formats =
     sizeof (available_formats) / sizeof (available_formats[0]);
 
+  global_state.output_format = available_formats[0].format;
+  global_state.n_output_sinks = 0;
+
+  // A comma-separated list of formats, each written on the standard
+  // output, or to a file, if followed by a colon and the path of the
+  // file; for instance: "mocha,json:results.json"
   char *env = mutest_getenv ("MUTEST_OUTPUT");
+  char *entry = env;
 
-  if (env == NULL || *env == '\0')
+  while (entry != NULL && *entry != '\0')
     {
-      // Default
-      global_state.output_format = available_formats[0].format;
-      free (env);
-      return;
+      char *next = strchr (entry, ',');
+      if (next != NULL)
+        *next++ = '\0';
+
+      char *path = strchr (entry, ':');
+      if (path != NULL)
+        *path++ = '\0';
+
+      bool found = false;
+
+      for (size_t i = 1; i < n_available_formats; i++)
+        {
+          if (strcmp (entry, available_formats[i].name) == 0)
+            {
+              add_output_sink (entry, available_formats[i].format, path);
+              found = true;
+              break;
+            }
+        }
+
+      if (!found)
+        fprintf (stderr, "WARNING: unknown output format '%s'\n", entry);
+
+      entry = next;
     }
 
-  for (size_t i = 1; i < n_available_formats; i++)
+  // Default, if no format is known
+  if (global_state.n_output_sinks == 0)
+    add_output_sink ("default", available_formats[0].format, NULL);
+
+  free (env);
+}
+
+static void
+update_output_flush (void)
+{
+  char *env = mutest_getenv ("MUTEST_OUTPUT_FLUSH");
+
+  mutest_output_init (env);
+
+  free (env);
+}
+
+static void
+update_output_async (void)
+{
+  char *env = mutest_getenv ("MUTEST_OUTPUT_ASYNC");
+
+  mutest_async_init (env != NULL && *env != '\0' && strcmp (env, "0") != 0);
+
+  free (env);
+}
+
+static void
+update_scheduler (void)
+{
+  static const struct {
+    const char *name;
+    mutest_scheduler_type_t scheduler;
+  } available_schedulers[] = {
+    { "fork", MUTEST_SCHEDULER_FORK },
+    { "threads", MUTEST_SCHEDULER_THREADS },
+    { "serial", MUTEST_SCHEDULER_SERIAL },
+  };
+
+  const size_t n_available_schedulers =
+    sizeof (available_schedulers) / sizeof (available_schedulers[0]);
+
+  global_state.n_jobs = 1;
+  global_state.scheduler = MUTEST_SCHEDULER_SERIAL;
+
+  // The default parallel scheduler uses worker processes
+  mutest_scheduler_type_t scheduler = MUTEST_SCHEDULER_FORK;
+  bool has_scheduler = false;
+
+  char *env = mutest_getenv ("MUTEST_SCHEDULER");
+
+  if (env != NULL && *env != '\0')
     {
-      if (strcmp (env, available_formats[i].name) == 0)
+      for (size_t i = 0; i < n_available_schedulers; i++)
         {
-          global_state.output_format = available_formats[i].format;
-          break;
+          if (strcmp (env, available_schedulers[i].name) == 0)
+            {
+              scheduler = available_schedulers[i].scheduler;
+              has_scheduler = true;
+              break;
+            }
         }
     }
 
   free (env);
+
+  if (scheduler == MUTEST_SCHEDULER_SERIAL)
+    return;
+
+  if (scheduler == MUTEST_SCHEDULER_FORK && !mutest_jobs_available ())
+    return;
+
+  if (scheduler == MUTEST_SCHEDULER_THREADS && !mutest_threads_available ())
+    return;
+
+  env = mutest_getenv ("MUTEST_JOBS");
+
+  // Selecting a parallel scheduler without a number of jobs
+  // uses all the available CPUs
+  if ((env == NULL || *env == '\0') && !has_scheduler)
+    {
+      free (env);
+      return;
+    }
+
+  long n_jobs = 0;
+
+  if (env != NULL && *env != '\0' && strcmp (env, "auto") != 0)
+    {
+      char *end = NULL;
+
+      errno = 0;
+      n_jobs = strtol (env, &end, 10);
+      if (errno != 0 || end == env || *end != '\0' || n_jobs < 0)
+        n_jobs = 1;
+    }
+
+  free (env);
+
+  // A value of 0, or "auto", uses all the available CPUs
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  if (n_jobs == 0)
+    n_jobs = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+  if (n_jobs < 1)
+    n_jobs = 1;
+  else if (n_jobs > 1024)
+    n_jobs = 1024;
+
+  global_state.n_jobs = (int) n_jobs;
+
+  // The thread pool is useful even with a single worker, as it
+  // still runs the specs away from the main thread
+  if (global_state.n_jobs > 1 || scheduler == MUTEST_SCHEDULER_THREADS)
+    global_state.scheduler = scheduler;
+}
+
+static void
+update_isolation (void)
+{
+  global_state.isolate = false;
+
+  char *env = mutest_getenv ("MUTEST_ISOLATE");
+
+  if (env != NULL && *env != '\0' && strcmp (env, "0") != 0)
+    global_state.isolate = true;
+
+  free (env);
+
+  if (!global_state.isolate)
+    return;
+
+  // Isolating specs requires worker processes, even if we
+  // are running one spec at a time
+  if (mutest_jobs_available ())
+    global_state.scheduler = MUTEST_SCHEDULER_FORK;
+  else
+    global_state.isolate = false;
+}
+
+static bool
+parse_shard_value (const char *env_name,
+                   long *value)
+{
+  char *env = mutest_getenv (env_name);
+
+  if (env == NULL || *env == '\0')
+    {
+      free (env);
+      return false;
+    }
+
+  char *end = NULL;
+  errno = 0;
+  *value = strtol (env, &end, 10);
+
+  bool res = errno == 0 && end != env && *end == '\0';
+
+  free (env);
+
+  if (!res)
+    *value = -1;
+
+  return true;
+}
+
+static void
+update_sharding (void)
+{
+  long shard_index = 0, shard_count = 1;
+
+  bool has_index = parse_shard_value ("MUTEST_SHARD_INDEX", &shard_index);
+  bool has_count = parse_shard_value ("MUTEST_SHARD_COUNT", &shard_count);
+
+  if (!has_index && !has_count)
+    return;
+
+  // Running all the specs on every shard would silently multiply the
+  // work, so an invalid configuration is a hard error
+  if (shard_count < 1 || shard_count > INT_MAX ||
+      shard_index < 0 || shard_index >= shard_count)
+    {
+      fprintf (stderr,
+               "ERROR: invalid shard: MUTEST_SHARD_INDEX must be between 0 "
+               "and MUTEST_SHARD_COUNT - 1\n");
+      exit (EXIT_FAILURE);
+    }
+
+  global_state.shard_index = (int) shard_index;
+  global_state.shard_count = (int) shard_count;
+
+  char *env = mutest_getenv ("MUTEST_SHARD_MODE");
+
+  global_state.shard_by_duration = env != NULL && strcmp (env, "duration") == 0;
+
+  free (env);
+}
+
+static void
+update_timeout (void)
+{
+  global_state.default_timeout = 0;
+
+  char *env = mutest_getenv ("MUTEST_TIMEOUT");
+
+  if (env != NULL && *env != '\0')
+    {
+      char *end = NULL;
+      errno = 0;
+      double timeout = strtod (env, &end);
+
+      if (errno == 0 && end != env && *end == '\0' && timeout > 0)
+        global_state.default_timeout = (int64_t) (timeout * 1000000.0);
+    }
+
+  free (env);
+}
+
+static void
+update_bench_time (void)
+{
+  global_state.bench_time = 1000000;
+
+  char *env = mutest_getenv ("MUTEST_BENCH_TIME");
+
+  if (env != NULL && *env != '\0')
+    {
+      char *end = NULL;
+      errno = 0;
+      double bench_time = strtod (env, &end);
+
+      if (errno == 0 && end != env && *end == '\0' && bench_time >= 0)
+        global_state.bench_time = (int64_t) (bench_time * 1000000.0);
+    }
+
+  free (env);
+}
+
+static void
+update_perf_counters (void)
+{
+  char *env = mutest_getenv ("MUTEST_PERF_COUNTERS");
+
+  global_state.perf_counters = env != NULL && *env != '\0' && strcmp (env, "0") != 0;
+
+  free (env);
+}
+
+static void
+update_alloc_stats (void)
+{
+  char *env = mutest_getenv ("MUTEST_ALLOC_STATS");
+
+  global_state.alloc_stats = env != NULL && *env != '\0' && strcmp (env, "0") != 0;
+
+  free (env);
+}
+
+static void
+update_clock (void)
+{
+  char *env = mutest_getenv ("MUTEST_CLOCK");
+
+  mutest_clock_init (env);
+
+  free (env);
+}
+
+static void
+update_fail_fast (void)
+{
+  char *env = mutest_getenv ("MUTEST_FAIL_FAST");
+
+  global_state.fail_fast = env != NULL && *env != '\0' && strcmp (env, "0") != 0;
+
+  free (env);
+}
+
+static void
+update_filters (void)
+{
+  char *env = mutest_getenv ("MUTEST_FILTER");
+
+  if (env != NULL && *env != '\0')
+    mutest_filter_init (env);
+
+  free (env);
+}
+
+static void
+update_timings (void)
+{
+  char *env = mutest_getenv ("MUTEST_TIMINGS");
+
+  if (env != NULL && *env != '\0')
+    mutest_timings_init (env);
+
+  free (env);
 }
 
 void
@@ -273,23 +683,131 @@ mutest_after (mutest_hook_func_t hook)
   global_state.after_hook = hook;
 }
 
+void
+mutest_add_listener (mutest_listener_func_t func,
+                     void *data)
+{
+  if (func == NULL)
+    mutest_assert_if_reached ("invalid listener");
+
+  mutest_listener_t *listeners =
+    realloc (global_state.listeners, (global_state.n_listeners + 1) * sizeof (mutest_listener_t));
+  if (listeners == NULL)
+    mutest_oom_abort ();
+
+  listeners[global_state.n_listeners].func = func;
+  listeners[global_state.n_listeners].data = data;
+
+  global_state.listeners = listeners;
+  global_state.n_listeners += 1;
+
+  // The run already started
+  if (global_state.initialized)
+    {
+      mutest_listener_info_t info;
+
+      memset (&info, 0, sizeof (mutest_listener_info_t));
+
+      func (MUTEST_LISTENER_RUN_START, &info, data);
+    }
+}
+
 void
 mutest_init (void)
 {
   if (mutest_likely (global_state.initialized))
     return;
 
+  mutest_matchers_init ();
+
   update_term_caps ();
   update_term_size ();
   update_output_format ();
-
-  global_state.start_time = mutest_get_current_time ();
+  update_output_flush ();
+  update_output_async ();
+  update_scheduler ();
+  update_isolation ();
+  update_timings ();
+  update_sharding ();
+  update_filters ();
+  update_timeout ();
+  update_fail_fast ();
+  update_bench_time ();
+  update_clock ();
+  update_perf_counters ();
+  update_alloc_stats ();
+
+  global_state.start_time = mutest_get_current_time_ns ();
 
   global_state.initialized = true;
 
   mutest_format_main_preamble ();
 }
 
+void
+mutest_init_with_args (int argc,
+                       char *argv[])
+{
+  mutest_init ();
+
+  bool options = true;
+
+  for (int i = 1; i < argc; i++)
+    {
+      const char *arg = argv[i];
+
+      if (arg == NULL)
+        break;
+
+      if (options && strcmp (arg, "--") == 0)
+        {
+          options = false;
+          continue;
+        }
+
+      if (options && strcmp (arg, "--fail-fast") == 0)
+        {
+          global_state.fail_fast = true;
+          continue;
+        }
+
+      // A mistyped option would otherwise be silently ignored
+      if (options && arg[0] == '-')
+        {
+          fprintf (stderr, "ERROR: unknown option '%s'; use '--' before "
+                           "filters starting with a dash\n",
+                   arg);
+          exit (EXIT_FAILURE);
+        }
+
+      mutest_filter_init (arg);
+    }
+}
+
+// mutest_cancel:
+//
+// Stops running new specs; called from any thread, when the first
+// failure happens in fail-fast mode.
+void
+mutest_cancel (void)
+{
+#if defined(__GNUC__)
+  __atomic_store_n (&global_state.cancelled, 1, __ATOMIC_RELEASE);
+#else
+  global_state.cancelled = 1;
+#endif
+}
+
+bool
+mutest_is_cancelled (void)
+{
+#if defined(__GNUC__)
+  return __atomic_load_n (&global_state.cancelled, __ATOMIC_ACQUIRE) != 0;
+#else
+  return global_state.cancelled != 0;
+#endif
+}
+
 mutest_output_format_t
 mutest_get_output_format (void)
 {
@@ -299,10 +817,23 @@ mutest_get_output_format (void)
 int
 mutest_report (void)
 {
-  global_state.end_time = mutest_get_current_time ();
+  mutest_run_suites ();
+
+  global_state.end_time = mutest_get_current_time_ns ();
+
+  mutest_timings_save ();
 
   mutest_format_total_results (&global_state);
 
+  return mutest_get_exit_status ();
+}
+
+// mutest_get_exit_status:
+//
+// Returns: the exit status of the program for the results so far
+int
+mutest_get_exit_status (void)
+{
   int n_tests, n_skipped, n_failed;
 
   n_tests = mutest_get_results (NULL, &n_failed, &n_skipped);
@@ -154,6 +154,36 @@ mutest_to_be_string (mutest_expect_t *e,
   return false;
 }
 
+static bool
+mutest_to_be_byte_array (mutest_expect_t *e,
+                         mutest_expect_res_t *check)
+{
+  mutest_expect_res_t *value = e->value;
+
+  if (value->expect_type != MUTEST_EXPECT_BYTE_ARRAY ||
+      check->expect_type != MUTEST_EXPECT_BYTE_ARRAY)
+    return false;
+
+  size_t value_size = value->expect.v_bytearray.element_size * value->expect.v_bytearray.length;
+  size_t check_size = check->expect.v_bytearray.element_size * check->expect.v_bytearray.length;
+  size_t common_size = value_size < check_size ? value_size : check_size;
+
+  size_t mismatch = mutest_bytes_mismatch (value->expect.v_bytearray.data,
+                                           check->expect.v_bytearray.data,
+                                           common_size);
+
+  if (mismatch == common_size && value_size == check_size)
+    return true;
+
+  // Both arrays display the bytes around the first difference
+  value->expect.v_bytearray.has_mismatch = true;
+  value->expect.v_bytearray.mismatch = mismatch;
+  check->expect.v_bytearray.has_mismatch = true;
+  check->expect.v_bytearray.mismatch = mismatch;
+
+  return false;
+}
+
 bool
 mutest_to_be (mutest_expect_t *e,
               mutest_expect_res_t *check)
@@ -186,6 +216,15 @@ mutest_to_be (mutest_expect_t *e,
     case MUTEST_EXPECT_STR:
       return mutest_to_be_string (e, check);
 
+    case MUTEST_EXPECT_BYTE_ARRAY:
+      return mutest_to_be_byte_array (e, check);
+
+    case MUTEST_EXPECT_ARRAY:
+      return mutest_array_check (MUTEST_ARRAY_CHECK_EQUAL, e->value, check);
+
+    case MUTEST_EXPECT_CLOSURE:
+      return false;
+
     case MUTEST_EXPECT_INVALID:
       mutest_assert_if_reached ("invalid expect value");
       break;
@@ -460,3 +499,90 @@ mutest_to_end_with_string (mutest_expect_t *e,
 
   return false;
 }
+
+// Calls the closure in @e, the first time, and counts its allocations
+//
+// Returns: true if the allocations were counted
+static bool
+mutest_closure_count_allocs (mutest_expect_t *e,
+                             int64_t *n_allocs)
+{
+  mutest_expect_res_t *value = e->value;
+
+  if (value->expect_type != MUTEST_EXPECT_CLOSURE)
+    return false;
+
+  if (!value->expect.v_closure.called)
+    {
+      mutest_alloc_measure (value->expect.v_closure.func,
+                            value->expect.v_closure.data,
+                            &value->expect.v_closure.alloc);
+      value->expect.v_closure.called = true;
+    }
+
+  if (!value->expect.v_closure.alloc.available)
+    {
+      e->result = MUTEST_RESULT_SKIP;
+      e->skip_reason = "allocations cannot be counted";
+      return false;
+    }
+
+  *n_allocs = value->expect.v_closure.alloc.n_allocs;
+
+  return true;
+}
+
+bool
+mutest_to_allocate_at_most (mutest_expect_t *e,
+                            mutest_expect_res_t *check)
+{
+  int64_t n_allocs;
+
+  if (check->expect_type != MUTEST_EXPECT_INT)
+    return false;
+
+  if (!mutest_closure_count_allocs (e, &n_allocs))
+    return false;
+
+  return n_allocs <= check->expect.v_int.value;
+}
+
+bool
+mutest_to_not_allocate (mutest_expect_t *e,
+                        mutest_expect_res_t *check MUTEST_UNUSED)
+{
+  int64_t n_allocs;
+
+  if (!mutest_closure_count_allocs (e, &n_allocs))
+    return false;
+
+  return n_allocs == 0;
+}
+
+bool
+mutest_to_have_equal_elements (mutest_expect_t *e,
+                               mutest_expect_res_t *check)
+{
+  return mutest_array_check (MUTEST_ARRAY_CHECK_EQUAL, e->value, check);
+}
+
+bool
+mutest_to_have_close_elements (mutest_expect_t *e,
+                               mutest_expect_res_t *check)
+{
+  return mutest_array_check (MUTEST_ARRAY_CHECK_CLOSE, e->value, check);
+}
+
+bool
+mutest_to_have_elements_in_range (mutest_expect_t *e,
+                                  mutest_expect_res_t *check)
+{
+  return mutest_array_check (MUTEST_ARRAY_CHECK_RANGE, e->value, check);
+}
+
+bool
+mutest_to_be_sorted (mutest_expect_t *e,
+                     mutest_expect_res_t *check MUTEST_UNUSED)
+{
+  return mutest_array_check (MUTEST_ARRAY_CHECK_SORTED, e->value, NULL);
+}
@@ -0,0 +1,350 @@
+/* mutest-output.c: Buffered output
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#ifdef OS_WINDOWS
+#include <io.h>
+#endif
+
+// The formatters print each line as a list of fragments, so writing
+// them out as they come would cost a system call for each fragment;
+// instead, they are appended to a buffer, which is written out when it
+// is full, and according to the flush policy:
+//
+//  - "line", after every line; the default when the output is a
+//    terminal, so that progress is visible
+//  - "spec", after the results of every spec; the default otherwise
+//  - "full", only when the buffer is full
+//
+// The buffer is always written out at the end of the run, at exit,
+// and before forking worker processes, which would inherit it. Unless
+// every line is written out as soon as it ends, the buffer is also
+// written out when the process crashes, so that the output leading up
+// to the crash is not lost; otherwise, the signals of the process are
+// left alone.
+//
+// The buffer of the standard streams only holds the output of one
+// file descriptor: writing to another one writes out the buffer first,
+// so that the output on stdout and stderr keeps its order. Lines
+// printed on stderr, which report errors right before aborting, are
+// written out immediately.
+//
+// Output formats can also be written to files, opened by
+// mutest_output_open(), each with its own buffer; while a file is
+// selected with mutest_output_select(), what the formatters print on
+// stdout is appended to the buffer of the file instead. Files are not
+// flushed after every line, as nobody watches their progress.
+//
+// The formatters only run on one thread at a time, so the buffers are
+// not locked; nothing is allocated either, as mutest_assert_message()
+// prints through the buffer when running out of memory.
+#define OUTPUT_BUFFER_SIZE      (64 * 1024)
+
+// The standard streams, and a file for each output format
+#define OUTPUT_MAX_BUFFERS      (MUTEST_OUTPUT_N_FORMATS + 1)
+
+typedef enum {
+  OUTPUT_FLUSH_LINE,
+  OUTPUT_FLUSH_SPEC,
+  OUTPUT_FLUSH_FULL
+} output_flush_t;
+
+typedef struct {
+  // The file descriptor of the buffered data, or -1
+  int fd;
+
+  size_t len;
+  char *data;
+} output_buffer_t;
+
+static char std_data[OUTPUT_BUFFER_SIZE];
+
+static struct {
+  output_flush_t flush;
+
+  // The standard streams first, then the files
+  output_buffer_t buffers[OUTPUT_MAX_BUFFERS];
+  int n_buffers;
+
+  // The buffer receiving the output on stdout
+  int selected;
+} output = {
+  .flush = OUTPUT_FLUSH_LINE,
+  .buffers = {
+    { .fd = -1, .len = 0, .data = std_data, },
+  },
+  .n_buffers = 1,
+  .selected = 0,
+};
+
+static void
+write_all (int fd,
+           const char *data,
+           size_t len)
+{
+  while (len > 0)
+    {
+#ifdef OS_WINDOWS
+      int res = _write (fd, data, (unsigned int) len);
+#else
+      ssize_t res = write (fd, data, len);
+#endif
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          perror ("write");
+          abort ();
+        }
+
+      data += res;
+      len -= (size_t) res;
+    }
+}
+
+static void
+output_buffer_flush (output_buffer_t *buffer)
+{
+  if (buffer->len == 0)
+    return;
+
+  // Reset the buffer first, in case writing it aborts
+  size_t len = buffer->len;
+
+  buffer->len = 0;
+
+  write_all (buffer->fd, buffer->data, len);
+}
+
+// mutest_output_flush:
+//
+// Writes out the buffered output.
+void
+mutest_output_flush (void)
+{
+  for (int i = 0; i < output.n_buffers; i++)
+    output_buffer_flush (&output.buffers[i]);
+}
+
+// mutest_output_sync:
+//
+// Waits for the asynchronous output, if any, and writes out the
+// buffered output.
+void
+mutest_output_sync (void)
+{
+  mutest_async_sync ();
+  mutest_output_flush ();
+}
+
+// mutest_output_open:
+// @path: the path of the file
+//
+// Creates a file for the output of a format.
+//
+// Returns: the output to pass to mutest_output_select(), or -1 if the
+//   file could not be created, setting errno
+int
+mutest_output_open (const char *path)
+{
+  if (output.n_buffers == OUTPUT_MAX_BUFFERS)
+    mutest_assert_if_reached ("too many outputs");
+
+  // The file is never closed; it's written out at exit
+  FILE *file = fopen (path, "wb");
+  if (file == NULL)
+    return -1;
+
+  char *data = malloc (OUTPUT_BUFFER_SIZE);
+  if (data == NULL)
+    mutest_oom_abort ();
+
+  // Files are only written out after each spec
+  mutest_output_catch_crashes ();
+
+  output_buffer_t *buffer = &output.buffers[output.n_buffers];
+
+  buffer->fd = fileno (file);
+  buffer->len = 0;
+  buffer->data = data;
+
+  return output.n_buffers++;
+}
+
+// mutest_output_select:
+// @selected: an output returned by mutest_output_open(), or 0 for
+//   the standard streams
+//
+// Redirects the output on stdout to @selected.
+void
+mutest_output_select (int selected)
+{
+  output.selected = selected;
+}
+
+// mutest_output_is_redirected:
+//
+// Returns: whether the output on stdout is redirected to a file
+bool
+mutest_output_is_redirected (void)
+{
+  return output.selected != 0;
+}
+
+// mutest_output_write:
+// @stream: the stream to write to
+// @data: the data to write
+// @len: the length of @data
+//
+// Appends @data to the output buffer.
+void
+mutest_output_write (FILE *stream,
+                     const char *data,
+                     size_t len)
+{
+  output_buffer_t *buffer = &output.buffers[0];
+  int fd;
+
+  if (stream == stdout && output.selected != 0)
+    {
+      buffer = &output.buffers[output.selected];
+      fd = buffer->fd;
+    }
+  else
+    fd = fileno (stream);
+
+  if (fd != buffer->fd)
+    {
+      output_buffer_flush (buffer);
+      buffer->fd = fd;
+    }
+
+  if (OUTPUT_BUFFER_SIZE - buffer->len < len)
+    {
+      output_buffer_flush (buffer);
+
+      if (len > OUTPUT_BUFFER_SIZE)
+        {
+          write_all (fd, data, len);
+          return;
+        }
+    }
+
+  memcpy (buffer->data + buffer->len, data, len);
+  buffer->len += len;
+}
+
+// mutest_output_end_line:
+// @stream: the stream of the line
+//
+// Applies the flush policy at the end of a line.
+void
+mutest_output_end_line (FILE *stream)
+{
+  if (stream == stderr ||
+      (output.flush == OUTPUT_FLUSH_LINE && output.selected == 0))
+    output_buffer_flush (&output.buffers[0]);
+}
+
+// mutest_output_end_spec:
+//
+// Applies the flush policy after the results of a spec.
+void
+mutest_output_end_spec (void)
+{
+  if (output.flush != OUTPUT_FLUSH_FULL)
+    mutest_output_flush ();
+}
+
+static void
+output_flush_at_exit (void)
+{
+  mutest_output_sync ();
+}
+
+static void
+output_crash_handler (int sig)
+{
+  // Only write() is called, which is safe inside a signal handler;
+  // if the output thread does not catch up, the buffer may be in use
+  if (mutest_async_try_sync ())
+    mutest_output_flush ();
+
+  // The handler is reset to the default action, so the
+  // signal will terminate the process once we return
+  raise (sig);
+}
+
+// mutest_output_catch_crashes:
+//
+// Writes out the buffered output if the process crashes; needed when
+// the output is not written out as soon as it's printed.
+void
+mutest_output_catch_crashes (void)
+{
+  static bool installed;
+
+  if (installed)
+    return;
+
+  installed = true;
+
+  mutest_install_crash_handler (output_crash_handler);
+}
+
+// mutest_output_init:
+// @flush: (nullable): the flush policy
+//
+// Sets the flush policy; if @flush is unset, or unknown, the policy
+// depends on whether the output is a terminal.
+void
+mutest_output_init (const char *flush)
+{
+  static const struct {
+    const char *name;
+    output_flush_t flush;
+  } flush_policies[] = {
+    { "line", OUTPUT_FLUSH_LINE },
+    { "spec", OUTPUT_FLUSH_SPEC },
+    { "full", OUTPUT_FLUSH_FULL },
+  };
+
+  const size_t n_flush_policies = sizeof (flush_policies) / sizeof (flush_policies[0]);
+
+  output.flush = mutest_is_term_tty () ? OUTPUT_FLUSH_LINE : OUTPUT_FLUSH_SPEC;
+
+  for (size_t i = 0; flush != NULL && i < n_flush_policies; i++)
+    {
+      if (strcmp (flush, flush_policies[i].name) == 0)
+        {
+          output.flush = flush_policies[i].flush;
+          break;
+        }
+    }
+
+  atexit (output_flush_at_exit);
+
+  // Lines are written out as soon as they end
+  if (output.flush != OUTPUT_FLUSH_LINE)
+    mutest_output_catch_crashes ();
+}
@@ -0,0 +1,348 @@
+/* mutest-perf.c: Hardware performance counters
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(HAVE_SYS_SYSCALL_H) && defined(HAVE_SYS_IOCTL_H)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define MUTEST_HAVE_PERF 1
+#endif
+
+static const char *counter_names[MUTEST_PERF_N_COUNTERS] = {
+  [MUTEST_PERF_CYCLES] = "cycles",
+  [MUTEST_PERF_INSTRUCTIONS] = "instructions",
+  [MUTEST_PERF_BRANCH_MISSES] = "branch misses",
+  [MUTEST_PERF_L1D_MISSES] = "L1d misses",
+  [MUTEST_PERF_LLC_MISSES] = "LLC misses",
+};
+
+#ifdef MUTEST_HAVE_PERF
+
+// The counters are opened as a single group, so that they are scheduled
+// on the PMU together, for the thread that runs the specs; the group is
+// opened once per thread, and once per worker process, as counters are
+// not inherited across fork().
+//
+// If the kernel has to multiplex the group with other events, the
+// values are scaled by the fraction of the time the group was running.
+//
+// Counters that the CPU does not support are left out of the group, and
+// reported as unavailable; if the cycles counter, which leads the group,
+// cannot be opened, then no counter is available.
+typedef struct {
+  pid_t pid;
+
+  // The errno of the failure to open the group leader, or 0
+  int error;
+
+  int fds[MUTEST_PERF_N_COUNTERS];
+
+  // The position of each counter inside the group, or -1
+  int index[MUTEST_PERF_N_COUNTERS];
+  int n_open;
+} perf_group_t;
+
+static MUTEST_THREAD_LOCAL perf_group_t perf_group;
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} counter_events[MUTEST_PERF_N_COUNTERS] = {
+  [MUTEST_PERF_CYCLES] = {
+    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+  },
+  [MUTEST_PERF_INSTRUCTIONS] = {
+    PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+  },
+  [MUTEST_PERF_BRANCH_MISSES] = {
+    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+  },
+  [MUTEST_PERF_L1D_MISSES] = {
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D
+      | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+  },
+  [MUTEST_PERF_LLC_MISSES] = {
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_LL
+      | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+  },
+};
+
+static int
+perf_event_open (struct perf_event_attr *attr,
+                 int group_fd)
+{
+  // Count the calling thread, on any CPU
+  return (int) syscall (SYS_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+static void
+perf_group_close (void)
+{
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    {
+      if (perf_group.fds[i] >= 0)
+        close (perf_group.fds[i]);
+    }
+}
+
+static void
+perf_group_open (void)
+{
+  pid_t pid = getpid ();
+
+  if (mutest_likely (perf_group.pid == pid))
+    return;
+
+  // Inherited from the parent process; these count the parent
+  if (perf_group.pid != 0)
+    perf_group_close ();
+
+  perf_group.pid = pid;
+  perf_group.error = 0;
+  perf_group.n_open = 0;
+
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    {
+      perf_group.fds[i] = -1;
+      perf_group.index[i] = -1;
+    }
+
+  int leader = -1;
+
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    {
+      struct perf_event_attr attr;
+
+      memset (&attr, 0, sizeof (attr));
+      attr.size = sizeof (attr);
+      attr.type = counter_events[i].type;
+      attr.config = counter_events[i].config;
+      attr.disabled = leader < 0 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP
+                       | PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      int fd = perf_event_open (&attr, leader);
+
+      if (fd < 0)
+        {
+          if (leader < 0)
+            {
+              perf_group.error = errno;
+              return;
+            }
+
+          continue;
+        }
+
+      if (leader < 0)
+        leader = fd;
+
+      perf_group.fds[i] = fd;
+      perf_group.index[i] = perf_group.n_open;
+      perf_group.n_open += 1;
+    }
+}
+
+static void
+perf_group_read (uint64_t *values)
+{
+  // nr, time_enabled, time_running, and a value for each counter
+  uint64_t data[3 + MUTEST_PERF_N_COUNTERS];
+  int leader = perf_group.fds[MUTEST_PERF_CYCLES];
+
+  ssize_t len = read (leader, data, sizeof (data));
+
+  if (len < (ssize_t) (3 * sizeof (uint64_t)) || data[2] == 0)
+    {
+      memset (values, 0, sizeof (uint64_t) * MUTEST_PERF_N_COUNTERS);
+      return;
+    }
+
+  double scale = (double) data[1] / (double) data[2];
+
+  for (int i = 0; i < perf_group.n_open && i < (int) data[0]; i++)
+    values[i] = (uint64_t) ((double) data[3 + i] * scale);
+}
+
+// mutest_perf_start:
+// @spec: the spec about to be run
+//
+// Starts counting for @spec, if the counters are enabled.
+void
+mutest_perf_start (mutest_spec_t *spec)
+{
+  if (!mutest_get_global_state ()->perf_counters)
+    return;
+
+  perf_group_open ();
+
+  spec->perf.error = perf_group.error;
+
+  if (perf_group.error != 0)
+    return;
+
+  int leader = perf_group.fds[MUTEST_PERF_CYCLES];
+
+  ioctl (leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl (leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// mutest_perf_stop:
+// @spec: the spec that was run
+//
+// Stops counting for @spec, and stores the counters.
+void
+mutest_perf_stop (mutest_spec_t *spec)
+{
+  if (!mutest_get_global_state ()->perf_counters)
+    return;
+
+  spec->perf.enabled = true;
+
+  if (perf_group.error != 0)
+    return;
+
+  int leader = perf_group.fds[MUTEST_PERF_CYCLES];
+
+  ioctl (leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  uint64_t values[MUTEST_PERF_N_COUNTERS];
+
+  perf_group_read (values);
+
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS; i++)
+    {
+      int index = perf_group.index[i];
+
+      spec->perf.values[i] = index >= 0 ? (int64_t) values[index] : -1;
+    }
+}
+
+#else /* MUTEST_HAVE_PERF */
+
+void
+mutest_perf_start (mutest_spec_t *spec)
+{
+  if (!mutest_get_global_state ()->perf_counters)
+    return;
+
+  spec->perf.error = ENOSYS;
+}
+
+void
+mutest_perf_stop (mutest_spec_t *spec)
+{
+  if (!mutest_get_global_state ()->perf_counters)
+    return;
+
+  spec->perf.enabled = true;
+}
+
+#endif /* MUTEST_HAVE_PERF */
+
+// Formats @value with a metric suffix
+static void
+format_count (int64_t value,
+              char *buf,
+              size_t len)
+{
+  if (value >= 10000000000)
+    snprintf (buf, len, "%.2fG", (double) value / 1000000000.0);
+  else if (value >= 10000000)
+    snprintf (buf, len, "%.2fM", (double) value / 1000000.0);
+  else if (value >= 10000)
+    snprintf (buf, len, "%.2fk", (double) value / 1000.0);
+  else
+    snprintf (buf, len, "%lld", (long long) value);
+}
+
+static const char *
+error_reason (int error)
+{
+  switch (error)
+    {
+    case ENOSYS:
+      return "not supported on this platform";
+
+    // Typically, virtual machines and containers without a PMU
+    case ENOENT:
+    case ENODEV:
+    case EOPNOTSUPP:
+      return "no hardware counters";
+
+    case EACCES:
+    case EPERM:
+      return "not permitted; check kernel.perf_event_paranoid";
+
+    default:
+      return strerror (error);
+    }
+}
+
+// mutest_format_perf_counters:
+// @perf: the counters of a spec
+// @buf: the buffer to write to
+// @len: the size of @buf
+//
+// Formats the counters of a spec for display; the counters that were
+// not available are left out, and if none was available, the reason
+// is displayed instead.
+void
+mutest_format_perf_counters (const mutest_perf_counters_t *perf,
+                             char *buf,
+                             size_t len)
+{
+  if (perf->error != 0)
+    {
+      snprintf (buf, len, "unavailable (%s)", error_reason (perf->error));
+      return;
+    }
+
+  size_t pos = 0;
+
+  buf[0] = '\0';
+
+  for (int i = 0; i < MUTEST_PERF_N_COUNTERS && pos < len; i++)
+    {
+      if (perf->values[i] < 0)
+        continue;
+
+      char count[32];
+
+      format_count (perf->values[i], count, sizeof (count));
+
+      int res = snprintf (buf + pos, len - pos, "%s%s %s",
+                          pos > 0 ? ", " : "",
+                          count,
+                          counter_names[i]);
+      if (res < 0)
+        break;
+
+      pos += (size_t) res;
+    }
+
+  if (pos == 0)
+    snprintf (buf, len, "unavailable");
+}
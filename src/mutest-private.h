@@ -34,9 +34,29 @@ typedef enum {
   MUTEST_EXPECT_FLOAT,
   MUTEST_EXPECT_FLOAT_RANGE,
   MUTEST_EXPECT_STR,
-  MUTEST_EXPECT_POINTER
+  MUTEST_EXPECT_POINTER,
+  MUTEST_EXPECT_CLOSURE,
+  MUTEST_EXPECT_BYTE_ARRAY,
+  MUTEST_EXPECT_ARRAY
 } mutest_expect_type_t;
 
+typedef enum {
+  MUTEST_ARRAY_INT32,
+  MUTEST_ARRAY_INT64,
+  MUTEST_ARRAY_FLOAT,
+  MUTEST_ARRAY_DOUBLE
+} mutest_array_type_t;
+
+typedef enum {
+  MUTEST_ARRAY_CHECK_EQUAL,
+  MUTEST_ARRAY_CHECK_CLOSE,
+  MUTEST_ARRAY_CHECK_RANGE,
+  MUTEST_ARRAY_CHECK_SORTED
+} mutest_array_check_t;
+
+/* The number of mismatching elements reported by the array matchers */
+#define MUTEST_ARRAY_REPORTED_MISMATCHES        8
+
 typedef enum {
   MUTEST_COLLECT_NONE = 0,
   MUTEST_COLLECT_INT = 1 << 0,
@@ -58,9 +78,85 @@ typedef enum {
 
 typedef enum {
   MUTEST_OUTPUT_MOCHA,
-  MUTEST_OUTPUT_TAP
+  MUTEST_OUTPUT_TAP,
+  MUTEST_OUTPUT_JSON,
+  MUTEST_OUTPUT_JUNIT,
+  MUTEST_OUTPUT_BINARY,
+
+  MUTEST_OUTPUT_N_FORMATS
 } mutest_output_format_t;
 
+typedef struct {
+  mutest_output_format_t format;
+
+  /* The output of the format; see mutest_output_open() */
+  int output;
+} mutest_output_sink_t;
+
+typedef struct {
+  mutest_listener_func_t func;
+  void *data;
+} mutest_listener_t;
+
+typedef enum {
+  MUTEST_SCHEDULER_SERIAL,
+  MUTEST_SCHEDULER_FORK,
+  MUTEST_SCHEDULER_THREADS
+} mutest_scheduler_type_t;
+
+typedef enum {
+  MUTEST_EVENT_EXPECT_RESULT = 1,
+  MUTEST_EVENT_EXPECT_FAIL,
+  MUTEST_EVENT_SPEC_RESULTS,
+  MUTEST_EVENT_SPEC_ABORT,
+  MUTEST_EVENT_SPEC_PREAMBLE,
+  MUTEST_EVENT_SUITE_PREAMBLE,
+  MUTEST_EVENT_SUITE_RESULTS
+} mutest_event_type_t;
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t size;
+  bool is_static;
+  bool truncated;
+} mutest_event_buffer_t;
+
+typedef enum {
+  MUTEST_BINARY_STRING = 1,
+  MUTEST_BINARY_START,
+  MUTEST_BINARY_SUITE,
+  MUTEST_BINARY_SPEC,
+  MUTEST_BINARY_EXPECT,
+  MUTEST_BINARY_EXPECT_FAIL,
+  MUTEST_BINARY_SPEC_RESULTS,
+  MUTEST_BINARY_SUITE_RESULTS,
+  MUTEST_BINARY_RESULTS
+} mutest_binary_record_type_t;
+
+/* Large enough for a spec abort record */
+#define MUTEST_EVENT_ABORT_SIZE 2048
+
+typedef struct {
+  /* Whether the spec results were found */
+  bool has_results;
+
+  /* Whether the spec was aborted by mutest_assert_message() */
+  bool aborted;
+
+  /* The results of the replayed expectations */
+  int pass;
+  int fail;
+  int skip;
+
+  /* The location of the abort, or of the last expectation */
+  const char *file;
+  int line;
+  const char *func_name;
+
+  const char *message;
+} mutest_replay_info_t;
+
 typedef struct {
   bool initialized;
 
@@ -70,20 +166,69 @@ typedef struct {
   bool is_tty;
   bool use_colors;
 
-  mutest_suite_t *current_suite;
-  mutest_spec_t *current_spec;
-
   int n_suites;
   int total_tests;
   int total_pass;
   int total_fail;
   int total_skip;
 
+  /* The specs that did not match the filters */
+  int total_filtered;
+
+  /* The monotonic time, in nanoseconds */
   int64_t start_time;
   int64_t end_time;
 
+  /* The format written on the standard output */
   mutest_output_format_t output_format;
 
+  /* The formats to write, each at most once, and their outputs */
+  mutest_output_sink_t output_sinks[MUTEST_OUTPUT_N_FORMATS];
+  int n_output_sinks;
+
+  /* The listeners added by mutest_add_listener() */
+  mutest_listener_t *listeners;
+  int n_listeners;
+
+  /* The maximum number of specs running in parallel */
+  int n_jobs;
+
+  /* Whether each spec runs in a separate process */
+  bool isolate;
+
+  /* The default timeout of each spec, in microseconds; 0 for none */
+  int64_t default_timeout;
+
+  /* The target measurement time of each benchmark, in microseconds;
+   * 0 to only run the benchmarks once, as plain specs
+   */
+  int64_t bench_time;
+
+  /* Whether to stop at the first failure */
+  bool fail_fast;
+
+  /* Whether to collect hardware counters for each spec */
+  bool perf_counters;
+
+  /* Whether to report the allocations of each spec */
+  bool alloc_stats;
+
+  /* Set when no more specs should be run; use mutest_cancel() and
+   * mutest_is_cancelled(), as it's shared between threads
+   */
+  int cancelled;
+
+  mutest_scheduler_type_t scheduler;
+
+  /* The shard of the specs to run, out of shard_count */
+  int shard_index;
+  int shard_count;
+  bool shard_by_duration;
+
+  /* The suites collected by mutest_describe() */
+  mutest_suite_t *first_suite;
+  mutest_suite_t *last_suite;
+
   mutest_hook_func_t before_hook;
   mutest_hook_func_t after_hook;
 } mutest_state_t;
@@ -102,6 +247,43 @@ typedef struct {
   void (* total_results) (mutest_state_t *state);
 } mutest_formatter_t;
 
+typedef struct {
+  const char *name;
+
+  /* Calls the before() hook of a suite */
+  void (* setup_suite) (mutest_suite_t *suite);
+
+  /* Runs all the specs of a suite, and adds their results to it */
+  void (* run_specs) (mutest_suite_t *suite);
+
+  /* Calls the after() hook of a suite */
+  void (* teardown_suite) (mutest_suite_t *suite);
+} mutest_scheduler_t;
+
+typedef struct {
+  /* Whether the allocator could be tracked */
+  bool available;
+
+  /* The calls to malloc(), calloc(), and realloc() */
+  int64_t n_allocs;
+
+  /* The calls to free(), and to realloc() with a size of 0 */
+  int64_t n_frees;
+
+  /* The bytes requested by the allocations */
+  int64_t n_bytes;
+} mutest_alloc_stats_t;
+
+typedef struct {
+  size_t index;
+
+  /* The element, depending on the type of the array */
+  union {
+    int64_t v_int;
+    double v_float;
+  } value;
+} mutest_array_mismatch_t;
+
 typedef mutest_expect_res_t *(* mutest_collect_func_t) (mutest_expect_type_t expect_type,
                                                         mutest_collect_type_t collect_type,
                                                         va_list *args);
@@ -139,6 +321,54 @@ struct _mutest_expect_res_t
     } v_str;
 
     void *v_pointer;
+
+    struct {
+      mutest_expect_closure_func_t func;
+      void *data;
+
+      /* Set once the closure was called by a matcher */
+      bool called;
+      mutest_alloc_stats_t alloc;
+    } v_closure;
+
+    struct {
+      uint8_t *data;
+      size_t element_size;
+      size_t length;
+
+      /* The bytes of the array stored in data; the arrays replayed
+       * from a worker only contain the bytes that are displayed
+       */
+      size_t data_offset;
+      size_t data_size;
+
+      /* The offset of the first different byte, set by the matchers
+       * comparing two arrays
+       */
+      bool has_mismatch;
+      size_t mismatch;
+    } v_bytearray;
+
+    struct {
+      /* Not owned, and NULL in the arrays replayed from a worker */
+      const void *data;
+      mutest_array_type_t array_type;
+      size_t length;
+
+      /* The tolerances collected by mutest_to_have_close_elements() */
+      double abs_tolerance;
+      double rel_tolerance;
+      int max_ulps;
+
+      /* Set by the matchers checking the elements; the reported
+       * mismatches are allocated from the arena, and stored as bytes,
+       * as the ones replayed from a worker are not aligned
+       */
+      bool checked;
+      size_t n_mismatches;
+      size_t n_reported;
+      uint8_t *reported;
+    } v_array;
   } expect;
 };
 
@@ -155,8 +385,46 @@ struct _mutest_expect_t
   mutest_expect_res_t *value;
 
   mutest_result_t result;
+
+  /* The diagnostic of a failed expectation read from a results log,
+   * in place of its value
+   */
+  const char *diagnostic;
 };
 
+typedef enum {
+  MUTEST_PERF_CYCLES,
+  MUTEST_PERF_INSTRUCTIONS,
+  MUTEST_PERF_BRANCH_MISSES,
+  MUTEST_PERF_L1D_MISSES,
+  MUTEST_PERF_LLC_MISSES,
+
+  MUTEST_PERF_N_COUNTERS
+} mutest_perf_counter_t;
+
+typedef struct {
+  /* Whether the counters were collected */
+  bool enabled;
+
+  /* The reason the counters are not available, or 0 */
+  int error;
+
+  /* The value of each counter, or -1 if not available */
+  int64_t values[MUTEST_PERF_N_COUNTERS];
+} mutest_perf_counters_t;
+
+typedef struct {
+  /* The number of calls in each sample */
+  int64_t iterations;
+  int n_samples;
+
+  /* The time of each call, in nanoseconds */
+  double median;
+  double mad;
+  double ci_low;
+  double ci_high;
+} mutest_bench_results_t;
+
 struct _mutest_spec_t
 {
   const char *file;
@@ -165,16 +433,39 @@ struct _mutest_spec_t
 
   const char *description;
 
+  mutest_spec_func_t func;
+
+  mutest_spec_t *next;
+
   int n_expects;
   int pass;
   int fail;
   int skip;
 
+  /* The time of the spec clock, in nanoseconds */
   int64_t start_time;
   int64_t end_time;
 
+  /* The hardware counters, with MUTEST_PERF_COUNTERS */
+  mutest_perf_counters_t perf;
+
+  /* The allocations made by the spec function */
+  mutest_alloc_stats_t alloc;
+
+  /* The timeout, in microseconds; 0 for the default one */
+  int64_t timeout;
+
   bool skip_all;
   const char *skip_reason;
+
+  /* Set for specs defined by mutest_bench() */
+  bool is_bench;
+
+  /* Set while the benchmark is measured; expectations are not reported */
+  bool bench_running;
+
+  /* Valid if n_samples is not zero */
+  mutest_bench_results_t bench;
 };
 
 struct _mutest_suite_t
@@ -185,9 +476,20 @@ struct _mutest_suite_t
 
   const char *description;
 
+  mutest_describe_func_t func;
+
+  mutest_spec_t *first_spec;
+  mutest_spec_t *last_spec;
+
+  mutest_suite_t *next;
+
+  /* The monotonic time, in nanoseconds */
   int64_t start_time;
   int64_t end_time;
 
+  mutest_hook_func_t before_hook;
+  mutest_hook_func_t after_hook;
+
   mutest_hook_func_t before_each_hook;
   mutest_hook_func_t after_each_hook;
 
@@ -200,6 +502,51 @@ struct _mutest_suite_t
   const char *skip_reason;
 };
 
+typedef struct {
+  mutest_binary_record_type_t type;
+
+  /* The offset of the record in the log */
+  size_t offset;
+
+  /* MUTEST_BINARY_SUITE, MUTEST_BINARY_SUITE_RESULTS */
+  mutest_suite_t suite;
+
+  /* MUTEST_BINARY_SPEC, MUTEST_BINARY_SPEC_RESULTS */
+  mutest_spec_t spec;
+
+  /* MUTEST_BINARY_EXPECT, MUTEST_BINARY_EXPECT_FAIL */
+  mutest_expect_t expect;
+
+  /* MUTEST_BINARY_START */
+  int shard_index;
+  int shard_count;
+
+  /* MUTEST_BINARY_RESULTS */
+  int pass;
+  int fail;
+  int skip;
+  int filtered;
+  int64_t duration;
+  bool cancelled;
+} mutest_binary_record_t;
+
+typedef struct {
+  const char *data;
+  size_t len;
+  size_t pos;
+
+  /* The interned strings, pointing into the data */
+  const char **strings;
+  size_t n_strings;
+  size_t size_strings;
+
+  bool error;
+  bool truncated;
+
+  /* Set if a spec had allocation statistics */
+  bool has_alloc_stats;
+} mutest_binary_reader_t;
+
 #define mutest_oom_abort() \
   mutest_assert_message (__FILE__, __LINE__, __func__, "out-of-memory")
 
@@ -209,6 +556,14 @@ struct _mutest_suite_t
 #define mutest_assert(x) \
   mutest_assert_message (__FILE__, __LINE__, __func__, #x)
 
+#if defined(_MSC_VER)
+# define MUTEST_THREAD_LOCAL    __declspec(thread)
+#elif defined(__GNUC__)
+# define MUTEST_THREAD_LOCAL    __thread
+#else
+# define MUTEST_THREAD_LOCAL    _Thread_local
+#endif
+
 #if defined(__GNUC__) && __GNUC__ > 3
 # define mutest_likely(x)       (__builtin_expect((x) ? 1 : 0, 1))
 # define mutest_unlikely(x)     (__builtin_expect((x) ? 1 : 0, 0))
@@ -237,6 +592,47 @@ mutest_expect_res_alloc (mutest_expect_type_t type);
 void
 mutest_expect_res_free (mutest_expect_res_t *res);
 
+void
+mutest_matchers_init (void);
+
+size_t
+mutest_bytes_mismatch (const void *a,
+                       const void *b,
+                       size_t len);
+
+void
+mutest_byte_array_get_window (const mutest_expect_res_t *res,
+                              size_t *start,
+                              size_t *end);
+
+void
+mutest_format_byte_array (const mutest_expect_res_t *res,
+                          char *buf,
+                          size_t len);
+
+bool
+mutest_array_check (mutest_array_check_t check_type,
+                    mutest_expect_res_t *value,
+                    mutest_expect_res_t *check);
+
+void
+mutest_format_array (const mutest_expect_res_t *res,
+                     char *buf,
+                     size_t len);
+
+void
+mutest_expect_res_set_string (mutest_expect_res_t *res,
+                              const char *str);
+
+void *
+mutest_arena_alloc (size_t size);
+
+void
+mutest_arena_free (void *data);
+
+void
+mutest_arena_reset (void);
+
 char *
 mutest_strdup (const char *str);
 
@@ -251,11 +647,67 @@ mutest_strdup_and_len (const char *str,
 char *
 mutest_getenv (const char *env_name);
 
+void
+mutest_install_crash_handler (void (* handler) (int sig));
+
+#define MUTEST_HASH_INIT        UINT64_C (0xcbf29ce484222325)
+
+uint64_t
+mutest_hash_string (uint64_t hash,
+                    const char *str);
+
 void
 mutest_print (FILE *stram,
               const char *first_fragment,
               ...) MUTEST_NULL_TERMINATED;
 
+void
+mutest_output_init (const char *flush);
+
+void
+mutest_output_catch_crashes (void);
+
+int
+mutest_output_open (const char *path);
+
+void
+mutest_output_select (int selected);
+
+bool
+mutest_output_is_redirected (void);
+
+void
+mutest_output_write (FILE *stream,
+                     const char *data,
+                     size_t len);
+
+void
+mutest_output_end_line (FILE *stream);
+
+void
+mutest_output_end_spec (void);
+
+void
+mutest_output_flush (void);
+
+void
+mutest_output_sync (void);
+
+void
+mutest_async_init (bool enabled);
+
+mutest_event_buffer_t *
+mutest_async_get_queue (void);
+
+void
+mutest_async_push (mutest_event_buffer_t *buffer);
+
+void
+mutest_async_sync (void);
+
+bool
+mutest_async_try_sync (void);
+
 void
 mutest_assert_message (const char *file,
                        int line,
@@ -280,6 +732,12 @@ mutest_use_colors (void);
 mutest_output_format_t
 mutest_get_output_format (void);
 
+void
+mutest_cancel (void);
+
+bool
+mutest_is_cancelled (void);
+
 void
 mutest_set_current_suite (mutest_suite_t *suite);
 
@@ -292,13 +750,36 @@ mutest_set_current_spec (mutest_spec_t *spec);
 mutest_spec_t *
 mutest_get_current_spec (void);
 
+void
+mutest_set_recorder (mutest_event_buffer_t *recorder);
+
+mutest_event_buffer_t *
+mutest_get_recorder (void);
+
 int64_t
 mutest_get_current_time (void);
 
+int64_t
+mutest_get_current_time_ns (void);
+
+void
+mutest_clock_init (const char *name);
+
+int64_t
+mutest_clock_get_time (void);
+
+bool
+mutest_clock_is_wall_time (void);
+
 double
 mutest_format_time (int64_t t,
                     const char **unit);
 
+void
+mutest_format_bench_results (const mutest_bench_results_t *bench,
+                             char *buf,
+                             size_t len);
+
 char *
 mutest_format_string_for_display (const char *str,
                                   char indent_ch,
@@ -321,18 +802,138 @@ void
 mutest_spec_add_expect_result (mutest_spec_t *spec,
                                mutest_expect_t *expect);
 
+void
+mutest_spec_run (mutest_suite_t *suite,
+                 mutest_spec_t *spec);
+
+void
+mutest_bench_run (mutest_spec_t *spec);
+
+void
+mutest_perf_start (mutest_spec_t *spec);
+
+void
+mutest_perf_stop (mutest_spec_t *spec);
+
+void
+mutest_format_perf_counters (const mutest_perf_counters_t *perf,
+                             char *buf,
+                             size_t len);
+
+void
+mutest_alloc_start (void);
+
+void
+mutest_alloc_stop (mutest_alloc_stats_t *stats);
+
+void
+mutest_alloc_suspend (void);
+
+void
+mutest_alloc_resume (void);
+
+void
+mutest_alloc_measure (mutest_expect_closure_func_t func,
+                      void *data,
+                      mutest_alloc_stats_t *stats);
+
+void
+mutest_format_alloc_stats (const mutest_alloc_stats_t *stats,
+                           char *buf,
+                           size_t len);
+
+int64_t
+mutest_spec_get_timeout (const mutest_spec_t *spec);
+
+void
+mutest_watchdog_start (int slot,
+                       mutest_suite_t *suite,
+                       mutest_spec_t *spec);
+
+void
+mutest_watchdog_stop (int slot,
+                      mutest_spec_t *spec);
+
+void
+mutest_spec_before (mutest_suite_t *suite,
+                    mutest_spec_t *spec);
+
+void
+mutest_spec_exec (mutest_spec_t *spec);
+
+void
+mutest_spec_after (mutest_suite_t *suite,
+                   mutest_spec_t *spec);
+
 void
 mutest_suite_add_spec_results (mutest_suite_t *suite,
                                mutest_spec_t *spec);
 
+void
+mutest_suite_run (mutest_suite_t *suite);
+
+void
+mutest_spec_free (mutest_spec_t *spec);
+
+void
+mutest_suite_free (mutest_suite_t *suite);
+
 void
 mutest_add_suite_results (mutest_suite_t *suite);
 
+const mutest_scheduler_t *
+mutest_get_scheduler (void);
+
+void
+mutest_run_suites (void);
+
+typedef bool (* mutest_spec_filter_func_t) (mutest_suite_t *suite,
+                                            mutest_spec_t *spec,
+                                            void *data);
+
+size_t
+mutest_prune_specs (mutest_spec_filter_func_t func,
+                    void *data,
+                    bool keep_empty);
+
+void
+mutest_shard_suites (void);
+
+void
+mutest_filter_init (const char *pattern);
+
+void
+mutest_filter_suites (void);
+
+void
+mutest_timings_init (const char *path);
+
+void
+mutest_timings_record (const mutest_suite_t *suite,
+                       const mutest_spec_t *spec);
+
+void
+mutest_timings_prune (const mutest_suite_t *first_suite);
+
+void
+mutest_timings_save (void);
+
+size_t *
+mutest_timings_order (const mutest_suite_t *suite,
+                      size_t n_specs);
+
+int64_t
+mutest_timings_lookup (const mutest_suite_t *suite,
+                       const mutest_spec_t *spec);
+
 int
 mutest_get_results (int *total_pass,
                     int *total_fail,
                     int *total_skip);
 
+int
+mutest_get_exit_status (void);
+
 void
 mutest_format_main_preamble (void);
 
@@ -365,4 +966,120 @@ mutest_get_mocha_formatter (void);
 const mutest_formatter_t *
 mutest_get_tap_formatter (void);
 
+const mutest_formatter_t *
+mutest_get_json_formatter (void);
+
+const mutest_formatter_t *
+mutest_get_junit_formatter (void);
+
+const mutest_formatter_t *
+mutest_get_binary_formatter (void);
+
+bool
+mutest_binary_reader_init (mutest_binary_reader_t *reader,
+                           const char *data,
+                           size_t len);
+
+void
+mutest_binary_reader_clear (mutest_binary_reader_t *reader);
+
+bool
+mutest_binary_reader_next (mutest_binary_reader_t *reader,
+                           mutest_binary_record_t *record);
+
+void
+mutest_event_buffer_init (mutest_event_buffer_t *buffer);
+
+void
+mutest_event_buffer_init_static (mutest_event_buffer_t *buffer,
+                                 char *data,
+                                 size_t size);
+
+void
+mutest_event_buffer_clear (mutest_event_buffer_t *buffer);
+
+void
+mutest_event_buffer_append (mutest_event_buffer_t *buffer,
+                            const void *data,
+                            size_t len);
+
+void
+mutest_event_record_expect_result (mutest_event_buffer_t *buffer,
+                                   const mutest_expect_t *expect);
+
+void
+mutest_event_record_expect_fail (mutest_event_buffer_t *buffer,
+                                 const mutest_expect_t *expect,
+                                 bool negate,
+                                 const mutest_expect_res_t *check,
+                                 const char *check_repr);
+
+void
+mutest_event_record_spec_preamble (mutest_event_buffer_t *buffer,
+                                   const mutest_spec_t *spec);
+
+void
+mutest_event_record_spec_results (mutest_event_buffer_t *buffer,
+                                  const mutest_spec_t *spec);
+
+void
+mutest_event_record_suite_preamble (mutest_event_buffer_t *buffer,
+                                    const mutest_suite_t *suite);
+
+void
+mutest_event_record_suite_results (mutest_event_buffer_t *buffer,
+                                   const mutest_suite_t *suite);
+
+void
+mutest_event_record_spec_abort (mutest_event_buffer_t *buffer,
+                                const char *file,
+                                int line,
+                                const char *func_name,
+                                const char *message);
+
+void
+mutest_event_replay (const char *data,
+                     size_t len,
+                     mutest_spec_t *spec,
+                     mutest_replay_info_t *info);
+
+void
+mutest_event_format (const char *data,
+                     size_t len);
+
+bool
+mutest_event_has_failures (const char *data,
+                           size_t len);
+
+bool
+mutest_jobs_available (void);
+
+void
+mutest_jobs_suite_setup (mutest_suite_t *suite);
+
+void
+mutest_jobs_run_specs (mutest_suite_t *suite);
+
+bool
+mutest_jobs_isolate_spec (const mutest_spec_t *spec);
+
+void
+mutest_jobs_run_spec (mutest_suite_t *suite,
+                      mutest_spec_t *spec);
+
+void
+mutest_jobs_suite_teardown (mutest_suite_t *suite);
+
+void
+mutest_jobs_worker_abort (const char *file,
+                          int line,
+                          const char *func_name,
+                          const char *message);
+
+bool
+mutest_threads_available (void);
+
+void
+mutest_threads_run_specs (mutest_suite_t *suite);
+
 MUTEST_END_DECLS
@@ -0,0 +1,176 @@
+/* mutest-runner.c: Suite execution
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdlib.h>
+
+static void
+default_setup_suite (mutest_suite_t *suite)
+{
+  if (suite->before_hook != NULL)
+    suite->before_hook ();
+}
+
+static void
+default_teardown_suite (mutest_suite_t *suite)
+{
+  if (suite->after_hook != NULL)
+    suite->after_hook ();
+}
+
+static void
+serial_run_specs (mutest_suite_t *suite)
+{
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    {
+      if (mutest_is_cancelled ())
+        break;
+
+      mutest_spec_run (suite, spec);
+    }
+}
+
+static const mutest_scheduler_t schedulers[] = {
+  [MUTEST_SCHEDULER_SERIAL] = {
+    .name = "serial",
+    .setup_suite = default_setup_suite,
+    .run_specs = serial_run_specs,
+    .teardown_suite = default_teardown_suite,
+  },
+  [MUTEST_SCHEDULER_FORK] = {
+    .name = "fork",
+    .setup_suite = mutest_jobs_suite_setup,
+    .run_specs = mutest_jobs_run_specs,
+    .teardown_suite = mutest_jobs_suite_teardown,
+  },
+  [MUTEST_SCHEDULER_THREADS] = {
+    .name = "threads",
+    .setup_suite = default_setup_suite,
+    .run_specs = mutest_threads_run_specs,
+    .teardown_suite = default_teardown_suite,
+  },
+};
+
+const mutest_scheduler_t *
+mutest_get_scheduler (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  return &schedulers[state->scheduler];
+}
+
+// mutest_prune_specs:
+// @func: the function deciding whether to keep a spec
+// @data: data passed to @func
+// @keep_empty: whether to keep the suites that have no specs at all
+//
+// Removes all the specs for which @func returns false, walking the
+// suites and specs in declaration order; suites left without specs
+// are removed as well, without running any of their hooks.
+//
+// Returns: the number of removed specs
+size_t
+mutest_prune_specs (mutest_spec_filter_func_t func,
+                    void *data,
+                    bool keep_empty)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+  mutest_suite_t *prev_suite = NULL;
+  mutest_suite_t *suite = state->first_suite;
+  size_t n_removed = 0;
+
+  while (suite != NULL)
+    {
+      mutest_suite_t *next_suite = suite->next;
+      bool had_specs = suite->first_spec != NULL;
+
+      mutest_spec_t *spec = suite->first_spec;
+
+      suite->first_spec = NULL;
+      suite->last_spec = NULL;
+
+      while (spec != NULL)
+        {
+          mutest_spec_t *next_spec = spec->next;
+
+          if (func (suite, spec, data))
+            {
+              spec->next = NULL;
+
+              if (suite->last_spec != NULL)
+                suite->last_spec->next = spec;
+              else
+                suite->first_spec = spec;
+
+              suite->last_spec = spec;
+            }
+          else
+            {
+              mutest_spec_free (spec);
+              n_removed += 1;
+            }
+
+          spec = next_spec;
+        }
+
+      bool keep = had_specs ? suite->first_spec != NULL : keep_empty;
+
+      if (keep)
+        {
+          prev_suite = suite;
+        }
+      else
+        {
+          if (prev_suite != NULL)
+            prev_suite->next = next_suite;
+          else
+            state->first_suite = next_suite;
+
+          if (state->last_suite == suite)
+            state->last_suite = prev_suite;
+
+          mutest_suite_free (suite);
+        }
+
+      suite = next_suite;
+    }
+
+  return n_removed;
+}
+
+// mutest_run_suites:
+//
+// Runs all the suites collected by mutest_describe(), in the
+// order in which they were described, and releases them.
+void
+mutest_run_suites (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  // Stale timings are found using all the specs, even the filtered ones
+  mutest_timings_prune (state->first_suite);
+
+  mutest_filter_suites ();
+  mutest_shard_suites ();
+
+  while (state->first_suite != NULL)
+    {
+      mutest_suite_t *suite = state->first_suite;
+
+      // After a failure in fail-fast mode, the remaining suites
+      // are dropped without running any of their hooks
+      if (!mutest_is_cancelled ())
+        mutest_suite_run (suite);
+
+      state->first_suite = suite->next;
+      if (state->first_suite == NULL)
+        state->last_suite = NULL;
+
+      mutest_suite_free (suite);
+    }
+}
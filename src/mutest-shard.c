@@ -0,0 +1,283 @@
+/* mutest-shard.c: Sharding specs across multiple runs
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sharding splits the specs of a test binary across multiple runs,
+// typically on different machines, so that every spec is run by
+// exactly one shard.
+//
+// By default, each spec is assigned to a shard using a hash of the
+// descriptions of its suite and of the spec itself, and of its position
+// among the specs with the same descriptions, which is stable across
+// machines and builds. Alternatively, specs can be assigned
+// using the durations recorded in the timings database, so that every
+// shard takes roughly the same amount of time; as long as all shards
+// use the same database, the assignment is the same for all of them.
+typedef struct {
+  mutest_suite_t *suite;
+  mutest_spec_t *spec;
+
+  uint64_t hash;
+  int64_t weight;
+
+  // Declaration order, to break ties
+  size_t index;
+
+  int shard;
+} shard_item_t;
+
+static uint64_t
+spec_hash (const mutest_suite_t *suite,
+           const mutest_spec_t *spec)
+{
+  uint64_t hash = MUTEST_HASH_INIT;
+
+  hash = mutest_hash_string (hash, suite->description);
+  hash = mutest_hash_string (hash, spec->description);
+
+  return hash;
+}
+
+static bool
+has_same_name (const shard_item_t *item_a,
+               const shard_item_t *item_b)
+{
+  return item_a->hash == item_b->hash &&
+         strcmp (item_a->suite->description, item_b->suite->description) == 0 &&
+         strcmp (item_a->spec->description, item_b->spec->description) == 0;
+}
+
+typedef struct {
+  // The first spec with a name, or NULL for an empty slot
+  const shard_item_t *item;
+
+  size_t n_items;
+} name_slot_t;
+
+// Specs with the same name would all end up in the same shard, so the
+// hash of every spec after the first one with the same name includes
+// its position among them.
+//
+// The names are counted using an open addressing hash table, keyed by
+// the hash of the names; the size is a power of two, at least twice
+// the number of specs. The first spec with a name keeps its hash, so
+// it can be compared with the following ones.
+static void
+hash_occurrences (shard_item_t *items,
+                  size_t n_items)
+{
+  size_t size = 16;
+  while (size < n_items * 2)
+    size *= 2;
+
+  name_slot_t *slots = calloc (size, sizeof (name_slot_t));
+  if (slots == NULL)
+    mutest_oom_abort ();
+
+  size_t mask = size - 1;
+
+  for (size_t i = 0; i < n_items; i++)
+    {
+      size_t j = (size_t) items[i].hash & mask;
+
+      while (slots[j].item != NULL && !has_same_name (slots[j].item, &items[i]))
+        j = (j + 1) & mask;
+
+      if (slots[j].item == NULL)
+        slots[j].item = &items[i];
+
+      size_t occurrence = slots[j].n_items;
+
+      slots[j].n_items += 1;
+
+      if (occurrence > 0)
+        {
+          char buf[32];
+
+          snprintf (buf, sizeof (buf), "%zu", occurrence);
+
+          items[i].hash = mutest_hash_string (items[i].hash, buf);
+        }
+    }
+
+  free (slots);
+}
+
+static int
+compare_by_weight (const void *a,
+                   const void *b)
+{
+  const shard_item_t *item_a = a;
+  const shard_item_t *item_b = b;
+
+  // Heaviest first
+  if (item_a->weight != item_b->weight)
+    return item_a->weight > item_b->weight ? -1 : 1;
+
+  if (item_a->hash != item_b->hash)
+    return item_a->hash < item_b->hash ? -1 : 1;
+
+  return item_a->index < item_b->index ? -1 : 1;
+}
+
+static int
+compare_by_index (const void *a,
+                  const void *b)
+{
+  const shard_item_t *item_a = a;
+  const shard_item_t *item_b = b;
+
+  if (item_a->index == item_b->index)
+    return 0;
+
+  return item_a->index < item_b->index ? -1 : 1;
+}
+
+// Assigns the heaviest spec to the least loaded shard, and repeats
+static void
+assign_by_duration (shard_item_t *items,
+                    size_t n_items,
+                    int n_shards)
+{
+  int64_t known_total = 0;
+  size_t n_known = 0;
+
+  for (size_t i = 0; i < n_items; i++)
+    {
+      items[i].weight = mutest_timings_lookup (items[i].suite, items[i].spec);
+
+      if (items[i].weight >= 0)
+        {
+          known_total += items[i].weight;
+          n_known += 1;
+        }
+    }
+
+  // Specs without a recorded duration weigh as much as the average one
+  int64_t unknown_weight = n_known > 0 ? known_total / (int64_t) n_known : 1;
+
+  for (size_t i = 0; i < n_items; i++)
+    {
+      if (items[i].weight < 0)
+        items[i].weight = unknown_weight;
+    }
+
+  qsort (items, n_items, sizeof (shard_item_t), compare_by_weight);
+
+  int64_t *loads = calloc (n_shards, sizeof (int64_t));
+  if (loads == NULL)
+    mutest_oom_abort ();
+
+  for (size_t i = 0; i < n_items; i++)
+    {
+      int shard = 0;
+
+      for (int s = 1; s < n_shards; s++)
+        {
+          if (loads[s] < loads[shard])
+            shard = s;
+        }
+
+      items[i].shard = shard;
+      loads[shard] += items[i].weight;
+    }
+
+  free (loads);
+}
+
+static void
+assign_by_hash (shard_item_t *items,
+                size_t n_items,
+                int n_shards)
+{
+  for (size_t i = 0; i < n_items; i++)
+    items[i].shard = (int) (items[i].hash % (uint64_t) n_shards);
+}
+
+typedef struct {
+  const shard_item_t *items;
+  size_t next;
+  int shard;
+} shard_cursor_t;
+
+static bool
+is_in_shard (mutest_suite_t *suite MUTEST_UNUSED,
+             mutest_spec_t *spec MUTEST_UNUSED,
+             void *data)
+{
+  shard_cursor_t *cursor = data;
+  const shard_item_t *item = &cursor->items[cursor->next];
+
+  cursor->next += 1;
+
+  return item->shard == cursor->shard;
+}
+
+// mutest_shard_suites:
+//
+// Removes all the specs that do not belong to the current shard, as
+// well as the suites left without specs.
+//
+// Suites without any spec are only kept by the first shard.
+void
+mutest_shard_suites (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  if (state->shard_count <= 1)
+    return;
+
+  size_t n_items = 0;
+  for (mutest_suite_t *suite = state->first_suite; suite != NULL; suite = suite->next)
+    {
+      for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+        n_items += 1;
+    }
+
+  shard_item_t *items = calloc (n_items > 0 ? n_items : 1, sizeof (shard_item_t));
+  if (items == NULL)
+    mutest_oom_abort ();
+
+  size_t i = 0;
+  for (mutest_suite_t *suite = state->first_suite; suite != NULL; suite = suite->next)
+    {
+      for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+        {
+          items[i].suite = suite;
+          items[i].spec = spec;
+          items[i].hash = spec_hash (suite, spec);
+          items[i].index = i;
+          i += 1;
+        }
+    }
+
+  hash_occurrences (items, n_items);
+
+  if (state->shard_by_duration)
+    assign_by_duration (items, n_items, state->shard_count);
+  else
+    assign_by_hash (items, n_items, state->shard_count);
+
+  // Walk the items in declaration order, alongside the specs
+  if (state->shard_by_duration)
+    qsort (items, n_items, sizeof (shard_item_t), compare_by_index);
+
+  shard_cursor_t cursor = {
+    .items = items,
+    .next = 0,
+    .shard = state->shard_index,
+  };
+
+  mutest_prune_specs (is_in_shard, &cursor, state->shard_index == 0);
+
+  free (items);
+}
@@ -11,12 +11,92 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+// mutest_spec_before:
+// @suite: the suite containing @spec
+// @spec: the spec to run
+//
+// Sets @spec as the current spec, and calls the before_each()
+// hook of @suite.
 void
-mutest_it_full (const char *file,
-                int line,
-                const char *func_name,
-                const char *description,
-                mutest_spec_func_t func)
+mutest_spec_before (mutest_suite_t *suite,
+                    mutest_spec_t *spec)
+{
+  mutest_set_current_spec (spec);
+
+  if (suite->before_each_hook != NULL)
+    suite->before_each_hook ();
+
+  /* If mutest_spec_skip() was called inside the before_each() hook,
+   * then we don't call func(), and mark the whole spec as skipped
+   */
+  if (spec->skip_all)
+    {
+      spec->n_expects = 1;
+      spec->skip = 1;
+    }
+}
+
+// mutest_spec_exec:
+// @spec: the spec to run
+//
+// Calls the function of @spec, unless the spec was skipped, and
+// collects the results.
+void
+mutest_spec_exec (mutest_spec_t *spec)
+{
+  if (spec->skip_all)
+    return;
+
+  spec->start_time = mutest_clock_get_time ();
+
+  mutest_perf_start (spec);
+  mutest_alloc_start ();
+  spec->func (spec);
+  mutest_alloc_stop (&spec->alloc);
+  mutest_perf_stop (spec);
+
+  // Benchmarks are only measured if the first call passed
+  if (spec->is_bench && !spec->skip_all && spec->fail == 0)
+    mutest_bench_run (spec);
+
+  spec->end_time = mutest_clock_get_time ();
+
+  /* If mutest_spec_skip() was called in func() then we mark the
+   * whole spec as skipped regardless of how many expectations
+   * were actually ran
+   */
+  if (spec->skip_all)
+    {
+      spec->n_expects = 1;
+      spec->skip = 1;
+    }
+}
+
+// mutest_spec_after:
+// @suite: the suite containing @spec
+// @spec: the spec that was run
+//
+// Calls the after_each() hook of @suite, unsets the current spec, and
+// releases the values of its expectations.
+void
+mutest_spec_after (mutest_suite_t *suite,
+                   mutest_spec_t *spec MUTEST_UNUSED)
+{
+  if (suite->after_each_hook != NULL)
+    suite->after_each_hook ();
+
+  mutest_set_current_spec (NULL);
+
+  mutest_arena_reset ();
+}
+
+void
+mutest_it_with_timeout_full (const char *file,
+                             int line,
+                             const char *func_name,
+                             const char *description,
+                             mutest_spec_func_t func,
+                             double timeout)
 {
   if (description == NULL)
     mutest_assert_if_reached ("missing spec description");
@@ -27,60 +107,95 @@ mutest_it_full (const char *file,
   if (mutest_get_current_suite () == NULL)
     mutest_assert_if_reached ("missing suite");
 
-  mutest_spec_t spec = {
-    .description = description,
-    .file = file,
-    .line = line,
-    .func_name = func_name,
-    .skip_all = false,
-    .n_expects = 0,
-    .pass = 0,
-    .fail = 0,
-    .skip = 0,
-  };
-
-  mutest_format_spec_preamble (&spec);
+  mutest_spec_t *spec = calloc (1, sizeof (mutest_spec_t));
+  if (spec == NULL)
+    mutest_oom_abort ();
 
-  mutest_set_current_spec (&spec);
+  spec->description = mutest_strdup (description);
+  spec->file = file;
+  spec->line = line;
+  spec->func_name = func_name;
+  spec->func = func;
+  spec->skip_all = false;
+  spec->timeout = timeout > 0 ? (int64_t) (timeout * 1000000.0) : 0;
 
   mutest_suite_t *suite = mutest_get_current_suite ();
 
-  if (suite->before_each_hook != NULL)
-    suite->before_each_hook ();
-
-  /* If mutest_spec_skip() was called inside the before_each() hook,
-   * then we don't call func(), and mark the whole spec as skipped
-   */
-  if (spec.skip_all)
-    {
-      spec.n_expects = 1;
-      spec.skip = 1;
-    }
+  if (suite->last_spec != NULL)
+    suite->last_spec->next = spec;
   else
+    suite->first_spec = spec;
+
+  suite->last_spec = spec;
+}
+
+void
+mutest_it_full (const char *file,
+                int line,
+                const char *func_name,
+                const char *description,
+                mutest_spec_func_t func)
+{
+  mutest_it_with_timeout_full (file, line, func_name, description, func, 0);
+}
+
+// mutest_spec_free:
+// @spec: a spec
+//
+// Releases the resources associated with @spec.
+void
+mutest_spec_free (mutest_spec_t *spec)
+{
+  free ((char *) spec->description);
+  free (spec);
+}
+
+// mutest_spec_get_timeout:
+// @spec: a spec
+//
+// Returns: the timeout of @spec, in microseconds, or 0 if the
+//   spec has no timeout
+int64_t
+mutest_spec_get_timeout (const mutest_spec_t *spec)
+{
+  if (spec->timeout > 0)
+    return spec->timeout;
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  return state->default_timeout;
+}
+
+// mutest_spec_run:
+// @suite: the suite containing @spec
+// @spec: the spec to run
+//
+// Runs @spec, and adds its results to @suite.
+void
+mutest_spec_run (mutest_suite_t *suite,
+                 mutest_spec_t *spec)
+{
+  // The runner cannot stop a spec that goes past its timeout, while
+  // a worker process can be terminated
+  if (mutest_jobs_isolate_spec (spec))
     {
-      spec.start_time = mutest_get_current_time ();
-      func (&spec);
-      spec.end_time = mutest_get_current_time ();
-
-      /* If mutest_spec_skip() was called in func() then we mark the
-       * whole spec as skipped regardless of how many expectations
-       * were actually ran
-       */
-      if (spec.skip_all)
-        {
-          spec.n_expects = 1;
-          spec.skip = 1;
-        }
+      mutest_jobs_run_spec (suite, spec);
+      return;
     }
 
-  mutest_suite_add_spec_results (suite, &spec);
+  mutest_format_spec_preamble (spec);
 
-  if (suite->after_each_hook != NULL)
-    suite->after_each_hook ();
+  mutest_spec_before (suite, spec);
 
-  mutest_set_current_spec (NULL);
+  mutest_watchdog_start (0, suite, spec);
+  mutest_spec_exec (spec);
+  mutest_watchdog_stop (0, spec);
+
+  mutest_spec_after (suite, spec);
 
-  mutest_format_spec_results (&spec);
+  mutest_suite_add_spec_results (suite, spec);
+
+  mutest_format_spec_results (spec);
 }
 
 void
@@ -108,6 +223,9 @@ mutest_spec_add_expect_result (mutest_spec_t *spec,
     case MUTEST_RESULT_FAIL:
       spec->n_expects += 1;
       spec->fail += 1;
+
+      if (mutest_get_global_state ()->fail_fast)
+        mutest_cancel ();
       break;
 
     case MUTEST_RESULT_SKIP:
@@ -40,6 +40,9 @@
 // }
 // ```
 //
+// The suite function is called immediately, to collect the specs and
+// the hooks of the suite; the specs are run by mutest_report().
+//
 // It's not possible to call mutest_describe() from within a
 // another test suite.
 void
@@ -60,47 +63,101 @@ mutest_describe_full (const char *file,
 
   mutest_init ();
 
-  mutest_suite_t suite = {
-    .file = file,
-    .line = line,
-    .func_name = func_name,
-    .description = description,
-    .skip_all = false,
-  };
+  mutest_state_t *state = mutest_get_global_state ();
+
+  mutest_suite_t *suite = calloc (1, sizeof (mutest_suite_t));
+  if (suite == NULL)
+    mutest_oom_abort ();
+
+  suite->file = file;
+  suite->line = line;
+  suite->func_name = func_name;
+  suite->description = mutest_strdup (description);
+  suite->func = func;
+  suite->skip_all = false;
+
+  /* The global hooks in effect when the suite is described are
+   * the ones that will be called when the suite is run
+   */
+  suite->before_hook = state->before_hook;
+  suite->after_hook = state->after_hook;
+
+  if (state->last_suite != NULL)
+    state->last_suite->next = suite;
+  else
+    state->first_suite = suite;
+
+  state->last_suite = suite;
 
-  mutest_set_current_suite (&suite);
+  /* Collect the specs and the hooks of the suite; the specs
+   * are run later on, by mutest_run_suites()
+   */
+  mutest_set_current_suite (suite);
 
+  func (suite);
+
+  mutest_set_current_suite (NULL);
+}
+
+// mutest_suite_run:
+// @suite: a #mutest_suite_t
+//
+// Runs all the specs of @suite using the current scheduler.
+void
+mutest_suite_run (mutest_suite_t *suite)
+{
   mutest_state_t *state = mutest_get_global_state ();
+  const mutest_scheduler_t *scheduler = mutest_get_scheduler ();
+
+  mutest_set_current_suite (suite);
 
-  if (state->before_hook != NULL)
-    state->before_hook ();
+  scheduler->setup_suite (suite);
 
-  mutest_format_suite_preamble (&suite);
+  mutest_format_suite_preamble (suite);
 
-  if (suite.skip_all)
+  if (suite->skip_all)
     {
       state->total_skip += 1;
     }
   else
     {
-      suite.start_time = mutest_get_current_time ();
-      func (&suite);
-      suite.end_time = mutest_get_current_time ();
+      suite->start_time = mutest_get_current_time_ns ();
+      scheduler->run_specs (suite);
+      suite->end_time = mutest_get_current_time_ns ();
+
+      for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+        mutest_timings_record (suite, spec);
 
-      if (suite.skip_all)
+      if (suite->skip_all)
         state->total_skip += 1;
     }
 
-  mutest_add_suite_results (&suite);
+  mutest_add_suite_results (suite);
 
-  if (state->after_hook != NULL)
-    state->after_hook ();
+  scheduler->teardown_suite (suite);
 
-  mutest_format_suite_results (&suite);
+  mutest_format_suite_results (suite);
 
   mutest_set_current_suite (NULL);
 }
 
+void
+mutest_suite_free (mutest_suite_t *suite)
+{
+  mutest_spec_t *spec = suite->first_spec;
+
+  while (spec != NULL)
+    {
+      mutest_spec_t *next = spec->next;
+
+      mutest_spec_free (spec);
+      spec = next;
+    }
+
+  free ((char *) suite->description);
+  free (suite);
+}
+
 void
 mutest_suite_add_spec_results (mutest_suite_t *suite,
                                mutest_spec_t *spec)
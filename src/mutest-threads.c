@@ -0,0 +1,387 @@
+/* mutest-threads.c: Thread pool scheduler
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+bool
+mutest_threads_available (void)
+{
+#ifdef HAVE_PTHREAD_H
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef HAVE_PTHREAD_H
+
+// The specs of a suite are split into contiguous ranges, one for each
+// worker thread. Each worker takes specs from the front of its own range
+// and, once that is empty, steals specs from the back of the ranges of
+// the other workers.
+//
+// Workers record the formatter events of each spec into a separate
+// buffer, and the main thread replays them in the same order in which
+// the specs were declared; the results of each spec are only added to
+// the suite by the main thread, so the counters are never shared between
+// threads.
+//
+// Unlike the fork scheduler, the before_each() and after_each() hooks
+// are called on the worker thread that runs the spec, so they must be
+// thread safe.
+//
+// Once the run is cancelled, in fail-fast mode, workers stop taking new
+// specs, and let the ones already running finish; only the specs that
+// were run are replayed.
+typedef struct {
+  pthread_mutex_t lock;
+
+  size_t begin;
+  size_t end;
+} worker_range_t;
+
+typedef struct {
+  mutest_spec_t *spec;
+  mutest_event_buffer_t events;
+  bool done;
+} pool_task_t;
+
+static struct {
+  bool initialized;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+
+  pthread_t *threads;
+  worker_range_t *ranges;
+  int n_threads;
+
+  // Bumped every time a new suite is available
+  unsigned int generation;
+
+  // The number of workers still looking at the current suite
+  int n_busy;
+
+  mutest_suite_t *suite;
+  pool_task_t *tasks;
+  size_t n_tasks;
+
+  // The ranges of the workers index this array, which maps
+  // each slot to the task to run
+  size_t *slots;
+} pool;
+
+static bool
+take_own_task (int worker,
+               size_t *task)
+{
+  worker_range_t *range = &pool.ranges[worker];
+  bool res = false;
+
+  pthread_mutex_lock (&range->lock);
+  if (range->begin < range->end)
+    {
+      *task = range->begin;
+      range->begin += 1;
+      res = true;
+    }
+  pthread_mutex_unlock (&range->lock);
+
+  return res;
+}
+
+static bool
+steal_task (int worker,
+            size_t *task)
+{
+  for (int i = 1; i < pool.n_threads; i++)
+    {
+      worker_range_t *range = &pool.ranges[(worker + i) % pool.n_threads];
+      bool res = false;
+
+      pthread_mutex_lock (&range->lock);
+      if (range->begin < range->end)
+        {
+          range->end -= 1;
+          *task = range->end;
+          res = true;
+        }
+      pthread_mutex_unlock (&range->lock);
+
+      if (res)
+        return true;
+    }
+
+  return false;
+}
+
+static void
+run_task (int worker,
+          mutest_suite_t *suite,
+          pool_task_t *task)
+{
+  mutest_set_current_suite (suite);
+  mutest_set_recorder (&task->events);
+
+  mutest_spec_before (suite, task->spec);
+
+  mutest_watchdog_start (worker, suite, task->spec);
+  mutest_spec_exec (task->spec);
+  mutest_watchdog_stop (worker, task->spec);
+
+  mutest_spec_after (suite, task->spec);
+
+  mutest_set_recorder (NULL);
+  mutest_set_current_suite (NULL);
+
+  pthread_mutex_lock (&pool.lock);
+  task->done = true;
+  pthread_cond_broadcast (&pool.done_cond);
+  pthread_mutex_unlock (&pool.lock);
+}
+
+static void *
+worker_thread (void *data)
+{
+  int worker = (int) (intptr_t) data;
+  unsigned int generation = 0;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pool.lock);
+      while (pool.generation == generation)
+        pthread_cond_wait (&pool.work_cond, &pool.lock);
+      generation = pool.generation;
+      pthread_mutex_unlock (&pool.lock);
+
+      size_t slot;
+      while (!mutest_is_cancelled () &&
+             (take_own_task (worker, &slot) || steal_task (worker, &slot)))
+        run_task (worker, pool.suite, &pool.tasks[pool.slots[slot]]);
+
+      pthread_mutex_lock (&pool.lock);
+      pool.n_busy -= 1;
+      pthread_cond_broadcast (&pool.done_cond);
+      pthread_mutex_unlock (&pool.lock);
+    }
+
+  return NULL;
+}
+
+static void
+pool_init (void)
+{
+  if (mutest_likely (pool.initialized))
+    return;
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.work_cond, NULL);
+  pthread_cond_init (&pool.done_cond, NULL);
+
+  pool.n_threads = state->n_jobs;
+  pool.threads = calloc (pool.n_threads, sizeof (pthread_t));
+  pool.ranges = calloc (pool.n_threads, sizeof (worker_range_t));
+  if (pool.threads == NULL || pool.ranges == NULL)
+    mutest_oom_abort ();
+
+  for (int i = 0; i < pool.n_threads; i++)
+    {
+      pthread_mutex_init (&pool.ranges[i].lock, NULL);
+
+      if (pthread_create (&pool.threads[i], NULL, worker_thread, (void *) (intptr_t) i) != 0)
+        mutest_assert_if_reached ("unable to create worker thread");
+    }
+
+  pool.initialized = true;
+}
+
+static void
+replay_task (mutest_suite_t *suite,
+             pool_task_t *task)
+{
+  mutest_spec_t *spec = task->spec;
+
+  mutest_format_spec_preamble (spec);
+
+  mutest_event_replay (task->events.data, task->events.len, spec, NULL);
+
+  mutest_suite_add_spec_results (suite, spec);
+
+  mutest_format_spec_results (spec);
+
+  mutest_event_buffer_clear (&task->events);
+}
+
+// Runs @n_tasks tasks on the thread pool, and replays them in order;
+// @order, if set, is the order in which to start them
+static void
+pool_run_tasks (mutest_suite_t *suite,
+                pool_task_t *tasks,
+                size_t n_tasks,
+                const size_t *order)
+{
+  size_t *slots = calloc (n_tasks, sizeof (size_t));
+  if (slots == NULL)
+    mutest_oom_abort ();
+
+  // Split the specs in contiguous ranges; the workers will balance
+  // the load by stealing from each other
+  size_t chunk = n_tasks / pool.n_threads;
+  size_t extra = n_tasks % pool.n_threads;
+  size_t begin = 0;
+  for (int w = 0; w < pool.n_threads; w++)
+    {
+      size_t len = chunk + ((size_t) w < extra ? 1 : 0);
+
+      pool.ranges[w].begin = begin;
+      pool.ranges[w].end = begin + len;
+
+      // With recorded durations, the specs are dealt to the workers
+      // longest first, so every worker starts from one of the longest
+      // specs, and the shortest ones are left for stealing
+      for (size_t j = 0; j < len; j++)
+        {
+          if (order != NULL)
+            slots[begin + j] = order[j * pool.n_threads + w];
+          else
+            slots[begin + j] = begin + j;
+        }
+
+      begin += len;
+    }
+
+  pthread_mutex_lock (&pool.lock);
+  pool.suite = suite;
+  pool.tasks = tasks;
+  pool.n_tasks = n_tasks;
+  pool.slots = slots;
+  pool.n_busy = pool.n_threads;
+  pool.generation += 1;
+  pthread_cond_broadcast (&pool.work_cond);
+  pthread_mutex_unlock (&pool.lock);
+
+  // Replay the specs in order, as soon as they are done; if all the
+  // workers are idle, and the spec is not done, then it was cancelled
+  for (size_t i = 0; i < n_tasks; i++)
+    {
+      pthread_mutex_lock (&pool.lock);
+      while (!tasks[i].done && pool.n_busy > 0)
+        pthread_cond_wait (&pool.done_cond, &pool.lock);
+      bool done = tasks[i].done;
+      pthread_mutex_unlock (&pool.lock);
+
+      if (done)
+        replay_task (suite, &tasks[i]);
+      else
+        mutest_event_buffer_clear (&tasks[i].events);
+    }
+
+  // Wait until all workers are idle before releasing the tasks
+  pthread_mutex_lock (&pool.lock);
+  while (pool.n_busy > 0)
+    pthread_cond_wait (&pool.done_cond, &pool.lock);
+  pool.suite = NULL;
+  pool.tasks = NULL;
+  pool.n_tasks = 0;
+  pool.slots = NULL;
+  pthread_mutex_unlock (&pool.lock);
+
+  free (slots);
+}
+
+// Specs that need a worker process, because they have a timeout, are
+// run by the main thread between the runs of the pool: forking while
+// the workers are running specs could leave the locks they hold locked
+// forever in the new process. The recorded durations are only used to
+// order the specs of suites that run on the pool in one go.
+void
+mutest_threads_run_specs (mutest_suite_t *suite)
+{
+  size_t n_tasks = 0;
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    n_tasks += 1;
+
+  if (n_tasks == 0)
+    return;
+
+  pool_init ();
+
+  pool_task_t *tasks = calloc (n_tasks, sizeof (pool_task_t));
+  if (tasks == NULL)
+    mutest_oom_abort ();
+
+  size_t n_isolated = 0;
+  size_t i = 0;
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    {
+      tasks[i].spec = spec;
+      mutest_event_buffer_init (&tasks[i].events);
+
+      if (mutest_jobs_isolate_spec (spec))
+        n_isolated += 1;
+
+      i += 1;
+    }
+
+  if (n_isolated == 0)
+    {
+      size_t *order = mutest_timings_order (suite, n_tasks);
+
+      pool_run_tasks (suite, tasks, n_tasks, order);
+
+      free (order);
+      free (tasks);
+      return;
+    }
+
+  size_t begin = 0;
+  for (i = 0; i < n_tasks; i++)
+    {
+      if (!mutest_jobs_isolate_spec (tasks[i].spec))
+        continue;
+
+      if (i > begin)
+        pool_run_tasks (suite, tasks + begin, i - begin, NULL);
+
+      if (!mutest_is_cancelled ())
+        mutest_jobs_run_spec (suite, tasks[i].spec);
+
+      begin = i + 1;
+    }
+
+  if (n_tasks > begin)
+    pool_run_tasks (suite, tasks + begin, n_tasks - begin, NULL);
+
+  free (tasks);
+}
+
+#else /* HAVE_PTHREAD_H */
+
+void
+mutest_threads_run_specs (mutest_suite_t *suite)
+{
+  for (mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+    {
+      if (mutest_is_cancelled ())
+        break;
+
+      mutest_spec_run (suite, spec);
+    }
+}
+
+#endif /* HAVE_PTHREAD_H */
@@ -0,0 +1,751 @@
+/* mutest-timings.c: Recorded spec durations
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The timings database is a text file with one spec per line, and
+// tab-separated fields:
+//
+//   <duration in µs> <line> <file> <suite description> <spec description> <missing runs>
+//
+// Tabs, newlines and backslashes inside the strings are escaped with
+// a backslash. Lines starting with '#' are ignored; the number of
+// missing runs is optional, and defaults to zero.
+//
+// Specs are identified by the file and line of their mutest_it() call,
+// and by the description of the spec and of its suite.
+//
+// Entries of specs that no longer exist are pruned when running the
+// specs: an entry is dropped as soon as its file and line belong to a
+// spec with different descriptions, and after MAX_MISSING_RUNS runs
+// of the specs of its file in which it was missing.
+#define MAX_MISSING_RUNS        10
+
+typedef struct {
+  uint64_t hash;
+
+  char *file;
+  int line;
+  char *suite;
+  char *spec;
+
+  int64_t duration;
+
+  // The runs of the specs of the same file without this spec
+  int missing;
+
+  // Whether the spec exists in the current run
+  bool present;
+} timing_entry_t;
+
+static struct {
+  timing_entry_t *entries;
+  size_t n_entries;
+  size_t size;
+
+  // Where to save the database, if anywhere
+  char *path;
+} timings;
+
+static uint64_t
+timing_hash (const char *file,
+             int line,
+             const char *suite,
+             const char *spec)
+{
+  char line_s[32];
+
+  snprintf (line_s, 32, "%d", line);
+
+  uint64_t hash = MUTEST_HASH_INIT;
+
+  hash = mutest_hash_string (hash, file);
+  hash = mutest_hash_string (hash, line_s);
+  hash = mutest_hash_string (hash, suite);
+  hash = mutest_hash_string (hash, spec);
+
+  return hash;
+}
+
+static bool
+str_equal (const char *a,
+           const char *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+
+  return strcmp (a, b) == 0;
+}
+
+static timing_entry_t *
+timings_find (uint64_t hash,
+              const char *file,
+              int line,
+              const char *suite,
+              const char *spec)
+{
+  if (timings.size == 0)
+    return NULL;
+
+  size_t mask = timings.size - 1;
+
+  for (size_t i = hash & mask; timings.entries[i].file != NULL; i = (i + 1) & mask)
+    {
+      timing_entry_t *entry = &timings.entries[i];
+
+      if (entry->hash == hash &&
+          entry->line == line &&
+          str_equal (entry->file, file) &&
+          str_equal (entry->suite, suite) &&
+          str_equal (entry->spec, spec))
+        return entry;
+    }
+
+  return NULL;
+}
+
+static void
+timings_insert (timing_entry_t *entry);
+
+static void
+timings_grow (void)
+{
+  timing_entry_t *old_entries = timings.entries;
+  size_t old_size = timings.size;
+
+  timings.size = old_size > 0 ? old_size * 2 : 64;
+  timings.entries = calloc (timings.size, sizeof (timing_entry_t));
+  if (timings.entries == NULL)
+    mutest_oom_abort ();
+
+  timings.n_entries = 0;
+
+  for (size_t i = 0; i < old_size; i++)
+    {
+      if (old_entries[i].file != NULL)
+        timings_insert (&old_entries[i]);
+    }
+
+  free (old_entries);
+}
+
+// Takes ownership of the strings inside @entry
+static void
+timings_insert (timing_entry_t *entry)
+{
+  // Keep the load factor under 0.5
+  if ((timings.n_entries + 1) * 2 > timings.size)
+    timings_grow ();
+
+  size_t mask = timings.size - 1;
+  size_t i = entry->hash & mask;
+
+  while (timings.entries[i].file != NULL)
+    i = (i + 1) & mask;
+
+  timings.entries[i] = *entry;
+  timings.n_entries += 1;
+}
+
+// Reads a whole line from @stream, without the newline
+static bool
+read_line (FILE *stream,
+           char **buf,
+           size_t *size)
+{
+  size_t len = 0;
+
+  for (;;)
+    {
+      if (len + 2 > *size)
+        {
+          size_t new_size = *size > 0 ? *size * 2 : 256;
+          char *new_buf = realloc (*buf, new_size);
+          if (new_buf == NULL)
+            mutest_oom_abort ();
+
+          *buf = new_buf;
+          *size = new_size;
+        }
+
+      int c = fgetc (stream);
+
+      if (c == EOF)
+        {
+          (*buf)[len] = '\0';
+          return len > 0;
+        }
+
+      if (c == '\n')
+        {
+          (*buf)[len] = '\0';
+          return true;
+        }
+
+      (*buf)[len++] = (char) c;
+    }
+}
+
+// Splits the next tab-separated field of @cursor, unescaping it in place
+static char *
+next_field (char **cursor)
+{
+  char *field = *cursor;
+
+  if (field == NULL)
+    return NULL;
+
+  char *src = field, *dst = field;
+
+  while (*src != '\0' && *src != '\t')
+    {
+      if (*src == '\\' && src[1] != '\0')
+        {
+          src += 1;
+
+          switch (*src)
+            {
+            case 't':
+              *dst++ = '\t';
+              break;
+
+            case 'n':
+              *dst++ = '\n';
+              break;
+
+            default:
+              *dst++ = *src;
+              break;
+            }
+
+          src += 1;
+        }
+      else
+        *dst++ = *src++;
+    }
+
+  *cursor = *src == '\t' ? src + 1 : NULL;
+  *dst = '\0';
+
+  return field;
+}
+
+// mutest_timings_init:
+// @path: the path of the timings database
+//
+// Loads the durations of the specs recorded inside @path; a missing,
+// or unreadable, file is ignored, as are malformed lines.
+//
+// The database is saved back to @path by mutest_timings_save().
+void
+mutest_timings_init (const char *path)
+{
+  free (timings.path);
+  timings.path = mutest_strdup (path);
+
+  FILE *stream = fopen (path, "r");
+  if (stream == NULL)
+    return;
+
+  char *buf = NULL;
+  size_t size = 0;
+
+  while (read_line (stream, &buf, &size))
+    {
+      if (buf[0] == '#' || buf[0] == '\0')
+        continue;
+
+      char *cursor = buf;
+      char *duration_s = next_field (&cursor);
+      char *line_s = next_field (&cursor);
+      char *file = next_field (&cursor);
+      char *suite = next_field (&cursor);
+      char *spec = next_field (&cursor);
+      char *missing_s = next_field (&cursor);
+
+      if (spec == NULL)
+        continue;
+
+      char *end = NULL;
+      errno = 0;
+      long long duration = strtoll (duration_s, &end, 10);
+      if (errno != 0 || end == duration_s || *end != '\0' || duration < 0)
+        continue;
+
+      end = NULL;
+      errno = 0;
+      long line = strtol (line_s, &end, 10);
+      if (errno != 0 || end == line_s || *end != '\0')
+        continue;
+
+      long missing = 0;
+      if (missing_s != NULL)
+        {
+          end = NULL;
+          errno = 0;
+          missing = strtol (missing_s, &end, 10);
+          if (errno != 0 || end == missing_s || *end != '\0' || missing < 0)
+            continue;
+        }
+
+      uint64_t hash = timing_hash (file, (int) line, suite, spec);
+
+      timing_entry_t *entry = timings_find (hash, file, (int) line, suite, spec);
+      if (entry != NULL)
+        {
+          entry->duration = duration;
+          entry->missing = (int) missing;
+          continue;
+        }
+
+      timing_entry_t new_entry = {
+        .hash = hash,
+        .file = mutest_strdup (file),
+        .line = (int) line,
+        .suite = mutest_strdup (suite),
+        .spec = mutest_strdup (spec),
+        .duration = duration,
+        .missing = (int) missing,
+      };
+
+      timings_insert (&new_entry);
+    }
+
+  free (buf);
+  fclose (stream);
+}
+
+// mutest_timings_lookup:
+// @suite: the suite of @spec
+// @spec: a spec
+//
+// Returns: the recorded duration of @spec, in microseconds,
+//   or -1 if the duration is unknown
+int64_t
+mutest_timings_lookup (const mutest_suite_t *suite,
+                       const mutest_spec_t *spec)
+{
+  uint64_t hash = timing_hash (spec->file, spec->line,
+                               suite->description,
+                               spec->description);
+
+  timing_entry_t *entry = timings_find (hash,
+                                        spec->file, spec->line,
+                                        suite->description,
+                                        spec->description);
+
+  return entry != NULL ? entry->duration : -1;
+}
+
+// mutest_timings_record:
+// @suite: the suite of @spec
+// @spec: a spec that was run
+//
+// Records the duration of @spec in the timings database; the
+// duration is blended with the previously recorded one, to
+// smooth out the noise of a single run.
+void
+mutest_timings_record (const mutest_suite_t *suite,
+                       const mutest_spec_t *spec)
+{
+  if (timings.path == NULL)
+    return;
+
+  // Skipped, or crashed, specs have no meaningful duration; neither
+  // does the CPU time, when scheduling specs
+  if (spec->skip_all ||
+      spec->end_time <= spec->start_time ||
+      !mutest_clock_is_wall_time ())
+    return;
+
+  int64_t duration = (spec->end_time - spec->start_time) / 1000;
+
+  uint64_t hash = timing_hash (spec->file, spec->line,
+                               suite->description,
+                               spec->description);
+
+  timing_entry_t *entry = timings_find (hash,
+                                        spec->file, spec->line,
+                                        suite->description,
+                                        spec->description);
+
+  if (entry != NULL)
+    {
+      entry->duration = (entry->duration + duration) / 2;
+      entry->missing = 0;
+      return;
+    }
+
+  timing_entry_t new_entry = {
+    .hash = hash,
+    .file = mutest_strdup (spec->file),
+    .line = spec->line,
+    .suite = mutest_strdup (suite->description),
+    .spec = mutest_strdup (spec->description),
+    .duration = duration,
+  };
+
+  timings_insert (&new_entry);
+}
+
+// A set of locations, as a file and a line; a line of -1 stands for
+// the whole file
+typedef struct {
+  uint64_t hash;
+  const char *file;
+  int line;
+} location_t;
+
+typedef struct {
+  location_t *locations;
+  size_t size;
+} location_set_t;
+
+static uint64_t
+location_hash (const char *file,
+               int line)
+{
+  char line_s[32];
+
+  snprintf (line_s, 32, "%d", line);
+
+  return mutest_hash_string (mutest_hash_string (MUTEST_HASH_INIT, file), line_s);
+}
+
+static bool
+location_set_contains (const location_set_t *set,
+                       const char *file,
+                       int line)
+{
+  uint64_t hash = location_hash (file, line);
+  size_t mask = set->size - 1;
+
+  for (size_t i = hash & mask; set->locations[i].file != NULL; i = (i + 1) & mask)
+    {
+      const location_t *location = &set->locations[i];
+
+      if (location->hash == hash &&
+          location->line == line &&
+          strcmp (location->file, file) == 0)
+        return true;
+    }
+
+  return false;
+}
+
+static void
+location_set_add (location_set_t *set,
+                  const char *file,
+                  int line)
+{
+  if (location_set_contains (set, file, line))
+    return;
+
+  uint64_t hash = location_hash (file, line);
+  size_t mask = set->size - 1;
+  size_t i = hash & mask;
+
+  while (set->locations[i].file != NULL)
+    i = (i + 1) & mask;
+
+  set->locations[i].hash = hash;
+  set->locations[i].file = file;
+  set->locations[i].line = line;
+}
+
+// Removes the entries that were not kept, and rebuilds the table
+static void
+timings_rebuild (const bool *keep)
+{
+  timing_entry_t *old_entries = timings.entries;
+  size_t old_size = timings.size;
+
+  timings.entries = calloc (old_size, sizeof (timing_entry_t));
+  if (timings.entries == NULL)
+    mutest_oom_abort ();
+
+  timings.n_entries = 0;
+
+  for (size_t i = 0; i < old_size; i++)
+    {
+      timing_entry_t *entry = &old_entries[i];
+
+      if (entry->file == NULL)
+        continue;
+
+      if (keep[i])
+        timings_insert (entry);
+      else
+        {
+          free (entry->file);
+          free (entry->suite);
+          free (entry->spec);
+        }
+    }
+
+  free (old_entries);
+}
+
+// mutest_timings_prune:
+// @first_suite: the first of the suites of the run
+//
+// Drops the entries of specs that no longer exist: the ones whose file
+// and line now belong to a spec of @first_suite with different
+// descriptions, and the ones that have been missing from the specs of
+// their file for too many runs. Entries of files without any spec in
+// the run are kept, as they may belong to other test programs.
+//
+// Must be called with all the specs of the run, before filtering them.
+void
+mutest_timings_prune (const mutest_suite_t *first_suite)
+{
+  if (timings.path == NULL || timings.n_entries == 0)
+    return;
+
+  size_t n_specs = 0;
+  for (const mutest_suite_t *suite = first_suite; suite != NULL; suite = suite->next)
+    {
+      for (const mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+        n_specs += 1;
+    }
+
+  // Each spec adds its location, and the one of its file
+  location_set_t set = { .size = 64 };
+  while (set.size < n_specs * 4)
+    set.size *= 2;
+
+  set.locations = calloc (set.size, sizeof (location_t));
+  if (set.locations == NULL)
+    mutest_oom_abort ();
+
+  for (const mutest_suite_t *suite = first_suite; suite != NULL; suite = suite->next)
+    {
+      for (const mutest_spec_t *spec = suite->first_spec; spec != NULL; spec = spec->next)
+        {
+          uint64_t hash = timing_hash (spec->file, spec->line,
+                                       suite->description,
+                                       spec->description);
+
+          timing_entry_t *entry = timings_find (hash,
+                                                spec->file, spec->line,
+                                                suite->description,
+                                                spec->description);
+
+          if (entry != NULL)
+            entry->present = true;
+
+          location_set_add (&set, spec->file != NULL ? spec->file : "", spec->line);
+          location_set_add (&set, spec->file != NULL ? spec->file : "", -1);
+        }
+    }
+
+  bool *keep = calloc (timings.size, sizeof (bool));
+  if (keep == NULL)
+    mutest_oom_abort ();
+
+  bool changed = false;
+
+  for (size_t i = 0; i < timings.size; i++)
+    {
+      timing_entry_t *entry = &timings.entries[i];
+
+      if (entry->file == NULL)
+        continue;
+
+      keep[i] = true;
+
+      if (entry->present)
+        {
+          entry->present = false;
+          entry->missing = 0;
+        }
+      else if (location_set_contains (&set, entry->file, entry->line))
+        keep[i] = false;
+      else if (location_set_contains (&set, entry->file, -1))
+        {
+          entry->missing += 1;
+          keep[i] = entry->missing <= MAX_MISSING_RUNS;
+        }
+
+      if (!keep[i])
+        changed = true;
+    }
+
+  if (changed)
+    timings_rebuild (keep);
+
+  free (keep);
+  free (set.locations);
+}
+
+static void
+write_field (FILE *stream,
+             const char *str)
+{
+  fputc ('\t', stream);
+
+  for (const char *p = str != NULL ? str : ""; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '\t':
+          fputs ("\\t", stream);
+          break;
+
+        case '\n':
+          fputs ("\\n", stream);
+          break;
+
+        case '\\':
+          fputs ("\\\\", stream);
+          break;
+
+        default:
+          fputc (*p, stream);
+          break;
+        }
+    }
+}
+
+// mutest_timings_save:
+//
+// Saves the timings database, if mutest_timings_init() was called.
+//
+// The database is written to a temporary file first, and then
+// renamed, so that concurrent runs never see a partial file.
+void
+mutest_timings_save (void)
+{
+  if (timings.path == NULL)
+    return;
+
+  size_t len = strlen (timings.path) + 32;
+  char *tmp_path = malloc (len);
+  if (tmp_path == NULL)
+    mutest_oom_abort ();
+
+  snprintf (tmp_path, len, "%s.tmp.%ld", timings.path, (long) mutest_get_current_time ());
+
+  FILE *stream = fopen (tmp_path, "w");
+  if (stream == NULL)
+    {
+      fprintf (stderr, "WARNING: unable to write timings database '%s': %s\n",
+               tmp_path, strerror (errno));
+      free (tmp_path);
+      return;
+    }
+
+  fputs ("# mutest timings 2\n", stream);
+
+  for (size_t i = 0; i < timings.size; i++)
+    {
+      const timing_entry_t *entry = &timings.entries[i];
+
+      if (entry->file == NULL)
+        continue;
+
+      fprintf (stream, "%lld\t%d", (long long) entry->duration, entry->line);
+      write_field (stream, entry->file);
+      write_field (stream, entry->suite);
+      write_field (stream, entry->spec);
+      fprintf (stream, "\t%d\n", entry->missing);
+    }
+
+  bool res = ferror (stream) == 0;
+
+  if (fclose (stream) != 0)
+    res = false;
+
+  if (!res || rename (tmp_path, timings.path) != 0)
+    {
+      fprintf (stderr, "WARNING: unable to write timings database '%s': %s\n",
+               timings.path, strerror (errno));
+      remove (tmp_path);
+    }
+
+  free (tmp_path);
+}
+
+typedef struct {
+  size_t index;
+  int64_t duration;
+} order_item_t;
+
+static int
+compare_longest_first (const void *a,
+                       const void *b)
+{
+  const order_item_t *item_a = a;
+  const order_item_t *item_b = b;
+
+  // Unknown durations go first, as they may be the longest
+  if (item_a->duration != item_b->duration)
+    {
+      if (item_a->duration < 0)
+        return -1;
+      if (item_b->duration < 0)
+        return 1;
+
+      return item_a->duration > item_b->duration ? -1 : 1;
+    }
+
+  if (item_a->index == item_b->index)
+    return 0;
+
+  return item_a->index < item_b->index ? -1 : 1;
+}
+
+// mutest_timings_order:
+// @suite: a suite
+// @n_specs: the number of specs of @suite
+//
+// Computes the order in which the specs of @suite should be started,
+// so that the longest ones, according to the recorded durations, start
+// first; specs without a recorded duration start before all the others,
+// in declaration order.
+//
+// Returns: (transfer full) (nullable): an array with the declaration
+//   index of each spec, in the order they should be started; or %NULL
+//   if there are no recorded durations, and the specs should be started
+//   in declaration order
+size_t *
+mutest_timings_order (const mutest_suite_t *suite,
+                      size_t n_specs)
+{
+  if (timings.n_entries == 0 || n_specs == 0)
+    return NULL;
+
+  order_item_t *items = calloc (n_specs, sizeof (order_item_t));
+  if (items == NULL)
+    mutest_oom_abort ();
+
+  size_t i = 0;
+  for (const mutest_spec_t *spec = suite->first_spec; spec != NULL && i < n_specs; spec = spec->next)
+    {
+      items[i].index = i;
+      items[i].duration = mutest_timings_lookup (suite, spec);
+      i += 1;
+    }
+
+  qsort (items, n_specs, sizeof (order_item_t), compare_longest_first);
+
+  size_t *res = calloc (n_specs, sizeof (size_t));
+  if (res == NULL)
+    mutest_oom_abort ();
+
+  for (i = 0; i < n_specs; i++)
+    res[i] = items[i].index;
+
+  free (items);
+
+  return res;
+}
@@ -29,6 +29,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(HAVE_SIGNAL_H) && !defined(OS_WINDOWS)
+#include <signal.h>
+#define MUTEST_HAVE_CRASH_HANDLERS 1
+#endif
+
 #ifdef OS_WINDOWS
 #include <windows.h>
 #include <io.h>
@@ -38,37 +43,37 @@
 #include <mach/mach_time.h>
 #endif
 
-// mutest_get_current_time:
+// mutest_get_current_time_ns:
 //
-// Returns: the current time, in microseconds
+// Returns: the current time of the monotonic clock, in nanoseconds
 #ifdef HAVE_QUERY_PERFORMANCE_COUNTER
-static double usec_per_tick;
+static double nsec_per_tick;
 
 int64_t
-mutest_get_current_time (void)
+mutest_get_current_time_ns (void)
 {
-  if (mutest_unlikely (usec_per_tick == 0))
+  if (mutest_unlikely (nsec_per_tick == 0))
     {
       LARGE_INTEGER freq;
 
       if (!QueryPerformanceFrequency (&freq) || freq.QuadPart == 0)
         mutest_assert_if_reached ("QueryPerformanceFrequency failed");
 
-      usec_per_tick = (double) 1000000 / freq.QuadPart;
+      nsec_per_tick = (double) 1000000000 / freq.QuadPart;
     }
 
   LARGE_INTEGER ticks;
 
   if (QueryPerformanceCounter (&ticks))
-    return (int64_t) (ticks.QuadPart * usec_per_tick);
+    return (int64_t) (ticks.QuadPart * nsec_per_tick);
 
-  usec_per_tick = 0;
+  nsec_per_tick = 0;
 
   return 0;
 }
 #elif defined(HAVE_CLOCK_GETTIME)
 int64_t
-mutest_get_current_time (void)
+mutest_get_current_time_ns (void)
 {
   struct timespec ts;
   int res;
@@ -78,35 +83,26 @@ mutest_get_current_time (void)
   if (res != 0)
     return 0;
 
-  return (((int64_t) ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+  return (((int64_t) ts.tv_sec) * 1000000000) + ts.tv_nsec;
 }
 #elif defined(HAVE_MACH_MACH_TIME_H)
 int64_t
-mutest_get_current_time (void)
+mutest_get_current_time_ns (void)
 {
   static mach_timebase_info_data_t timebase_info;
 
   if (timebase_info.denom == 0)
-    {
-      mach_timebase_info (&timebase_info);
+    mach_timebase_info (&timebase_info);
 
-      if (timebase_info.number % 1000 == 0)
-        timebase_info.number /= 1000;
-      else
-        timebase_info.number *= 1000;
+  uint64_t ticks = mach_absolute_time ();
 
-      if (timebase_info.denom % timebase_info.number == 0)
-        {
-          timebase_info.denom /= timebase_info.number;
-          timebase_info.number = 1;
-        }
-    }
-
-  return mach_absolute_time () / timebase_info.denom;
+  // Split the conversion, to avoid overflowing the multiplication
+  return (int64_t) ((ticks / timebase_info.denom) * timebase_info.numer +
+                    (ticks % timebase_info.denom) * timebase_info.numer / timebase_info.denom);
 }
 #elif defined(HAVE_GETTIMEOFDAY)
 int64_t
-mutest_get_current_time (void)
+mutest_get_current_time_ns (void)
 {
   struct timeval r;
 
@@ -114,12 +110,49 @@ mutest_get_current_time (void)
   // but it's likely better than nothing
   gettimeofday (&r, NULL);
 
-  return (((int64_t) r.tv_sec) * 1000000) + r.tv_usec;
+  return (((int64_t) r.tv_sec) * 1000000000) + ((int64_t) r.tv_usec * 1000);
 }
 #else
 # error "muTest requires a monotonic clock implementation"
 #endif
 
+// mutest_get_current_time:
+//
+// Returns: the current time of the monotonic clock, in microseconds
+int64_t
+mutest_get_current_time (void)
+{
+  return mutest_get_current_time_ns () / 1000;
+}
+
+// mutest_hash_string:
+// @hash: the hash to update; use MUTEST_HASH_INIT to start
+// @str: (nullable): the string to add to the hash
+//
+// Adds @str, including its terminator, to @hash, using the 64-bit
+// FNV-1a function.
+//
+// The result does not depend on the platform, so it can be used to
+// identify specs across different machines.
+//
+// Returns: the updated hash
+uint64_t
+mutest_hash_string (uint64_t hash,
+                    const char *str)
+{
+  const unsigned char *p = (const unsigned char *) (str != NULL ? str : "");
+
+  // The terminator separates consecutive strings
+  do
+    {
+      hash ^= *p;
+      hash *= UINT64_C (0x100000001b3);
+    }
+  while (*p++ != '\0');
+
+  return hash;
+}
+
 char *
 mutest_strdup_and_len (const char *str,
                        size_t *len_p)
@@ -133,10 +166,15 @@ mutest_strdup_and_len (const char *str,
     }
 
   size_t len = strlen (str) + 1;
+
+  mutest_alloc_suspend ();
+
   char *res = malloc (len * sizeof (char));
   if (res == NULL)
     mutest_oom_abort ();
 
+  mutest_alloc_resume ();
+
   memcpy (res, str, len);
 
   if (len_p != NULL)
@@ -162,16 +200,71 @@ mutest_strndup (const char *str,
   if (len >= str_len)
     return mutest_strdup (str);
 
+  mutest_alloc_suspend ();
+
   char *res = malloc ((len + 1) * sizeof (char));
   if (res == NULL)
     mutest_oom_abort ();
 
+  mutest_alloc_resume ();
+
   memcpy (res, str, len * sizeof (char));
   res[len] = '\0';
 
   return res;
 }
 
+// mutest_install_crash_handler:
+// @handler: the function to call on a fatal signal
+//
+// Calls @handler when the process receives a fatal signal, on a
+// separate stack, so that stack overflows can be dealt with; the
+// action of the signal is reset to the default one before calling
+// @handler, so it can raise the signal again to terminate the process.
+void
+mutest_install_crash_handler (void (* handler) (int sig))
+{
+#ifdef MUTEST_HAVE_CRASH_HANDLERS
+  static const int fatal_signals[] = {
+    SIGSEGV,
+    SIGBUS,
+    SIGFPE,
+    SIGILL,
+    SIGABRT,
+    SIGTRAP,
+    SIGTERM,
+  };
+
+  // The stack is set for the calling thread
+  static char *alt_stack;
+
+  if (alt_stack == NULL)
+    alt_stack = malloc (SIGSTKSZ);
+
+  if (alt_stack != NULL)
+    {
+      stack_t ss;
+
+      ss.ss_sp = alt_stack;
+      ss.ss_size = SIGSTKSZ;
+      ss.ss_flags = 0;
+      sigaltstack (&ss, NULL);
+    }
+
+  struct sigaction sa;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = handler;
+  sa.sa_flags = SA_RESETHAND | SA_ONSTACK;
+  sigemptyset (&sa.sa_mask);
+
+  for (size_t i = 0; i < sizeof (fatal_signals) / sizeof (fatal_signals[0]); i++)
+    sigaction (fatal_signals[i], &sa, NULL);
+#else
+  (void) handler;
+#endif
+}
+
 char *
 mutest_getenv (const char *str)
 {
@@ -201,36 +294,16 @@ mutest_print (FILE *stream,
   const char *fragment = first_fragment;
   while (fragment != NULL)
     {
-#ifdef OS_WINDOWS
       if (fragment[0] != '\0')
-        fputs (fragment, stream);
-#else
-      if (fragment[0] != '\0')
-        {
-          size_t fragment_len = strlen (fragment);
-          ssize_t res = write (fileno (stream), fragment, fragment_len);
-          if (res < 0)
-            {
-              perror ("write");
-              abort ();
-            }
-        }
-#endif
+        mutest_output_write (stream, fragment, strlen (fragment));
 
       fragment = va_arg (args, char *);
     }
 
   va_end (args);
 
-#ifdef OS_WINDOWS
-  fputc ('\n', stream);
-#else
-  if (write (fileno (stream), "\n", 1) < 0)
-    {
-      perror ("write");
-      abort ();
-    }
-#endif
+  mutest_output_write (stream, "\n", 1);
+  mutest_output_end_line (stream);
 }
 
 void
@@ -249,6 +322,9 @@ mutest_assert_message (const char *file,
    */
   snprintf (lstr, 32, "%d", line);
 
+  // Print the error after the output queued so far, if possible
+  mutest_async_try_sync ();
+
   if (mutest_use_colors ())
     mutest_print (stderr,
                   MUTEST_COLOR_RED, "ERROR", MUTEST_COLOR_NONE, ": ",
@@ -262,29 +338,82 @@ mutest_assert_message (const char *file,
                   message,
                   NULL);
 
+  /* If we are inside an isolated spec, let the runner know */
+  mutest_jobs_worker_abort (file, line, func, message);
+
   abort ();
 }
 
+// mutest_format_time:
+// @t: a time interval, in nanoseconds
+// @unit: (out): return location for the unit of the result
+//
+// Returns: @t scaled to a unit suitable for display
 double
 mutest_format_time (int64_t t,
                     const char **unit)
 {
-  if (t > 1000000)
+  if (t > 1000000000)
     {
       *unit = "s";
+      return (double) t / 1000000000.0;
+    }
+
+  if (t > 1000000)
+    {
+      *unit = "ms";
       return (double) t / 1000000.0;
     }
 
   if (t > 1000)
     {
-      *unit = "ms";
+      *unit = "µs";
       return (double) t / 1000.0;
     }
 
-  *unit = "µs";
+  *unit = "ns";
   return (double) t;
 }
 
+// mutest_format_bench_results:
+// @bench: the results of a benchmark
+// @buf: the buffer to write to
+// @len: the size of @buf
+//
+// Formats the results of a benchmark for display, using the same
+// unit for all the times.
+void
+mutest_format_bench_results (const mutest_bench_results_t *bench,
+                             char *buf,
+                             size_t len)
+{
+  const char *unit = "ns";
+  double scale = 1.0;
+
+  if (bench->median >= 1000000000.0)
+    {
+      unit = "s";
+      scale = 1000000000.0;
+    }
+  else if (bench->median >= 1000000.0)
+    {
+      unit = "ms";
+      scale = 1000000.0;
+    }
+  else if (bench->median >= 1000.0)
+    {
+      unit = "µs";
+      scale = 1000.0;
+    }
+
+  snprintf (buf, len, "%.2f %s/op ± %.2f %s (95%% CI: %.2f–%.2f %s, %d × %lld calls)",
+            bench->median / scale, unit,
+            bench->mad / scale, unit,
+            bench->ci_low / scale, bench->ci_high / scale, unit,
+            bench->n_samples,
+            (long long) bench->iterations);
+}
+
 static char *
 mutest_stpcpy (char *dest,
                const char *src)
@@ -436,68 +565,314 @@ static struct {
     .get_formatter = mutest_get_tap_formatter,
     .formatter = "TAP",
   },
+  [MUTEST_OUTPUT_JSON] = {
+    .get_formatter = mutest_get_json_formatter,
+    .formatter = "JSON",
+  },
+  [MUTEST_OUTPUT_JUNIT] = {
+    .get_formatter = mutest_get_junit_formatter,
+    .formatter = "JUnit XML",
+  },
+  [MUTEST_OUTPUT_BINARY] = {
+    .get_formatter = mutest_get_binary_formatter,
+    .formatter = "binary",
+  },
 };
 
+// Selects the output of the @i-th output format, and returns its
+// formatter; mutest_output_select() must be called with 0 once done
 static const mutest_formatter_t *
-mutest_get_formatter (void)
+select_formatter (const mutest_state_t *state,
+                  int i)
 {
-  mutest_output_format_t format = mutest_get_output_format ();
+  const mutest_output_sink_t *sink = &state->output_sinks[i];
+
+  mutest_output_select (sink->output);
+
+  return output_formatters[sink->format].get_formatter ();
+}
 
-  return output_formatters[format].get_formatter ();
+static void
+notify_listeners (const mutest_state_t *state,
+                  mutest_listener_event_t event,
+                  const mutest_listener_info_t *info)
+{
+  for (int i = 0; i < state->n_listeners; i++)
+    state->listeners[i].func (event, info, state->listeners[i].data);
+}
+
+static void
+listener_info_for_spec (const mutest_state_t *state,
+                        const mutest_spec_t *spec,
+                        mutest_listener_info_t *info)
+{
+  memset (info, 0, sizeof (mutest_listener_info_t));
+
+  info->description = spec->description;
+  info->file = spec->file;
+  info->line = spec->line;
+  info->func_name = spec->func_name;
+  info->pass = spec->pass;
+  info->fail = spec->fail;
+  info->skip = spec->skip;
+  info->skipped = spec->skip_all;
+  info->skip_reason = spec->skip_reason;
+  info->duration = spec->end_time - spec->start_time;
+
+  if (spec->bench.n_samples != 0)
+    {
+      info->has_bench = true;
+      info->bench_iterations = spec->bench.iterations;
+      info->bench_samples = spec->bench.n_samples;
+      info->bench_median = spec->bench.median;
+      info->bench_mad = spec->bench.mad;
+      info->bench_ci_low = spec->bench.ci_low;
+      info->bench_ci_high = spec->bench.ci_high;
+    }
+
+  if (spec->perf.enabled && spec->perf.error == 0)
+    {
+      info->has_counters = true;
+      info->cycles = spec->perf.values[MUTEST_PERF_CYCLES];
+      info->instructions = spec->perf.values[MUTEST_PERF_INSTRUCTIONS];
+      info->branch_misses = spec->perf.values[MUTEST_PERF_BRANCH_MISSES];
+      info->l1d_misses = spec->perf.values[MUTEST_PERF_L1D_MISSES];
+      info->llc_misses = spec->perf.values[MUTEST_PERF_LLC_MISSES];
+    }
+
+  if (state->alloc_stats && spec->alloc.available)
+    {
+      info->has_allocations = true;
+      info->n_allocs = spec->alloc.n_allocs;
+      info->n_frees = spec->alloc.n_frees;
+      info->n_bytes = spec->alloc.n_bytes;
+    }
+}
+
+static void
+listener_info_for_suite (const mutest_suite_t *suite,
+                         mutest_listener_info_t *info)
+{
+  memset (info, 0, sizeof (mutest_listener_info_t));
+
+  info->description = suite->description;
+  info->file = suite->file;
+  info->line = suite->line;
+  info->func_name = suite->func_name;
+  info->pass = suite->pass;
+  info->fail = suite->fail;
+  info->skip = suite->skip;
+  info->n_specs = suite->n_specs;
+  info->skipped = suite->skip_all;
+  info->skip_reason = suite->skip_reason;
+  info->duration = suite->end_time - suite->start_time;
+}
+
+static void
+listener_info_for_expect (const mutest_expect_t *expect,
+                          mutest_listener_info_t *info)
+{
+  memset (info, 0, sizeof (mutest_listener_info_t));
+
+  info->description = expect->description;
+  info->file = expect->file;
+  info->line = expect->line;
+  info->func_name = expect->func_name;
+  info->pass = expect->result == MUTEST_RESULT_PASS ? 1 : 0;
+  info->fail = expect->result == MUTEST_RESULT_FAIL ? 1 : 0;
+  info->skip = expect->result == MUTEST_RESULT_SKIP ? 1 : 0;
+  info->skip_reason = expect->skip_reason;
 }
 
 void
 mutest_format_spec_preamble (mutest_spec_t *spec)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
+
+  if (queue != NULL)
+    {
+      mutest_event_record_spec_preamble (queue, spec);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->spec_preamble != NULL)
+        vtable->spec_preamble (spec);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
 
-  if (vtable->spec_preamble != NULL)
-    vtable->spec_preamble (spec);
+      listener_info_for_spec (state, spec, &info);
+      notify_listeners (state, MUTEST_LISTENER_SPEC_START, &info);
+    }
 }
 
 void
 mutest_format_spec_results (mutest_spec_t *spec)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
+
+  if (queue != NULL)
+    {
+      mutest_event_record_spec_results (queue, spec);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->spec_results != NULL)
+        vtable->spec_results (spec);
+    }
 
-  if (vtable->spec_results != NULL)
-    vtable->spec_results (spec);
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      listener_info_for_spec (state, spec, &info);
+      notify_listeners (state, MUTEST_LISTENER_SPEC_END, &info);
+    }
+
+  mutest_output_end_spec ();
 }
 
 void
 mutest_format_suite_results (mutest_suite_t *suite)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
 
-  if (vtable->suite_results != NULL)
-    vtable->suite_results (suite);
+  if (queue != NULL)
+    {
+      mutest_event_record_suite_results (queue, suite);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->suite_results != NULL)
+        vtable->suite_results (suite);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      listener_info_for_suite (suite, &info);
+      notify_listeners (state, MUTEST_LISTENER_SUITE_END, &info);
+    }
 }
 
 void
 mutest_format_total_results (mutest_state_t *state)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  // The total results are formatted once all the other results are
+  mutest_async_sync ();
 
-  if (vtable->total_results != NULL)
-    vtable->total_results (state);
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->total_results != NULL)
+        vtable->total_results (state);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      memset (&info, 0, sizeof (mutest_listener_info_t));
+
+      mutest_get_results (&info.pass, &info.fail, &info.skip);
+      info.filtered = state->total_filtered;
+      info.cancelled = mutest_is_cancelled ();
+      info.duration = state->end_time - state->start_time;
+
+      notify_listeners (state, MUTEST_LISTENER_RUN_END, &info);
+    }
+
+  mutest_output_flush ();
 }
 
 void
 mutest_format_suite_preamble (mutest_suite_t *suite)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
+
+  if (queue != NULL)
+    {
+      mutest_event_record_suite_preamble (queue, suite);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
 
-  if (vtable->suite_preamble != NULL)
-    vtable->suite_preamble (suite);
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->suite_preamble != NULL)
+        vtable->suite_preamble (suite);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      listener_info_for_suite (suite, &info);
+      notify_listeners (state, MUTEST_LISTENER_SUITE_START, &info);
+    }
 }
 
 void
 mutest_format_main_preamble (void)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->main_preamble != NULL)
+        vtable->main_preamble ();
+    }
+
+  mutest_output_select (0);
 
-  if (vtable->main_preamble != NULL)
-    vtable->main_preamble ();
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      memset (&info, 0, sizeof (mutest_listener_info_t));
+      notify_listeners (state, MUTEST_LISTENER_RUN_START, &info);
+    }
 }
 
 void
@@ -506,17 +881,93 @@ mutest_format_expect_fail (mutest_expect_t *expect,
                            mutest_expect_res_t *check,
                            const char *check_repr)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *recorder = mutest_get_recorder ();
+
+  if (recorder != NULL)
+    {
+      mutest_event_record_expect_fail (recorder, expect, negate, check, check_repr);
+      return;
+    }
+
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
+
+  if (queue != NULL)
+    {
+      mutest_event_record_expect_fail (queue, expect, negate, check, check_repr);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->expect_fail != NULL)
+        vtable->expect_fail (expect, negate, check, check_repr);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+      char *diagnostic = NULL;
+      char *location = NULL;
+
+      mutest_expect_diagnostic (expect, negate, check, check_repr,
+                                &diagnostic,
+                                &location);
 
-  if (vtable->expect_fail != NULL)
-    vtable->expect_fail (expect, negate, check, check_repr);
+      listener_info_for_expect (expect, &info);
+      info.diagnostic = diagnostic;
+      info.location = location;
+
+      notify_listeners (state, MUTEST_LISTENER_EXPECT_DIAGNOSTIC, &info);
+
+      free (diagnostic);
+      free (location);
+    }
 }
 
 void
 mutest_format_expect_result (mutest_expect_t *expect)
 {
-  const mutest_formatter_t *vtable = mutest_get_formatter ();
+  mutest_event_buffer_t *recorder = mutest_get_recorder ();
+
+  if (recorder != NULL)
+    {
+      mutest_event_record_expect_result (recorder, expect);
+      return;
+    }
+
+  mutest_event_buffer_t *queue = mutest_async_get_queue ();
 
-  if (vtable->expect_result != NULL)
-    vtable->expect_result (expect);
+  if (queue != NULL)
+    {
+      mutest_event_record_expect_result (queue, expect);
+      mutest_async_push (queue);
+      return;
+    }
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  for (int i = 0; i < state->n_output_sinks; i++)
+    {
+      const mutest_formatter_t *vtable = select_formatter (state, i);
+
+      if (vtable->expect_result != NULL)
+        vtable->expect_result (expect);
+    }
+
+  mutest_output_select (0);
+
+  if (state->n_listeners > 0)
+    {
+      mutest_listener_info_t info;
+
+      listener_info_for_expect (expect, &info);
+      notify_listeners (state, MUTEST_LISTENER_EXPECT_RESULT, &info);
+    }
 }
@@ -0,0 +1,285 @@
+/* mutest-watchdog.c: Spec timeouts for in-process schedulers
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_CLOCK_GETTIME)
+
+// Specs with a timeout run in worker processes whenever fork() is
+// available, as a worker can be terminated, and the run can continue
+// with the following spec; see mutest_jobs_isolate_spec().
+//
+// Without worker processes, a spec running inside the runner process
+// cannot be interrupted, so when it goes past its timeout the watchdog
+// thread reports it, with the elapsed time and its location, along with
+// the results of the suites completed so far, and terminates the test
+// binary. With the TAP format, the report ends with a "Bail out!" line.
+//
+// Each thread running specs uses its own slot: the serial scheduler
+// uses the slot 0, and each worker of the thread pool uses the slot
+// with the same index as the worker.
+typedef struct {
+  bool armed;
+
+  int64_t start_time;
+  int64_t deadline;
+
+  mutest_suite_t *suite;
+  mutest_spec_t *spec;
+} watch_t;
+
+#define WATCHDOG_MESSAGE_SIZE   2048
+
+static pthread_once_t watchdog_once = PTHREAD_ONCE_INIT;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+
+  watch_t *watches;
+  int n_watches;
+} watchdog;
+
+static void
+watchdog_write (int fd,
+                const char *data,
+                int len)
+{
+  if (len <= 0)
+    return;
+
+  // The message is truncated by snprintf()
+  if ((size_t) len >= WATCHDOG_MESSAGE_SIZE)
+    len = WATCHDOG_MESSAGE_SIZE - 1;
+
+  while (len > 0)
+    {
+      ssize_t res = write (fd, data, (size_t) len);
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return;
+        }
+
+      data += res;
+      len -= (int) res;
+    }
+}
+
+MUTEST_NO_RETURN static void
+watchdog_expire (watch_t *watch,
+                 int64_t now)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+  mutest_suite_t *suite = watch->suite;
+  mutest_spec_t *spec = watch->spec;
+
+  const char *unit;
+  double elapsed = mutest_format_time ((now - watch->start_time) * 1000, &unit);
+
+  // The spec is still running, and may be in the middle of printing
+  // its results; the output buffers are not locked, and only the
+  // thread running the formatters can use them, so the report is
+  // written directly, and whatever the spec did not write out yet is
+  // lost. The totals only include the suites that are done, which are
+  // not changed until the current suite is done as well
+  char message[WATCHDOG_MESSAGE_SIZE];
+  int len;
+
+  len = snprintf (message, WATCHDOG_MESSAGE_SIZE,
+                  "ERROR: %s › %s: spec timed out after %.2f %s (%s:%d)\n"
+                  "ERROR: %d passing, %d failing, %d skipped in the suites completed before the timeout\n",
+                  suite->description,
+                  spec->description,
+                  elapsed, unit,
+                  spec->file, spec->line,
+                  state->total_pass,
+                  state->total_fail,
+                  state->total_skip);
+  watchdog_write (STDERR_FILENO, message, len);
+
+  if (state->output_format == MUTEST_OUTPUT_TAP)
+    {
+      len = snprintf (message, WATCHDOG_MESSAGE_SIZE,
+                      "# %d passing, %d failing, %d skipped in the suites completed before the timeout\n"
+                      "Bail out! %s › %s: spec timed out after %.2f %s (%s:%d)\n",
+                      state->total_pass,
+                      state->total_fail,
+                      state->total_skip,
+                      suite->description,
+                      spec->description,
+                      elapsed, unit,
+                      spec->file, spec->line);
+      watchdog_write (STDOUT_FILENO, message, len);
+    }
+
+  _exit (EXIT_FAILURE);
+}
+
+static void *
+watchdog_thread (void *data MUTEST_UNUSED)
+{
+  pthread_mutex_lock (&watchdog.lock);
+
+  for (;;)
+    {
+      watch_t *next = NULL;
+
+      for (int i = 0; i < watchdog.n_watches; i++)
+        {
+          watch_t *watch = &watchdog.watches[i];
+
+          if (!watch->armed)
+            continue;
+
+          if (next == NULL || watch->deadline < next->deadline)
+            next = watch;
+        }
+
+      if (next == NULL)
+        {
+          pthread_cond_wait (&watchdog.cond, &watchdog.lock);
+          continue;
+        }
+
+      int64_t now = mutest_get_current_time ();
+
+      if (next->deadline <= now)
+        watchdog_expire (next, now);
+
+      // The condition uses the real time clock, while the deadlines
+      // use the monotonic one, so we only wait for the difference
+      int64_t delta = next->deadline - now;
+      struct timespec ts;
+
+      clock_gettime (CLOCK_REALTIME, &ts);
+
+      ts.tv_sec += (time_t) (delta / 1000000);
+      ts.tv_nsec += (long) (delta % 1000000) * 1000;
+      if (ts.tv_nsec >= 1000000000)
+        {
+          ts.tv_sec += 1;
+          ts.tv_nsec -= 1000000000;
+        }
+
+      pthread_cond_timedwait (&watchdog.cond, &watchdog.lock, &ts);
+    }
+
+  return NULL;
+}
+
+static void
+watchdog_init (void)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+
+  watchdog.n_watches = state->n_jobs > 1 ? state->n_jobs : 1;
+  watchdog.watches = calloc (watchdog.n_watches, sizeof (watch_t));
+  if (watchdog.watches == NULL)
+    mutest_oom_abort ();
+
+  pthread_mutex_init (&watchdog.lock, NULL);
+  pthread_cond_init (&watchdog.cond, NULL);
+
+  if (pthread_create (&watchdog.thread, NULL, watchdog_thread, NULL) != 0)
+    mutest_assert_if_reached ("unable to create watchdog thread");
+}
+
+// mutest_watchdog_start:
+// @slot: the slot of the current thread
+// @suite: the suite of @spec
+// @spec: the spec about to be run
+//
+// Starts watching @spec, if it has a timeout.
+void
+mutest_watchdog_start (int slot,
+                       mutest_suite_t *suite,
+                       mutest_spec_t *spec)
+{
+  int64_t timeout = mutest_spec_get_timeout (spec);
+
+  if (timeout <= 0 || spec->skip_all)
+    return;
+
+  pthread_once (&watchdog_once, watchdog_init);
+
+  if (slot < 0 || slot >= watchdog.n_watches)
+    return;
+
+  int64_t now = mutest_get_current_time ();
+
+  pthread_mutex_lock (&watchdog.lock);
+
+  watch_t *watch = &watchdog.watches[slot];
+
+  watch->armed = true;
+  watch->start_time = now;
+  watch->deadline = now + timeout;
+  watch->suite = suite;
+  watch->spec = spec;
+
+  pthread_cond_signal (&watchdog.cond);
+  pthread_mutex_unlock (&watchdog.lock);
+}
+
+// mutest_watchdog_stop:
+// @slot: the slot of the current thread
+// @spec: the spec that was run
+//
+// Stops watching @spec.
+void
+mutest_watchdog_stop (int slot,
+                      mutest_spec_t *spec)
+{
+  if (mutest_spec_get_timeout (spec) <= 0)
+    return;
+
+  pthread_once (&watchdog_once, watchdog_init);
+
+  if (slot < 0 || slot >= watchdog.n_watches)
+    return;
+
+  pthread_mutex_lock (&watchdog.lock);
+  watchdog.watches[slot].armed = false;
+  pthread_mutex_unlock (&watchdog.lock);
+}
+
+#else /* HAVE_PTHREAD_H && HAVE_CLOCK_GETTIME */
+
+// Without threads, timeouts are only enforced by the fork scheduler
+
+void
+mutest_watchdog_start (int slot MUTEST_UNUSED,
+                       mutest_suite_t *suite MUTEST_UNUSED,
+                       mutest_spec_t *spec MUTEST_UNUSED)
+{
+}
+
+void
+mutest_watchdog_stop (int slot MUTEST_UNUSED,
+                      mutest_spec_t *spec MUTEST_UNUSED)
+{
+}
+
+#endif /* HAVE_PTHREAD_H && HAVE_CLOCK_GETTIME */
@@ -32,14 +32,23 @@ mutest_expect_res_free (mutest_expect_res_t *res)
     case MUTEST_EXPECT_FLOAT:
     case MUTEST_EXPECT_FLOAT_RANGE:
     case MUTEST_EXPECT_POINTER:
+    case MUTEST_EXPECT_CLOSURE:
       break;
 
     case MUTEST_EXPECT_STR:
-      free (res->expect.v_str.str);
+      mutest_arena_free (res->expect.v_str.str);
+      break;
+
+    case MUTEST_EXPECT_BYTE_ARRAY:
+      mutest_arena_free (res->expect.v_bytearray.data);
+      break;
+
+    case MUTEST_EXPECT_ARRAY:
+      mutest_arena_free (res->expect.v_array.reported);
       break;
     }
 
-  free (res);
+  mutest_arena_free (res);
 }
 
 void
@@ -112,21 +121,71 @@ mutest_expect_res_to_string (mutest_expect_res_t *res,
     case MUTEST_EXPECT_STR:
       snprintf (buf, len, "%s", res->expect.v_str.str);
       break;
+
+    case MUTEST_EXPECT_CLOSURE:
+      if (res->expect.v_closure.called && res->expect.v_closure.alloc.available)
+        snprintf (buf, len, "%lld allocations (%lld bytes)",
+                  (long long) res->expect.v_closure.alloc.n_allocs,
+                  (long long) res->expect.v_closure.alloc.n_bytes);
+      else
+        snprintf (buf, len, "closure");
+      break;
+
+    case MUTEST_EXPECT_BYTE_ARRAY:
+      mutest_format_byte_array (res, buf, len);
+      break;
+
+    case MUTEST_EXPECT_ARRAY:
+      mutest_format_array (res, buf, len);
+      break;
     }
 }
 
+// Values are allocated from the arena of the current thread, as they
+// only live until the end of the expectation that consumes them
 mutest_expect_res_t *
 mutest_expect_res_alloc (mutest_expect_type_t type)
 {
-  mutest_expect_res_t *retval = calloc (1, sizeof (mutest_expect_res_t));
-  if (retval == NULL)
-    mutest_oom_abort ();
+  // The arena allocates a new chunk when it's full
+  mutest_alloc_suspend ();
+
+  mutest_expect_res_t *retval = mutest_arena_alloc (sizeof (mutest_expect_res_t));
+
+  mutest_alloc_resume ();
 
   retval->expect_type = type;
 
   return retval;
 }
 
+// mutest_expect_res_set_string:
+// @res: a string value
+// @str: (nullable): the string to copy
+//
+// Copies @str inside the arena, and stores it in @res.
+void
+mutest_expect_res_set_string (mutest_expect_res_t *res,
+                              const char *str)
+{
+  if (str == NULL)
+    {
+      res->expect.v_str.str = NULL;
+      res->expect.v_str.len = 0;
+      return;
+    }
+
+  size_t len = strlen (str);
+
+  mutest_alloc_suspend ();
+
+  res->expect.v_str.str = mutest_arena_alloc (len + 1);
+
+  mutest_alloc_resume ();
+
+  memcpy (res->expect.v_str.str, str, len + 1);
+  res->expect.v_str.len = len;
+}
+
 mutest_expect_res_t *
 mutest_bool_value (bool value)
 {
@@ -173,7 +232,7 @@ mutest_string_value (const char *value)
 {
   mutest_expect_res_t *res = mutest_expect_res_alloc (MUTEST_EXPECT_STR);
 
-  res->expect.v_str.str = mutest_strdup_and_len (value, &(res->expect.v_str.len));
+  mutest_expect_res_set_string (res, value);
 
   return res;
 }
@@ -278,17 +337,28 @@ mutest_get_pointer (const mutest_expect_res_t *res)
   return res->expect.v_pointer;
 }
 
-#if 0
 mutest_expect_res_t *
-mutest_byte_array (void *data,
+mutest_closure (mutest_expect_closure_func_t func,
+                void *data)
+{
+  if (func == NULL)
+    mutest_assert_if_reached ("invalid closure");
+
+  mutest_expect_res_t *res = mutest_expect_res_alloc (MUTEST_EXPECT_CLOSURE);
+
+  res->expect.v_closure.func = func;
+  res->expect.v_closure.data = data;
+
+  return res;
+}
+
+mutest_expect_res_t *
+mutest_byte_array (const void *data,
                    size_t element_size,
                    size_t length)
 {
-  mutest_expect_res_t *res = malloc (sizeof (mutest_expect_res_t));
-  if (res == NULL)
-    mutest_oom_abort ();
+  mutest_expect_res_t *res = mutest_expect_res_alloc (MUTEST_EXPECT_BYTE_ARRAY);
 
-  res->expect_type = MUTEST_EXPECT_BYTE_ARRAY;
   res->expect.v_bytearray.data = NULL;
   res->expect.v_bytearray.element_size = element_size;
   res->expect.v_bytearray.length = length;
@@ -296,6 +366,9 @@ mutest_byte_array (void *data,
   if (element_size == 0 || length == 0)
     return res;
 
+  if (data == NULL)
+    mutest_assert_if_reached ("invalid byte array");
+
   size_t max_size = (size_t) -1;
 
   if (element_size > 0 && length > max_size / element_size)
@@ -303,27 +376,90 @@ mutest_byte_array (void *data,
 
   size_t total_size = element_size * length;
 
-  res->expect.v_bytearray.data = malloc (total_size);
-  if (res->expect.v_bytearray.data == NULL)
-    mutest_oom_abort ();
+  mutest_alloc_suspend ();
+
+  res->expect.v_bytearray.data = mutest_arena_alloc (total_size);
+
+  mutest_alloc_resume ();
 
   memcpy (res->expect.v_bytearray.data, data, total_size);
 
+  res->expect.v_bytearray.data_offset = 0;
+  res->expect.v_bytearray.data_size = total_size;
+
   return res;
 }
 
-mutest_expect_res_t *
-mutest_closure (mutest_expect_closure_func_t func,
-                void *data)
+const void *
+mutest_get_byte_array (const mutest_expect_res_t *res,
+                       size_t *element_size,
+                       size_t *length)
 {
-  mutest_expect_res_t *res = malloc (sizeof (mutest_expect_res_t));
-  if (res == NULL)
-    mutest_oom_abort ();
+  if (res->expect_type != MUTEST_EXPECT_BYTE_ARRAY)
+    mutest_assert_if_reached ("invalid byte array");
 
-  res->expect_type = MUTEST_EXPECT_CLOSURE;
-  res->expect.v_closure.func = func;
-  res->expect.v_closure.data = data;
+  if (element_size != NULL)
+    *element_size = res->expect.v_bytearray.element_size;
+  if (length != NULL)
+    *length = res->expect.v_bytearray.length;
+
+  return res->expect.v_bytearray.data;
+}
+
+static mutest_expect_res_t *
+mutest_array_new (mutest_array_type_t array_type,
+                  const void *data,
+                  size_t length)
+{
+  if (data == NULL && length > 0)
+    mutest_assert_if_reached ("invalid array");
+
+  mutest_expect_res_t *res = mutest_expect_res_alloc (MUTEST_EXPECT_ARRAY);
+
+  res->expect.v_array.array_type = array_type;
+  res->expect.v_array.data = data;
+  res->expect.v_array.length = length;
 
   return res;
 }
-#endif
+
+mutest_expect_res_t *
+mutest_int32_array (const int32_t *data,
+                    size_t length)
+{
+  return mutest_array_new (MUTEST_ARRAY_INT32, data, length);
+}
+
+mutest_expect_res_t *
+mutest_int64_array (const int64_t *data,
+                    size_t length)
+{
+  return mutest_array_new (MUTEST_ARRAY_INT64, data, length);
+}
+
+mutest_expect_res_t *
+mutest_float_array (const float *data,
+                    size_t length)
+{
+  return mutest_array_new (MUTEST_ARRAY_FLOAT, data, length);
+}
+
+mutest_expect_res_t *
+mutest_double_array (const double *data,
+                     size_t length)
+{
+  return mutest_array_new (MUTEST_ARRAY_DOUBLE, data, length);
+}
+
+const void *
+mutest_get_array (const mutest_expect_res_t *res,
+                  size_t *length)
+{
+  if (res->expect_type != MUTEST_EXPECT_ARRAY)
+    mutest_assert_if_reached ("invalid array");
+
+  if (length != NULL)
+    *length = res->expect.v_array.length;
+
+  return res->expect.v_array.data;
+}
@@ -0,0 +1,244 @@
+#include <mutest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// The listener of this test checks the allocations of each spec, which
+// are only reported with MUTEST_ALLOC_STATS set; if the allocations
+// cannot be counted, for instance when running under a sanitizer, the
+// test is skipped
+
+#define MESON_SKIP_TEST 77
+
+typedef struct {
+  const char *description;
+
+  bool seen;
+  bool has_allocations;
+  int fail;
+  int skip;
+  int64_t n_allocs;
+  int64_t n_frees;
+  int64_t n_bytes;
+} spec_allocs_t;
+
+static spec_allocs_t specs[] = {
+  { .description = "does not count the allocations of expectations" },
+  { .description = "counts its own allocations" },
+  { .description = "checks closures that do not allocate" },
+  { .description = "checks closures that allocate" },
+  { .description = "counts its aligned allocations" },
+};
+
+#define N_SPECS (sizeof (specs) / sizeof (specs[0]))
+
+static void
+collect_allocs (mutest_listener_event_t event,
+                const mutest_listener_info_t *info,
+                void *data MUTEST_UNUSED)
+{
+  if (event != MUTEST_LISTENER_SPEC_END)
+    return;
+
+  for (size_t i = 0; i < N_SPECS; i++)
+    {
+      if (strcmp (info->description, specs[i].description) != 0)
+        continue;
+
+      specs[i].seen = true;
+      specs[i].has_allocations = info->has_allocations;
+      specs[i].fail = info->fail;
+      specs[i].skip = info->skip;
+      specs[i].n_allocs = info->n_allocs;
+      specs[i].n_frees = info->n_frees;
+      specs[i].n_bytes = info->n_bytes;
+    }
+}
+
+// Keep the compiler from eliding the allocations
+static void *(* volatile alloc_func) (size_t) = malloc;
+static void (* volatile free_func) (void *) = free;
+
+static void
+allocate_twice (void *data MUTEST_UNUSED)
+{
+  void *a = alloc_func (16);
+  void *b = alloc_func (16);
+
+  free_func (a);
+  free_func (b);
+}
+
+static void
+do_nothing (void *data MUTEST_UNUSED)
+{
+}
+
+static void
+expectations_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("string values to not count",
+                 mutest_string_value ("hello, world"),
+                 mutest_to_start_with_string, "hello",
+                 mutest_to_contain, ",",
+                 NULL);
+  mutest_expect ("negated expectations to not count",
+                 mutest_string_value ("hello"),
+                 mutest_not, mutest_to_be, "world",
+                 NULL);
+  mutest_expect ("closures to not count",
+                 mutest_closure (do_nothing, NULL),
+                 mutest_to_not_allocate,
+                 NULL);
+}
+
+static void
+own_allocations_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  void *a = alloc_func (16);
+
+  mutest_expect ("allocations around expectations to count",
+                 mutest_pointer (a),
+                 mutest_not, mutest_to_be_null,
+                 NULL);
+
+  void *b = alloc_func (16);
+  void *c = alloc_func (16);
+
+  free_func (a);
+  free_func (b);
+  free_func (c);
+}
+
+static void
+no_allocations_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to not allocate",
+                 mutest_closure (do_nothing, NULL),
+                 mutest_to_not_allocate,
+                 NULL);
+  mutest_expect ("to allocate at most zero times",
+                 mutest_closure (do_nothing, NULL),
+                 mutest_to_allocate_at_most, 0,
+                 NULL);
+  mutest_expect ("to allocate",
+                 mutest_closure (allocate_twice, NULL),
+                 mutest_not, mutest_to_not_allocate,
+                 NULL);
+}
+
+static void
+allocations_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to allocate at most twice",
+                 mutest_closure (allocate_twice, NULL),
+                 mutest_to_allocate_at_most, 2,
+                 NULL);
+  mutest_expect ("to allocate more than once",
+                 mutest_closure (allocate_twice, NULL),
+                 mutest_not, mutest_to_allocate_at_most, 1,
+                 NULL);
+}
+
+static void
+aligned_allocations_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+#ifdef __GLIBC__
+  void *a = NULL;
+  int res = posix_memalign (&a, 64, 32);
+
+  void *b = aligned_alloc (64, 64);
+
+  mutest_expect ("posix_memalign() to succeed",
+                 mutest_int_value (res),
+                 mutest_to_be, 0,
+                 NULL);
+  mutest_expect ("aligned_alloc() to succeed",
+                 mutest_pointer (b),
+                 mutest_not, mutest_to_be_null,
+                 NULL);
+
+  free_func (a);
+  free_func (b);
+#endif
+}
+
+static void
+alloc_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it (specs[0].description, expectations_spec);
+  mutest_it (specs[1].description, own_allocations_spec);
+  mutest_it (specs[2].description, no_allocations_spec);
+  mutest_it (specs[3].description, allocations_spec);
+  mutest_it (specs[4].description, aligned_allocations_spec);
+}
+
+static bool
+check_allocs (const spec_allocs_t *spec,
+              int64_t n_allocs,
+              int64_t n_frees,
+              int64_t n_bytes)
+{
+  if (spec->n_allocs == n_allocs &&
+      spec->n_frees == n_frees &&
+      (n_bytes < 0 || spec->n_bytes == n_bytes))
+    return true;
+
+  fprintf (stderr, "FAIL: %s: expected %lld allocations and %lld frees, "
+                   "got %lld allocations (%lld bytes) and %lld frees\n",
+           spec->description,
+           (long long) n_allocs,
+           (long long) n_frees,
+           (long long) spec->n_allocs,
+           (long long) spec->n_bytes,
+           (long long) spec->n_frees);
+
+  return false;
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  mutest_init_with_args (argc, argv);
+
+  mutest_add_listener (collect_allocs, NULL);
+
+  mutest_describe ("Allocations", alloc_suite);
+
+  mutest_report ();
+
+  bool res = true;
+
+  for (size_t i = 0; i < N_SPECS; i++)
+    {
+      if (!specs[i].seen)
+        {
+          fprintf (stderr, "FAIL: %s: not run\n", specs[i].description);
+          return EXIT_FAILURE;
+        }
+
+      if (!specs[i].has_allocations)
+        {
+          fprintf (stderr, "SKIP: the allocations cannot be counted\n");
+          return MESON_SKIP_TEST;
+        }
+
+      if (specs[i].fail > 0 || specs[i].skip > 0)
+        {
+          fprintf (stderr, "FAIL: %s: %d failed and %d skipped expectations\n",
+                   specs[i].description,
+                   specs[i].fail,
+                   specs[i].skip);
+          res = false;
+        }
+    }
+
+  res &= check_allocs (&specs[0], 0, 0, 0);
+  res &= check_allocs (&specs[1], 3, 3, 48);
+  res &= check_allocs (&specs[2], 2, 2, 32);
+  res &= check_allocs (&specs[3], 4, 4, 64);
+  res &= check_allocs (&specs[4], 2, 2, 96);
+
+  return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}
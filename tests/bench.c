@@ -0,0 +1,53 @@
+#include <mutest.h>
+
+#include <time.h>
+
+// The tests using this test check the results of the benchmarks, and
+// the durations measured by the clock selected with MUTEST_CLOCK; the
+// sleeping spec takes no CPU time, but it takes some wall clock time.
+
+#define N_VALUES        256
+
+static int values[N_VALUES];
+
+static void
+sum_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  volatile int sum = 0;
+
+  for (int i = 0; i < N_VALUES; i++)
+    sum += values[i];
+
+  mutest_expect ("the sum to be right",
+                 mutest_int_value (sum),
+                 mutest_to_be, N_VALUES * (N_VALUES - 1) / 2,
+                 NULL);
+}
+
+static void
+sleep_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  struct timespec ts = {
+    .tv_sec = 0,
+    .tv_nsec = 50 * 1000 * 1000,
+  };
+
+  mutest_expect ("to sleep",
+                 mutest_int_value (nanosleep (&ts, NULL)),
+                 mutest_to_be, 0,
+                 NULL);
+}
+
+static void
+bench_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  for (int i = 0; i < N_VALUES; i++)
+    values[i] = i;
+
+  mutest_bench ("sums an array", sum_spec);
+  mutest_it ("sleeps", sleep_spec);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Benchmarks", bench_suite);
+)
@@ -0,0 +1,326 @@
+#!/usr/bin/env python3
+
+# Runs a test, and checks its output and its exit status
+#
+# Usage: check-output.py [OPTIONS] -- COMMAND [ARGS...]
+
+import argparse
+import collections
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import xml.etree.ElementTree as ElementTree
+
+
+def check_tap_plan(lines):
+    plans = [l for l in lines if re.match(r'^1\.\.\d+', l)]
+    if len(plans) != 1:
+        return 'expected one TAP plan, found {}'.format(len(plans))
+
+    n_planned = int(re.match(r'^1\.\.(\d+)', plans[0]).group(1))
+    n_results = len([l for l in lines if re.match(r'^(not )?ok \d+', l)])
+    if n_planned != n_results:
+        return 'the TAP plan is 1..{}, but there are {} results'.format(n_planned, n_results)
+
+    return None
+
+
+# Checks that every line is a JSON object, and returns the events
+def parse_json_lines(lines):
+    events = []
+    errors = []
+
+    for n, line in enumerate(lines, 1):
+        try:
+            event = json.loads(line)
+        except ValueError as e:
+            errors.append('line {} is not valid JSON: {}: {}'.format(n, e, line))
+            continue
+
+        if not isinstance(event, dict) or 'event' not in event:
+            errors.append('line {} is not an event: {}'.format(n, line))
+            continue
+
+        events.append(event)
+
+    return events, errors
+
+
+# Checks that the JUnit report is well-formed, and that the counts of
+# each suite match its test cases; returns the test cases
+def parse_junit(output):
+    errors = []
+
+    try:
+        root = ElementTree.fromstring(output)
+    except ElementTree.ParseError as e:
+        return [], ['the JUnit report is not well-formed: {}'.format(e)]
+
+    if root.tag != 'testsuites':
+        return [], ['the root of the JUnit report is <{}>'.format(root.tag)]
+
+    testcases = []
+
+    for suite in root.findall('testsuite'):
+        cases = suite.findall('testcase')
+        counts = {
+            'tests': len(cases),
+            'failures': len([c for c in cases if c.find('failure') is not None]),
+            'errors': len([c for c in cases if c.find('error') is not None]),
+            'skipped': len([c for c in cases if c.find('skipped') is not None]),
+        }
+
+        for attr, count in counts.items():
+            if suite.get(attr) != str(count):
+                errors.append('suite "{}" has {}="{}", but {} test cases'.format(
+                    suite.get('name'), attr, suite.get(attr), count))
+
+        testcases += cases
+
+    return testcases, errors
+
+
+def json_specs(output):
+    specs = collections.Counter()
+    suite = None
+
+    for line in output.splitlines():
+        event = json.loads(line)
+        if event['event'] == 'suite':
+            suite = event['description']
+        elif event['event'] == 'spec':
+            specs[(suite, event['description'], event['file'], event['line'])] += 1
+
+    return specs
+
+
+def run_json(command, env=None):
+    full_env = dict(os.environ, MUTEST_OUTPUT='json')
+    if env is not None:
+        full_env.update(env)
+
+    proc = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True, env=full_env)
+
+    return json_specs(proc.stdout)
+
+
+# The events of a run, without the durations, which change between runs
+def json_events(output):
+    events = []
+
+    for line in output.splitlines():
+        event = json.loads(line)
+        events.append(json.dumps({k: v for k, v in event.items() if not k.endswith('duration_ns')},
+                                  sort_keys=True))
+
+    return events
+
+
+def run_events(command, env=None):
+    full_env = dict(os.environ, MUTEST_OUTPUT='json')
+    if env is not None:
+        full_env.update(env)
+
+    proc = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True, env=full_env)
+
+    return json_events(proc.stdout), proc.returncode
+
+
+# Writes the binary logs of a run, or of each of its shards, and renders
+# them with the results tool
+def render_logs(command, results_tool, tmpdir, n_shards):
+    full_env = dict(os.environ, MUTEST_OUTPUT='binary')
+    logs = []
+
+    for i in range(max(n_shards, 1)):
+        if n_shards > 0:
+            full_env['MUTEST_SHARD_COUNT'] = str(n_shards)
+            full_env['MUTEST_SHARD_INDEX'] = str(i)
+
+        path = os.path.join(tmpdir, 'shard-{}.log'.format(i))
+        with open(path, 'wb') as f:
+            subprocess.run(command, stdout=f, env=full_env)
+
+        logs.append(path)
+
+    proc = subprocess.run([results_tool] + logs, stdout=subprocess.PIPE, universal_newlines=True,
+                          env=dict(os.environ, MUTEST_OUTPUT='json'))
+
+    return json_events(proc.stdout), proc.returncode
+
+
+# Checks that rendering the binary logs of a run gives the same events
+# and exit status as running it with the JSON format; the order of the specs of merged
+# shards follows the logs, so only their counts are compared
+def check_results(command, results_tool, n_shards):
+    errors = []
+
+    expected, expected_status = run_events(command)
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        rendered, status = render_logs(command, results_tool, tmpdir, n_shards)
+
+    if status != expected_status:
+        errors.append('expected exit status {} from the results tool, got {}'.format(expected_status, status))
+
+    if n_shards > 0:
+        expected = collections.Counter(expected)
+        rendered = collections.Counter(rendered)
+
+    if rendered != expected:
+        if n_shards > 0:
+            missing = sorted((expected - rendered).elements())
+            extra = sorted((rendered - expected).elements())
+        else:
+            missing = [e for e in expected if e not in rendered]
+            extra = [e for e in rendered if e not in expected]
+
+        errors.append('the rendered logs do not match the run')
+        errors += ['missing: ' + e for e in missing]
+        errors += ['unexpected: ' + e for e in extra]
+
+    return errors
+
+
+# Checks that the shards of a run cover every spec exactly once, and
+# that specs with the same name are not all assigned to the same shard;
+# the exit status of each shard depends on the specs it runs, so it is
+# not checked
+def check_shards(command, n_shards):
+    errors = []
+
+    all_specs = run_json(command)
+    shards = [run_json(command, {
+        'MUTEST_SHARD_COUNT': str(n_shards),
+        'MUTEST_SHARD_INDEX': str(i),
+    }) for i in range(n_shards)]
+
+    covered = collections.Counter()
+    for shard in shards:
+        covered.update(shard)
+
+    if covered != all_specs:
+        missing = all_specs - covered
+        extra = covered - all_specs
+        if missing:
+            errors.append('specs not run by any shard: {}'.format(sorted(missing)))
+        if extra:
+            errors.append('specs run by more than one shard: {}'.format(sorted(extra)))
+
+    for spec, count in all_specs.items():
+        if count > 1 and any(shard[spec] == count for shard in shards):
+            errors.append('all the specs named {} are in the same shard'.format(spec))
+
+    return errors
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--status', type=int, default=0,
+                        help='the expected exit status')
+    parser.add_argument('--match', action='append', default=[],
+                        help='a regular expression matching a line of the output')
+    parser.add_argument('--no-match', action='append', default=[],
+                        help='a regular expression matching no line of the output')
+    parser.add_argument('--match-stderr', action='append', default=[],
+                        help='a regular expression matching a line of the error output')
+    parser.add_argument('--tap-plan', action='store_true',
+                        help='check that the TAP plan covers the results')
+    parser.add_argument('--max-results', type=int, default=-1,
+                        help='the maximum number of TAP results')
+    parser.add_argument('--format', choices=['json', 'junit'],
+                        help='check that the output is valid in this format')
+    parser.add_argument('--description', action='append', default=[],
+                        help='a description that must appear in the output, after parsing it')
+    parser.add_argument('--shards', type=int, default=0,
+                        help='check that this number of shards covers every spec once')
+    parser.add_argument('--results',
+                        help='the results tool, to check the binary logs of the run, or of its shards')
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command
+    if command and command[0] == '--':
+        command = command[1:]
+
+    if args.results is not None:
+        errors = check_results(command, args.results, args.shards)
+        for error in errors:
+            print('FAIL: ' + error, file=sys.stderr)
+        return 1 if errors else 0
+
+    if args.shards > 0:
+        errors = check_shards(command, args.shards)
+        for error in errors:
+            print('FAIL: ' + error, file=sys.stderr)
+        return 1 if errors else 0
+
+    proc = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          universal_newlines=True)
+    lines = proc.stdout.splitlines()
+    error_lines = proc.stderr.splitlines()
+
+    errors = []
+
+    if proc.returncode != args.status:
+        errors.append('expected exit status {}, got {}'.format(args.status, proc.returncode))
+
+    for pattern in args.match:
+        if not any(re.search(pattern, l) for l in lines):
+            errors.append('no line matches "{}"'.format(pattern))
+
+    for pattern in args.match_stderr:
+        if not any(re.search(pattern, l) for l in error_lines):
+            errors.append('no line of the error output matches "{}"'.format(pattern))
+
+    for pattern in args.no_match:
+        if any(re.search(pattern, l) for l in lines):
+            errors.append('a line matches "{}"'.format(pattern))
+
+    if args.tap_plan:
+        error = check_tap_plan(lines)
+        if error is not None:
+            errors.append(error)
+
+    if args.format == 'json':
+        events, json_errors = parse_json_lines(lines)
+        errors += json_errors
+
+        descriptions = set(e.get('description') for e in events)
+        for description in args.description:
+            if description not in descriptions:
+                errors.append('no event has the description {!r}'.format(description))
+
+    if args.format == 'junit':
+        testcases, junit_errors = parse_junit(proc.stdout)
+        errors += junit_errors
+
+        n_specs = sum(run_json(command).values())
+        if len(testcases) != n_specs:
+            errors.append('expected {} test cases, got {}'.format(n_specs, len(testcases)))
+
+        names = set(c.get('name') for c in testcases)
+        for description in args.description:
+            if description not in names:
+                errors.append('no test case has the name {!r}'.format(description))
+
+    if args.max_results >= 0:
+        n_results = len([l for l in lines if re.match(r'^(not )?ok \d+', l)])
+        if n_results > args.max_results:
+            errors.append('expected at most {} results, got {}'.format(args.max_results, n_results))
+
+    if errors:
+        sys.stdout.write(proc.stdout)
+        sys.stderr.write(proc.stderr)
+        for error in errors:
+            print('FAIL: ' + error, file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
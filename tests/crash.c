@@ -0,0 +1,153 @@
+#include <mutest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// The specs of this test crash on purpose, so it runs them in worker
+// processes, with MUTEST_ISOLATE, and checks how their failures are
+// reported, using a listener, instead of using the exit status of
+// the run.
+
+static struct {
+  // The description of the failure of each crashing spec
+  char segfault[1024];
+  char abort[1024];
+  char assertion[1024];
+
+  int n_crashed;
+  int n_passed;
+  int n_slow_crashes;
+
+  // The description of the last failed expectation
+  char failure[1024];
+} results;
+
+static void
+collect_results (mutest_listener_event_t event,
+                 const mutest_listener_info_t *info,
+                 void *data MUTEST_UNUSED)
+{
+  switch (event)
+    {
+    case MUTEST_LISTENER_EXPECT_RESULT:
+      if (info->fail > 0)
+        snprintf (results.failure, sizeof (results.failure), "%s", info->description);
+      break;
+
+    case MUTEST_LISTENER_SPEC_END:
+      if (info->fail == 0)
+        {
+          results.n_passed += 1;
+          break;
+        }
+
+      results.n_crashed += 1;
+
+      // Crashed specs take the time their worker ran for
+      if (info->duration > 0)
+        results.n_slow_crashes += 1;
+
+      if (strcmp (info->description, "segfaults") == 0)
+        memcpy (results.segfault, results.failure, sizeof (results.failure));
+      else if (strcmp (info->description, "aborts") == 0)
+        memcpy (results.abort, results.failure, sizeof (results.failure));
+      else if (strcmp (info->description, "fails an assertion") == 0)
+        memcpy (results.assertion, results.failure, sizeof (results.failure));
+
+      results.failure[0] = '\0';
+      break;
+
+    case MUTEST_LISTENER_RUN_START:
+    case MUTEST_LISTENER_SUITE_START:
+    case MUTEST_LISTENER_SPEC_START:
+    case MUTEST_LISTENER_EXPECT_DIAGNOSTIC:
+    case MUTEST_LISTENER_SUITE_END:
+    case MUTEST_LISTENER_RUN_END:
+      break;
+    }
+}
+
+static void
+segfault_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to run before the crash",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+
+  volatile int *p = NULL;
+
+  *p = 42;
+}
+
+static void
+abort_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  abort ();
+}
+
+static void
+assertion_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  // A NULL value is a programming error, which aborts the spec
+  mutest_expect ("to fail an assertion", NULL, mutest_to_be_true, NULL);
+}
+
+static void
+pass_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to run after the crashes",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+crash_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("segfaults", segfault_spec);
+  mutest_it ("aborts", abort_spec);
+  mutest_it ("fails an assertion", assertion_spec);
+  mutest_it ("passes", pass_spec);
+}
+
+static bool
+check (bool condition,
+       const char *what,
+       const char *value)
+{
+  if (!condition)
+    fprintf (stderr, "FAIL: %s: '%s'\n", what, value != NULL ? value : "");
+
+  return condition;
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  mutest_init_with_args (argc, argv);
+
+  mutest_add_listener (collect_results, NULL);
+
+  mutest_describe ("Crashing specs", crash_suite);
+
+  mutest_report ();
+
+  bool res = true;
+
+  res &= check (results.n_crashed == 3, "three specs to crash", NULL);
+  res &= check (results.n_passed == 1, "the run to continue after the crashes", NULL);
+  res &= check (results.n_slow_crashes == 3, "the crashes to have a duration", NULL);
+  res &= check (strstr (results.segfault, "SIGSEGV") != NULL, "the signal of the segfault", results.segfault);
+  res &= check (strstr (results.segfault, "after the expectation at segfault_spec") != NULL,
+                "the location of the segfault", results.segfault);
+  res &= check (strstr (results.segfault, "crash.c:") != NULL, "the file of the segfault", results.segfault);
+  res &= check (strstr (results.abort, "SIGABRT") != NULL, "the signal of the abort", results.abort);
+  res &= check (strstr (results.abort, "before any expectation") != NULL, "the location of the abort", results.abort);
+  res &= check (strstr (results.assertion, "SIGABRT") != NULL, "the signal of the assertion", results.assertion);
+  res &= check (strstr (results.assertion, ": invalid data pointer at mutest_expect_full") != NULL,
+                "the message and location of the assertion", results.assertion);
+
+  return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}
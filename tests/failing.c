@@ -0,0 +1,175 @@
+#include <mutest.h>
+
+// Some of the specs of this test fail on purpose, so the tests using
+// it check the output of the run instead of its exit status; the first
+// failure is in the first suite, and the specs of the last suite show
+// the diagnostics of failed expectations
+
+static void
+pass_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to pass",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+fail_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to fail",
+                 mutest_bool_value (false),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+fill_bytes (unsigned char *a,
+            unsigned char *b,
+            size_t len,
+            size_t mismatch)
+{
+  for (size_t i = 0; i < len; i++)
+    a[i] = b[i] = (unsigned char) i;
+
+  if (mismatch < len)
+    b[mismatch] = 0xff;
+}
+
+// The bytes are compared 32 at a time with AVX2, and 16 at a time with
+// SSE2, before the tail
+static void
+byte_array_avx2_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  unsigned char a[123], b[123];
+
+  fill_bytes (a, b, sizeof (a), 50);
+
+  mutest_expect ("to differ in the AVX2 range",
+                 mutest_byte_array (a, 1, sizeof (a)),
+                 mutest_to_be, mutest_byte_array (b, 1, sizeof (b)),
+                 NULL);
+}
+
+static void
+byte_array_sse2_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  unsigned char a[123], b[123];
+
+  fill_bytes (a, b, sizeof (a), 100);
+
+  mutest_expect ("to differ in the SSE2 range",
+                 mutest_byte_array (a, 1, sizeof (a)),
+                 mutest_to_be, mutest_byte_array (b, 1, sizeof (b)),
+                 NULL);
+}
+
+static void
+byte_array_tail_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  unsigned char a[123], b[123];
+
+  fill_bytes (a, b, sizeof (a), 121);
+
+  mutest_expect ("to differ in the tail",
+                 mutest_byte_array (a, 1, sizeof (a)),
+                 mutest_to_be, mutest_byte_array (b, 1, sizeof (b)),
+                 NULL);
+}
+
+static void
+byte_array_size_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  unsigned char a[123], b[123];
+
+  fill_bytes (a, b, sizeof (a), sizeof (a));
+
+  mutest_expect ("to differ in size",
+                 mutest_byte_array (a, 1, 64),
+                 mutest_to_be, mutest_byte_array (b, 1, sizeof (b)),
+                 NULL);
+}
+
+static void
+int64_array_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  int64_t a[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  int64_t b[8] = { 1, 2, -3, 4, 5, -6, 7, 8 };
+
+  mutest_expect ("to differ in two elements",
+                 mutest_int64_array (a, 8),
+                 mutest_to_have_equal_elements, mutest_int64_array (b, 8),
+                 NULL);
+}
+
+static bool
+to_be_even (mutest_expect_t *e,
+            mutest_expect_res_t *check MUTEST_UNUSED)
+{
+  return mutest_get_int_value (mutest_expect_value (e)) % 2 == 0;
+}
+
+static void
+custom_matcher_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to be even",
+                 mutest_int_value (21),
+                 to_be_even,
+                 NULL);
+}
+
+static void
+negated_custom_matcher_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to not be even",
+                 mutest_int_value (42),
+                 mutest_not, to_be_even,
+                 NULL);
+}
+
+static void
+first_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("passes first", pass_spec);
+  mutest_it ("passes second", pass_spec);
+  mutest_it ("fails", fail_spec);
+}
+
+static void
+last_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  for (int i = 0; i < 16; i++)
+    mutest_it ("passes after the failure", pass_spec);
+}
+
+static void
+byte_array_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("differs in the AVX2 range", byte_array_avx2_spec);
+  mutest_it ("differs in the SSE2 range", byte_array_sse2_spec);
+  mutest_it ("differs in the tail", byte_array_tail_spec);
+  mutest_it ("differs in size", byte_array_size_spec);
+}
+
+static void
+typed_array_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("differs in two elements", int64_array_spec);
+}
+
+static void
+custom_matcher_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("fails a custom matcher", custom_matcher_spec);
+  mutest_it ("fails a negated custom matcher", negated_custom_matcher_spec);
+}
+
+MUTEST_MAIN (
+  mutest_register_matcher (to_be_even, NULL, "an even number");
+
+  mutest_describe ("First suite", first_suite);
+  mutest_describe ("Last suite", last_suite);
+  mutest_describe ("Byte arrays", byte_array_suite);
+  mutest_describe ("Typed arrays", typed_array_suite);
+  mutest_describe ("Custom matchers", custom_matcher_suite);
+)
@@ -0,0 +1,115 @@
+#include <mutest.h>
+
+#include <stdio.h>
+
+// The hooks of this test print a TAP comment when they are called, so
+// the tests using it can check that the hooks of filtered specs, and
+// of suites without any matching spec, are not called
+
+static struct {
+  int before_each_counter;
+  int after_each_counter;
+} parser_fixture;
+
+static void
+print_hook (const char *hook)
+{
+  printf ("# hook: %s\n", hook);
+  fflush (stdout);
+}
+
+static void
+parser_before_hook (void)
+{
+  print_hook ("before Parser");
+}
+
+static void
+parser_before_each_hook (void)
+{
+  parser_fixture.before_each_counter += 1;
+}
+
+static void
+parser_after_each_hook (void)
+{
+  parser_fixture.after_each_counter += 1;
+}
+
+static void
+parser_after_hook (void)
+{
+  char hook[128];
+
+  snprintf (hook, sizeof (hook), "after Parser, %d before each, %d after each",
+            parser_fixture.before_each_counter,
+            parser_fixture.after_each_counter);
+
+  print_hook (hook);
+}
+
+static void
+lexer_before_hook (void)
+{
+  print_hook ("before Lexer");
+}
+
+static void
+lexer_after_hook (void)
+{
+  print_hook ("after Lexer");
+}
+
+static void
+pass_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to pass",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+parser_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_before_each (parser_before_each_hook);
+  mutest_after_each (parser_after_each_hook);
+
+  mutest_it ("parses numbers", pass_spec);
+  mutest_it ("parses strings", pass_spec);
+  mutest_it ("fails on garbage", pass_spec);
+}
+
+static void
+lexer_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("splits tokens", pass_spec);
+}
+
+// The descriptions are built in a buffer that is reused for every
+// spec, so each spec must keep its own copy
+static void
+generated_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  char name[32];
+
+  for (int i = 0; i < 4; i++)
+    {
+      snprintf (name, sizeof (name), "case %d", i);
+      mutest_it (name, pass_spec);
+    }
+}
+
+MUTEST_MAIN (
+  mutest_before (parser_before_hook);
+  mutest_after (parser_after_hook);
+  mutest_describe ("Parser", parser_suite);
+
+  mutest_before (lexer_before_hook);
+  mutest_after (lexer_after_hook);
+  mutest_describe ("Lexer", lexer_suite);
+
+  mutest_before (NULL);
+  mutest_after (NULL);
+  mutest_describe ("Generated", generated_suite);
+)
@@ -45,12 +45,22 @@ skip_spec (void)
                  NULL);
 }
 
+static void
+escape_spec (void)
+{
+  mutest_expect ("to escape \"quotes\", \\backslashes\\, and\tcontrol characters",
+                 mutest_bool_value (true),
+                 mutest_to_be, true,
+                 NULL);
+}
+
 static void
 general_suite (void)
 {
   mutest_it ("contains at least a spec with an expectation", general_spec);
   mutest_it ("can contain multiple specs", another_spec);
   mutest_it ("can contain expectations that can be skipped", skip_spec);
+  mutest_it ("can contain \"special\" characters\tin descriptions", escape_spec);
 }
 
 MUTEST_MAIN (
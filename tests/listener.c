@@ -0,0 +1,237 @@
+#include <mutest.h>
+
+#include <stdio.h>
+
+// The listeners of this test check the order of the events they are
+// notified of, and count them, instead of using the exit status of
+// the run, which has a failing spec
+
+static struct {
+  int counts[MUTEST_LISTENER_RUN_END + 1];
+
+  // The nesting of the events: run, suite, spec
+  int depth;
+
+  bool has_diagnostic;
+
+  int n_specs;
+  int pass;
+  int fail;
+  int skip;
+
+  // The events seen by the first listener, and by the second one
+  int n_events;
+  int n_second_events;
+
+  int n_errors;
+} events;
+
+static void
+error (const char *message,
+       mutest_listener_event_t event)
+{
+  fprintf (stderr, "FAIL: %s (event %d)\n", message, (int) event);
+  events.n_errors += 1;
+}
+
+static void
+expect_depth (mutest_listener_event_t event,
+              int depth)
+{
+  if (events.depth != depth)
+    error ("event out of order", event);
+}
+
+static void
+check_events (mutest_listener_event_t event,
+              const mutest_listener_info_t *info,
+              void *data MUTEST_UNUSED)
+{
+  if (event > MUTEST_LISTENER_RUN_END)
+    return;
+
+  events.counts[event] += 1;
+  events.n_events += 1;
+
+  switch (event)
+    {
+    case MUTEST_LISTENER_RUN_START:
+      expect_depth (event, 0);
+      events.depth = 1;
+      break;
+
+    case MUTEST_LISTENER_SUITE_START:
+      expect_depth (event, 1);
+      events.depth = 2;
+      break;
+
+    case MUTEST_LISTENER_SPEC_START:
+      expect_depth (event, 2);
+      events.depth = 3;
+      break;
+
+    case MUTEST_LISTENER_EXPECT_DIAGNOSTIC:
+      expect_depth (event, 3);
+      if (info->diagnostic == NULL || info->location == NULL)
+        error ("diagnostic without a reason or a location", event);
+      events.has_diagnostic = true;
+      break;
+
+    case MUTEST_LISTENER_EXPECT_RESULT:
+      expect_depth (event, 3);
+      if (info->fail > 0 && !events.has_diagnostic)
+        error ("failure without a diagnostic", event);
+      if (info->fail == 0 && events.has_diagnostic)
+        error ("diagnostic without a failure", event);
+      if (info->pass + info->fail + info->skip != 1)
+        error ("expectation without a single result", event);
+      events.has_diagnostic = false;
+      break;
+
+    case MUTEST_LISTENER_SPEC_END:
+      expect_depth (event, 3);
+      events.depth = 2;
+      break;
+
+    case MUTEST_LISTENER_SUITE_END:
+      expect_depth (event, 2);
+      events.n_specs += info->n_specs;
+      events.depth = 1;
+      break;
+
+    case MUTEST_LISTENER_RUN_END:
+      expect_depth (event, 1);
+      events.pass = info->pass;
+      events.fail = info->fail;
+      events.skip = info->skip;
+      events.depth = 0;
+      break;
+    }
+}
+
+// Listeners are called in the order they were added
+static void
+check_listener_order (mutest_listener_event_t event,
+                      const mutest_listener_info_t *info MUTEST_UNUSED,
+                      void *data MUTEST_UNUSED)
+{
+  events.n_second_events += 1;
+
+  if (events.n_second_events != events.n_events)
+    error ("listener called out of order", event);
+}
+
+static void
+pass_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to pass",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+  mutest_expect ("to pass again",
+                 mutest_int_value (42),
+                 mutest_to_be, 42,
+                 NULL);
+}
+
+static void
+fail_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to fail",
+                 mutest_bool_value (false),
+                 mutest_to_be_true,
+                 NULL);
+  mutest_expect ("to pass after a failure",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+skip_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to be skipped",
+                 mutest_bool_value (true),
+                 mutest_skip, "on purpose",
+                 NULL);
+}
+
+static void
+first_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("passes", pass_spec);
+  mutest_it ("fails", fail_spec);
+  mutest_it ("skips", skip_spec);
+}
+
+static void
+second_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("passes", pass_spec);
+}
+
+static void
+check_count (mutest_listener_event_t event,
+             int expected)
+{
+  if (events.counts[event] != expected)
+    {
+      fprintf (stderr, "FAIL: expected %d events of type %d, got %d\n",
+               expected, (int) event, events.counts[event]);
+      events.n_errors += 1;
+    }
+}
+
+static void
+check_total (const char *what,
+             int value,
+             int expected)
+{
+  if (value != expected)
+    {
+      fprintf (stderr, "FAIL: expected %d %s, got %d\n", expected, what, value);
+      events.n_errors += 1;
+    }
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  mutest_init_with_args (argc, argv);
+
+  // Added after the initialization, so it's notified of the start of
+  // the run right away
+  mutest_add_listener (check_events, NULL);
+  mutest_add_listener (check_listener_order, NULL);
+
+  check_count (MUTEST_LISTENER_RUN_START, 1);
+
+  mutest_describe ("First suite", first_suite);
+  mutest_describe ("Second suite", second_suite);
+
+  mutest_report ();
+
+  check_count (MUTEST_LISTENER_RUN_START, 1);
+  check_count (MUTEST_LISTENER_SUITE_START, 2);
+  check_count (MUTEST_LISTENER_SPEC_START, 4);
+  check_count (MUTEST_LISTENER_EXPECT_DIAGNOSTIC, 1);
+  check_count (MUTEST_LISTENER_EXPECT_RESULT, 7);
+  check_count (MUTEST_LISTENER_SPEC_END, 4);
+  check_count (MUTEST_LISTENER_SUITE_END, 2);
+  check_count (MUTEST_LISTENER_RUN_END, 1);
+
+  check_total ("specs", events.n_specs, 4);
+  check_total ("passed expectations", events.pass, 5);
+  check_total ("failed expectations", events.fail, 1);
+  check_total ("skipped expectations", events.skip, 1);
+  check_total ("events in the second listener", events.n_second_events, events.n_events);
+
+  if (events.depth != 0)
+    {
+      fprintf (stderr, "FAIL: the run did not end\n");
+      events.n_errors += 1;
+    }
+
+  return events.n_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
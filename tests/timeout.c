@@ -0,0 +1,64 @@
+#include <mutest.h>
+
+#include <stdlib.h>
+
+// The specs of this test run past their timeout on purpose; the tests
+// using it check that the timed out specs are reported as failed, with
+// their location, and that the run continues with the following spec.
+//
+// The default timeout only applies when MUTEST_TIMEOUT is set; without
+// it, the spec relying on it returns instead of running forever.
+
+static volatile bool keep_running = true;
+
+static void
+run_forever (void)
+{
+  while (keep_running)
+    ;
+}
+
+static void
+pass_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to pass",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+}
+
+static void
+own_timeout_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to start",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+
+  run_forever ();
+}
+
+static void
+default_timeout_spec (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("to start",
+                 mutest_bool_value (true),
+                 mutest_to_be_true,
+                 NULL);
+
+  if (getenv ("MUTEST_TIMEOUT") != NULL)
+    run_forever ();
+}
+
+static void
+timeout_suite (mutest_suite_t *suite MUTEST_UNUSED)
+{
+  mutest_it ("passes before the timeout", pass_spec);
+  mutest_it_with_timeout ("runs past its own timeout", own_timeout_spec, 0.2);
+  mutest_it ("runs past the default timeout", default_timeout_spec);
+  mutest_it ("passes after the timeout", pass_spec);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Timeouts", timeout_suite);
+)
@@ -0,0 +1,170 @@
+// The timings database is private to the library, so this test is
+// linked with its objects, and checks it directly, without running
+// any spec that would record its own duration in it
+
+#include "mutest-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int n_errors;
+
+static void
+check (bool condition,
+       const char *what)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "FAIL: %s\n", what);
+      n_errors += 1;
+    }
+}
+
+static void
+write_file (const char *path,
+            const char *contents)
+{
+  FILE *stream = fopen (path, "w");
+  if (stream == NULL)
+    {
+      perror ("fopen");
+      exit (EXIT_FAILURE);
+    }
+
+  fputs (contents, stream);
+  fclose (stream);
+}
+
+static bool
+file_has_line (const char *path,
+               const char *expected)
+{
+  FILE *stream = fopen (path, "r");
+  if (stream == NULL)
+    return false;
+
+  char buf[1024];
+  bool res = false;
+
+  while (fgets (buf, sizeof (buf), stream) != NULL)
+    {
+      buf[strcspn (buf, "\n")] = '\0';
+
+      if (strcmp (buf, expected) == 0)
+        {
+          res = true;
+          break;
+        }
+    }
+
+  fclose (stream);
+
+  return res;
+}
+
+static int64_t
+lookup (const char *file,
+        int line,
+        const char *suite_description,
+        const char *spec_description)
+{
+  mutest_suite_t suite = { .description = suite_description };
+  mutest_spec_t spec = { .file = file, .line = line, .description = spec_description };
+
+  return mutest_timings_lookup (&suite, &spec);
+}
+
+int
+main (void)
+{
+  char path[64];
+
+  snprintf (path, sizeof (path), "timings-%lld.db", (long long) mutest_get_current_time ());
+
+  // Databases without the number of missing runs are still loaded;
+  // comments, and malformed lines, are ignored
+  write_file (path,
+              "# mutest timings 1\n"
+              "100\t10\tspecs.c\tParser\tparses numbers\n"
+              "300\t20\tspecs.c\tParser\tparses\\tstrings\\nand \\\\escapes\n"
+              "200\t30\tspecs.c\tParser\tfails on garbage\t2\n"
+              "50\t40\tspecs.c\tParser\tis renamed\n"
+              "70\t50\tspecs.c\tParser\tis removed\t10\n"
+              "80\t60\tspecs.c\tParser\tis missing\t3\n"
+              "90\t10\tother.c\tLexer\tsplits tokens\t10\n"
+              "not a duration\t10\tspecs.c\tParser\tmalformed\n"
+              "100\t10\tspecs.c\tParser\n");
+
+  mutest_timings_init (path);
+
+  check (lookup ("specs.c", 10, "Parser", "parses numbers") == 100, "a duration to be loaded");
+  check (lookup ("specs.c", 20, "Parser", "parses\tstrings\nand \\escapes") == 300,
+         "an escaped description to be loaded");
+  check (lookup ("specs.c", 10, "Parser", "malformed") == -1, "malformed lines to be ignored");
+  check (lookup ("specs.c", 10, "Lexer", "parses numbers") == -1, "the suite to identify a spec");
+  check (lookup ("specs.c", 11, "Parser", "parses numbers") == -1, "the line to identify a spec");
+
+  // The specs of the run, in declaration order
+  mutest_spec_t specs[] = {
+    { .file = "specs.c", .line = 10, .description = "parses numbers" },
+    { .file = "specs.c", .line = 20, .description = "parses\tstrings\nand \\escapes" },
+    { .file = "specs.c", .line = 30, .description = "fails on garbage" },
+    { .file = "specs.c", .line = 40, .description = "was renamed" },
+  };
+  const size_t n_specs = sizeof (specs) / sizeof (specs[0]);
+
+  mutest_suite_t suite = {
+    .description = "Parser",
+    .first_spec = &specs[0],
+  };
+
+  for (size_t i = 0; i + 1 < n_specs; i++)
+    specs[i].next = &specs[i + 1];
+
+  // The longest specs go first, and the ones without a recorded
+  // duration before them
+  size_t *order = mutest_timings_order (&suite, n_specs);
+  check (order != NULL, "an order to be computed");
+  if (order != NULL)
+    {
+      check (order[0] == 3, "a spec without a duration to go first");
+      check (order[1] == 1, "the longest spec to go second");
+      check (order[2] == 2, "the second longest spec to go third");
+      check (order[3] == 0, "the shortest spec to go last");
+      free (order);
+    }
+
+  mutest_timings_prune (&suite);
+
+  check (lookup ("specs.c", 30, "Parser", "fails on garbage") == 200, "existing specs to be kept");
+  check (lookup ("specs.c", 40, "Parser", "is renamed") == -1, "a replaced spec to be dropped");
+  check (lookup ("specs.c", 50, "Parser", "is removed") == -1, "a long missing spec to be dropped");
+  check (lookup ("specs.c", 60, "Parser", "is missing") == 80, "a missing spec to be kept for a while");
+  check (lookup ("other.c", 10, "Lexer", "splits tokens") == 90, "the specs of other files to be kept");
+
+  mutest_timings_save ();
+
+  check (file_has_line (path, "# mutest timings 2"), "the database to be saved");
+  check (file_has_line (path, "100\t10\tspecs.c\tParser\tparses numbers\t0"), "a duration to be saved");
+  check (file_has_line (path, "300\t20\tspecs.c\tParser\tparses\\tstrings\\nand \\\\escapes\t0"),
+         "an escaped description to be saved");
+  check (file_has_line (path, "200\t30\tspecs.c\tParser\tfails on garbage\t0"),
+         "an existing spec to reset its missing runs");
+  check (file_has_line (path, "80\t60\tspecs.c\tParser\tis missing\t4"),
+         "a missing spec to count its missing runs");
+  check (file_has_line (path, "90\t10\tother.c\tLexer\tsplits tokens\t10"),
+         "the specs of other files to keep their missing runs");
+  check (!file_has_line (path, "50\t40\tspecs.c\tParser\tis renamed\t0"), "a replaced spec to not be saved");
+
+  // Loading the saved database gives back the same durations
+  mutest_timings_init (path);
+
+  check (lookup ("specs.c", 20, "Parser", "parses\tstrings\nand \\escapes") == 300,
+         "an escaped description to survive a round trip");
+  check (lookup ("specs.c", 60, "Parser", "is missing") == 80, "a duration to survive a round trip");
+
+  remove (path);
+
+  return n_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
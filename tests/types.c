@@ -99,6 +99,156 @@ check_string (mutest_spec_t *spec MUTEST_UNUSED)
                  NULL);
 }
 
+static void
+check_typed (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect_int_eq ("typed integers to support equality", 42, 42);
+  mutest_expect_int_ne ("typed integers to support inequality", 42, 47);
+  mutest_expect_int_lt ("typed integers to support 'less' ordering", 42, 47);
+  mutest_expect_int_ge ("typed integers to support 'greater or equal' ordering", 42, 42);
+  mutest_expect_int_in_range ("typed integers to support ranges", 42, 40, 45);
+
+  mutest_expect_float_eq ("typed floats to support equality", 0.5, 0.5);
+  mutest_expect_float_gt ("typed floats to support 'greater' ordering", 3.14, 3.0);
+  mutest_expect_float_in_range ("typed floats to support ranges", 3.14, 3.0, 4.0);
+
+  mutest_expect_true ("typed booleans to be true", 42 > 0);
+  mutest_expect_false ("typed booleans to be false", 42 < 0);
+
+  void *p = (void *) 0xdeadbeef;
+
+  mutest_expect_ptr_eq ("typed pointers to support equality", p, (void *) 0xdeadbeef);
+  mutest_expect_ptr_ne ("typed pointers to support inequality", p, NULL);
+
+  mutest_expect_str_eq ("typed strings to support equality", "hello, world", "hello, world");
+  mutest_expect_str_ne ("typed strings to support inequality", "hello", NULL);
+}
+
+static void
+check_byte_array (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  const int a[] = { 1, 2, 3, 4, 5 };
+  const int b[] = { 1, 2, 3, 4, 5 };
+  const int c[] = { 1, 2, 3, 4, 6 };
+
+  mutest_expect ("byte arrays to support equality",
+                 mutest_byte_array (a, sizeof (int), 5),
+                 mutest_to_be, mutest_byte_array (b, sizeof (int), 5),
+                 NULL);
+  mutest_expect ("byte arrays to support inequality",
+                 mutest_byte_array (a, sizeof (int), 5),
+                 mutest_not, mutest_to_be, mutest_byte_array (c, sizeof (int), 5),
+                 NULL);
+  mutest_expect ("byte arrays to compare their size",
+                 mutest_byte_array (a, sizeof (int), 5),
+                 mutest_not, mutest_to_be, mutest_byte_array (b, sizeof (int), 4),
+                 NULL);
+
+  // Long arrays are compared 32 bytes at a time with AVX2, then 16 bytes
+  // at a time with SSE2, then 8 bytes at a time, and the tail one byte
+  // at a time; 123 bytes cover all of them
+  unsigned char long_a[123], long_b[123];
+  const size_t offsets[] = { 5, 50, 100, 115, 121 };
+
+  for (size_t i = 0; i < sizeof (long_a); i++)
+    long_a[i] = long_b[i] = (unsigned char) i;
+
+  mutest_expect ("long byte arrays to support equality",
+                 mutest_byte_array (long_a, 1, sizeof (long_a)),
+                 mutest_to_be, mutest_byte_array (long_b, 1, sizeof (long_b)),
+                 NULL);
+
+  for (size_t i = 0; i < sizeof (offsets) / sizeof (offsets[0]); i++)
+    {
+      long_b[offsets[i]] = 0xff;
+
+      mutest_expect ("long byte arrays to find a difference at any offset",
+                     mutest_byte_array (long_a, 1, sizeof (long_a)),
+                     mutest_not, mutest_to_be, mutest_byte_array (long_b, 1, sizeof (long_b)),
+                     NULL);
+
+      long_b[offsets[i]] = long_a[offsets[i]];
+    }
+
+  mutest_expect ("long byte arrays to compare their size",
+                 mutest_byte_array (long_a, 1, sizeof (long_a)),
+                 mutest_not, mutest_to_be, mutest_byte_array (long_b, 1, 64),
+                 NULL);
+}
+
+static void
+check_arrays (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  const int32_t ints[] = { 1, 2, 3, 5, 8, 13 };
+  const double doubles[] = { 0.1, 0.2, 0.3 };
+  const double sums[] = { 0.1, 0.1 + 0.1, 0.1 + 0.2 };
+
+  mutest_expect ("arrays to support equality",
+                 mutest_int32_array (ints, 6),
+                 mutest_to_have_equal_elements, mutest_int32_array (ints, 6),
+                 NULL);
+  mutest_expect ("arrays to support closeness",
+                 mutest_double_array (doubles, 3),
+                 mutest_to_have_close_elements, mutest_double_array (sums, 3), 0.0, 0.0, 1,
+                 NULL);
+  mutest_expect ("arrays to support ranges",
+                 mutest_int32_array (ints, 6),
+                 mutest_to_have_elements_in_range, 1, 13,
+                 NULL);
+  mutest_expect ("arrays to support sorting",
+                 mutest_double_array (doubles, 3),
+                 mutest_to_be_sorted,
+                 NULL);
+}
+
+static bool
+to_be_a_multiple_of (mutest_expect_t *e,
+                     mutest_expect_res_t *check)
+{
+  int value = mutest_get_int_value (mutest_expect_value (e));
+  int divisor = mutest_get_int_value (check);
+
+  return divisor != 0 && value % divisor == 0;
+}
+
+static mutest_expect_res_t *
+collect_divisor (const mutest_expect_res_t *value MUTEST_UNUSED,
+                 va_list *args)
+{
+  return mutest_int_value (va_arg (*args, int));
+}
+
+static bool
+to_be_even (mutest_expect_t *e,
+            mutest_expect_res_t *check MUTEST_UNUSED)
+{
+  return mutest_get_int_value (mutest_expect_value (e)) % 2 == 0;
+}
+
+static void
+check_custom_matchers (mutest_spec_t *spec MUTEST_UNUSED)
+{
+  mutest_expect ("custom matchers to collect their expected value",
+                 mutest_int_value (42),
+                 to_be_a_multiple_of, 7,
+                 mutest_to_be, 42,
+                 NULL);
+  mutest_expect ("custom matchers to support negation",
+                 mutest_int_value (42),
+                 mutest_not, to_be_a_multiple_of, 5,
+                 to_be_a_multiple_of, 3,
+                 NULL);
+  mutest_expect ("custom matchers to not need an expected value",
+                 mutest_int_value (42),
+                 to_be_even,
+                 mutest_not, to_be_a_multiple_of, 4,
+                 NULL);
+  mutest_expect ("negated custom matchers to not need an expected value",
+                 mutest_int_value (21),
+                 mutest_not, to_be_even,
+                 NULL);
+}
+
 static void
 value_types (mutest_suite_t *suite MUTEST_UNUSED)
 {
@@ -106,8 +256,15 @@ value_types (mutest_suite_t *suite MUTEST_UNUSED)
   mutest_it ("allows ordering of numbers", check_ordering);
   mutest_it ("allows checking ranges", check_ranges);
   mutest_it ("allows checking strings", check_string);
+  mutest_it ("allows typed expectations", check_typed);
+  mutest_it ("allows checking byte arrays", check_byte_array);
+  mutest_it ("allows checking numeric arrays", check_arrays);
+  mutest_it ("allows custom matchers", check_custom_matchers);
 }
 
 MUTEST_MAIN (
+  mutest_register_matcher (to_be_a_multiple_of, collect_divisor, NULL);
+  mutest_register_matcher (to_be_even, NULL, "an even number");
+
   mutest_describe ("Values", value_types);
 )
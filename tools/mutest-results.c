@@ -0,0 +1,435 @@
+/* mutest-results.c: Merge and render results logs
+ *
+ * µTest - Copyright 2019  Emmanuele Bassi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// Usage: mutest-results LOG...
+//
+// Reads the logs written by test programs run with MUTEST_OUTPUT set
+// to "binary", and renders them with the output format selected by
+// the MUTEST_OUTPUT environment variable, as if they were the results
+// of a single run. Suites that appear in more than one log, like the
+// ones of sharded runs, are merged in the position of their first
+// appearance; the specs keep the order of the logs.
+
+#include "mutest-private.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *path;
+
+  char *data;
+  size_t len;
+
+  mutest_binary_reader_t reader;
+} results_log_t;
+
+// A suite in one of the logs
+typedef struct {
+  results_log_t *log;
+
+  // The offset of the suite record
+  size_t offset;
+} suite_part_t;
+
+typedef struct {
+  uint64_t hash;
+
+  // The first suite record, pointing into its log
+  mutest_suite_t suite;
+
+  suite_part_t *parts;
+  size_t n_parts;
+  size_t size_parts;
+} merged_suite_t;
+
+static struct {
+  merged_suite_t *suites;
+  size_t n_suites;
+  size_t size_suites;
+
+  int shard_index;
+  int shard_count;
+
+  int64_t duration;
+  int filtered;
+  bool cancelled;
+  bool has_alloc_stats;
+} results;
+
+static bool
+read_log (results_log_t *log)
+{
+  FILE *file = fopen (log->path, "rb");
+
+  if (file == NULL)
+    {
+      fprintf (stderr, "mutest-results: %s: %s\n", log->path, strerror (errno));
+      return false;
+    }
+
+  size_t size = 0;
+
+  log->data = NULL;
+  log->len = 0;
+
+  for (;;)
+    {
+      if (log->len == size)
+        {
+          size = size > 0 ? size * 2 : 65536;
+          log->data = realloc (log->data, size);
+          if (log->data == NULL)
+            mutest_oom_abort ();
+        }
+
+      size_t n_read = fread (log->data + log->len, 1, size - log->len, file);
+      if (n_read == 0)
+        break;
+
+      log->len += n_read;
+    }
+
+  bool res = !ferror (file);
+
+  if (!res)
+    fprintf (stderr, "mutest-results: %s: %s\n", log->path, strerror (errno));
+
+  fclose (file);
+
+  return res;
+}
+
+static bool
+str_equal (const char *a,
+           const char *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+
+  return strcmp (a, b) == 0;
+}
+
+static merged_suite_t *
+get_merged_suite (const mutest_suite_t *suite)
+{
+  uint64_t hash = mutest_hash_string (MUTEST_HASH_INIT, suite->description);
+  hash = mutest_hash_string (hash, suite->file);
+
+  for (size_t i = 0; i < results.n_suites; i++)
+    {
+      merged_suite_t *merged = &results.suites[i];
+
+      if (merged->hash == hash &&
+          str_equal (merged->suite.description, suite->description) &&
+          str_equal (merged->suite.file, suite->file))
+        return merged;
+    }
+
+  if (results.n_suites == results.size_suites)
+    {
+      results.size_suites = results.size_suites > 0 ? results.size_suites * 2 : 64;
+      results.suites = realloc (results.suites, results.size_suites * sizeof (merged_suite_t));
+      if (results.suites == NULL)
+        mutest_oom_abort ();
+    }
+
+  merged_suite_t *merged = &results.suites[results.n_suites++];
+
+  memset (merged, 0, sizeof (merged_suite_t));
+  merged->hash = hash;
+  merged->suite.description = suite->description;
+  merged->suite.file = suite->file;
+  merged->suite.line = suite->line;
+  merged->suite.func_name = suite->func_name;
+
+  return merged;
+}
+
+static void
+add_suite_part (merged_suite_t *merged,
+                results_log_t *log,
+                size_t offset)
+{
+  if (merged->n_parts == merged->size_parts)
+    {
+      merged->size_parts = merged->size_parts > 0 ? merged->size_parts * 2 : 4;
+      merged->parts = realloc (merged->parts, merged->size_parts * sizeof (suite_part_t));
+      if (merged->parts == NULL)
+        mutest_oom_abort ();
+    }
+
+  merged->parts[merged->n_parts].log = log;
+  merged->parts[merged->n_parts].offset = offset;
+  merged->n_parts += 1;
+}
+
+// Collects the suites of @log, and its results
+//
+// Returns: false if the log is malformed, or if its run did not complete
+static bool
+scan_log (results_log_t *log)
+{
+  mutest_binary_reader_t *reader = &log->reader;
+  mutest_binary_record_t record;
+  bool has_results = false;
+
+  while (mutest_binary_reader_next (reader, &record))
+    {
+      switch (record.type)
+        {
+        case MUTEST_BINARY_START:
+          results.shard_index = record.shard_index;
+          results.shard_count = record.shard_count;
+          break;
+
+        case MUTEST_BINARY_SUITE:
+          add_suite_part (get_merged_suite (&record.suite), log, record.offset);
+          break;
+
+        // The runs of the logs are assumed to happen at the same time
+        case MUTEST_BINARY_RESULTS:
+          if (record.duration > results.duration)
+            results.duration = record.duration;
+          if (record.filtered > results.filtered)
+            results.filtered = record.filtered;
+          results.cancelled |= record.cancelled;
+          has_results = true;
+          break;
+
+        case MUTEST_BINARY_STRING:
+        case MUTEST_BINARY_SPEC:
+        case MUTEST_BINARY_EXPECT:
+        case MUTEST_BINARY_EXPECT_FAIL:
+        case MUTEST_BINARY_SPEC_RESULTS:
+        case MUTEST_BINARY_SUITE_RESULTS:
+          break;
+        }
+    }
+
+  if (reader->has_alloc_stats)
+    results.has_alloc_stats = true;
+
+  if (reader->error)
+    fprintf (stderr, "mutest-results: %s: malformed results log\n", log->path);
+  else if (reader->truncated || !has_results)
+    fprintf (stderr, "mutest-results: %s: truncated results log\n", log->path);
+
+  return !reader->error && has_results;
+}
+
+// Renders the specs of a suite in one of the logs, and adds their
+// results to @suite
+static void
+render_suite_part (const suite_part_t *part,
+                   mutest_suite_t *suite,
+                   bool *skip_all)
+{
+  mutest_binary_reader_t *reader = &part->log->reader;
+  mutest_binary_record_t record;
+
+  reader->pos = part->offset;
+  reader->error = false;
+  reader->truncated = false;
+
+  // The suite record itself
+  if (!mutest_binary_reader_next (reader, &record))
+    return;
+
+  // The results of a spec that was interrupted
+  mutest_spec_t spec;
+  bool in_spec = false;
+  bool has_results = false;
+
+  memset (&spec, 0, sizeof (mutest_spec_t));
+
+  while (!has_results && mutest_binary_reader_next (reader, &record))
+    {
+      switch (record.type)
+        {
+        case MUTEST_BINARY_SPEC:
+          spec = record.spec;
+          in_spec = true;
+          mutest_format_spec_preamble (&record.spec);
+          break;
+
+        case MUTEST_BINARY_EXPECT:
+          if (in_spec)
+            {
+              spec.n_expects += 1;
+              if (record.expect.result == MUTEST_RESULT_PASS)
+                spec.pass += 1;
+              else if (record.expect.result == MUTEST_RESULT_FAIL)
+                spec.fail += 1;
+              else
+                spec.skip += 1;
+            }
+
+          mutest_format_expect_result (&record.expect);
+          break;
+
+        case MUTEST_BINARY_EXPECT_FAIL:
+          mutest_format_expect_fail (&record.expect, false, NULL, NULL);
+          break;
+
+        case MUTEST_BINARY_SPEC_RESULTS:
+          in_spec = false;
+          mutest_format_spec_results (&record.spec);
+          mutest_suite_add_spec_results (suite, &record.spec);
+          break;
+
+        case MUTEST_BINARY_SUITE_RESULTS:
+          has_results = true;
+          *skip_all = *skip_all && record.suite.skip_all;
+          if (record.suite.skip_all)
+            suite->skip_reason = record.suite.skip_reason;
+          suite->end_time += record.suite.end_time - record.suite.start_time;
+          break;
+
+        // The end of a truncated suite
+        case MUTEST_BINARY_START:
+        case MUTEST_BINARY_SUITE:
+        case MUTEST_BINARY_RESULTS:
+          has_results = true;
+          *skip_all = false;
+          break;
+
+        case MUTEST_BINARY_STRING:
+          break;
+        }
+    }
+
+  if (in_spec)
+    {
+      mutest_format_spec_results (&spec);
+      mutest_suite_add_spec_results (suite, &spec);
+    }
+
+  if (!has_results)
+    *skip_all = false;
+}
+
+static void
+render_suite (merged_suite_t *merged)
+{
+  mutest_state_t *state = mutest_get_global_state ();
+  mutest_suite_t suite = merged->suite;
+  bool skip_all = true;
+
+  mutest_format_suite_preamble (&suite);
+
+  // The duration of the suite is the sum of the ones of its parts
+  suite.start_time = 0;
+  suite.end_time = 0;
+
+  for (size_t i = 0; i < merged->n_parts; i++)
+    render_suite_part (&merged->parts[i], &suite, &skip_all);
+
+  suite.skip_all = skip_all;
+  if (!skip_all)
+    suite.skip_reason = NULL;
+
+  if (suite.skip_all)
+    state->total_skip += 1;
+
+  mutest_add_suite_results (&suite);
+
+  mutest_format_suite_results (&suite);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  if (argc < 2 || strcmp (argv[1], "--help") == 0)
+    {
+      fprintf (stderr,
+               "Usage: mutest-results LOG...\n"
+               "\n"
+               "Renders the results logs of test programs run with MUTEST_OUTPUT=binary\n"
+               "using the output format set by the MUTEST_OUTPUT environment variable.\n");
+      return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+  int n_logs = argc - 1;
+  results_log_t *logs = calloc (n_logs, sizeof (results_log_t));
+  if (logs == NULL)
+    mutest_oom_abort ();
+
+  bool failed = false;
+
+  results.shard_count = 1;
+
+  for (int i = 0; i < n_logs; i++)
+    {
+      results_log_t *log = &logs[i];
+
+      log->path = argv[i + 1];
+
+      if (!read_log (log))
+        {
+          failed = true;
+          continue;
+        }
+
+      if (!mutest_binary_reader_init (&log->reader, log->data, log->len))
+        {
+          fprintf (stderr, "mutest-results: %s: not a results log\n", log->path);
+          failed = true;
+          continue;
+        }
+
+      if (!scan_log (log))
+        failed = true;
+    }
+
+  mutest_init ();
+
+  mutest_state_t *state = mutest_get_global_state ();
+
+  if (results.has_alloc_stats)
+    state->alloc_stats = true;
+
+  for (size_t i = 0; i < results.n_suites; i++)
+    render_suite (&results.suites[i]);
+
+  // The shard is only known for a single log
+  if (n_logs == 1)
+    {
+      state->shard_index = results.shard_index;
+      state->shard_count = results.shard_count;
+    }
+
+  state->start_time = 0;
+  state->end_time = results.duration;
+  state->total_filtered = results.filtered;
+
+  if (results.cancelled)
+    mutest_cancel ();
+
+  mutest_format_total_results (state);
+
+  int res = mutest_get_exit_status ();
+
+  for (size_t i = 0; i < results.n_suites; i++)
+    free (results.suites[i].parts);
+  free (results.suites);
+
+  for (int i = 0; i < n_logs; i++)
+    {
+      mutest_binary_reader_clear (&logs[i].reader);
+      free (logs[i].data);
+    }
+  free (logs);
+
+  if (failed)
+    res = EXIT_FAILURE;
+
+  return res;
+}